@@ -53,13 +53,11 @@ static constexpr auto server_connection_callback =
   case QUIC_CONNECTION_EVENT_SHUTDOWN_INITIATED_BY_PEER:
     break;
   case QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE: {
-    /*  Do not cleanup her, might cause double free error
-        In destructor of MOQT Server, connection is torn down, this might call
-       `QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE` callback which would erase the
-       connection Then destructor deallocates, which causes double free
-    */
-
-    // moqtServer->cleanup_connection(connection);
+    // AppCloseInProgress is set when we closed the connection ourselves (the
+    // connection state is being destroyed, in ~MOQTServer or when its last
+    // reference is released), the state is no longer in the registry then
+    if (!event->SHUTDOWN_COMPLETE.AppCloseInProgress)
+      moqtServer->cleanup_connection(connection);
     break;
   }
   case QUIC_CONNECTION_EVENT_PEER_STREAM_STARTED: {
@@ -71,12 +69,98 @@ static constexpr auto server_connection_callback =
   }
   case QUIC_CONNECTION_EVENT_RESUMED:
     break;
+  case QUIC_CONNECTION_EVENT_DATAGRAM_STATE_CHANGED: {
+    moqtServer->datagram_state_changed(connection,
+                                       event->DATAGRAM_STATE_CHANGED);
+    break;
+  }
+  case QUIC_CONNECTION_EVENT_DATAGRAM_SEND_STATE_CHANGED: {
+    // datagram buffers have to be kept alive till the send state is final
+    if (!QUIC_DATAGRAM_SEND_STATE_IS_FINAL(
+            event->DATAGRAM_SEND_STATE_CHANGED.State))
+      break;
+
+    DatagramSendContext *datagramSendContext =
+        static_cast<DatagramSendContext *>(
+            event->DATAGRAM_SEND_STATE_CHANGED.ClientContext);
+    datagramSendContext->connectionState_->on_datagram_send_complete(
+        *datagramSendContext);
+    delete datagramSendContext;
+    break;
+  }
   default:
     break;
   }
   return QUIC_STATUS_SUCCESS;
 };
 
+// hands the buffers of a receive event to the deserializer of the stream
+// https://github.com/microsoft/msquic/blob/f96015560399d60cbdd8608b6fa2120560118500/docs/Streams.md#synchronous-vs-asynchronous
+/*
+    decltype(receive) is
+    struct {
+        uint64_t AbsoluteOffset;
+        uint64_t TotalBufferLength;
+        const QUIC_BUFFER* Buffers;
+        uint32_t BufferCount;
+        QUIC_RECEIVE_FLAGS Flags;
+    }
+*/
+static inline QUIC_STATUS receive_buffers(HQUIC stream,
+                                          StreamContext &streamContext,
+                                          const auto &receive) {
+  auto receiveComplete =
+      streamContext.moqtObject_.get_tbl()->StreamReceiveComplete;
+  auto &deserializer = *streamContext.deserializer_;
+
+  if (!streamContext.moqtObject_.zeroCopyReceive) {
+    // make a copy of the buffer, we do not need a copy, but there seems to be
+    // a bug in MsQuic with lifetime management of the buffers in MultiReceive
+    // Mode
+    for (std::uint32_t bufferIndex = 0; bufferIndex < receive.BufferCount;
+         bufferIndex++)
+      deserializer.append_buffer(copy_received_buffer(
+          receive.Buffers[bufferIndex], stream, receiveComplete));
+
+    // we are consuming the buffer in the callback because we are making a
+    // copy
+    return QUIC_STATUS_SUCCESS;
+  }
+
+  // nothing to complete (e.g. only FIN)
+  if (receive.TotalBufferLength == 0)
+    return QUIC_STATUS_SUCCESS;
+
+  for (std::uint32_t bufferIndex = 0; bufferIndex < receive.BufferCount;
+       bufferIndex++)
+    deserializer.append_buffer(borrow_received_buffer(
+        receive.Buffers[bufferIndex], stream, receiveComplete));
+  deserializer.limit_borrowed_bytes();
+
+  // bytes are completed as the deserializer releases the buffers, the ones
+  // which were consumed above have already been completed inline
+  return QUIC_STATUS_PENDING;
+}
+
+// receive handoff (MOQT::set_receiveHandoff), the buffers are queued for the
+// application thread, they are copied even with zero copy receive because
+// borrowed buffers do not outlive QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE
+static inline QUIC_STATUS hand_off_buffers(HQUIC stream,
+                                           StreamContext &streamContext,
+                                           const auto &receive) {
+  auto receiveComplete =
+      streamContext.moqtObject_.get_tbl()->StreamReceiveComplete;
+  auto &receivedBuffers = streamContext.connectionState_.receivedBuffers_;
+
+  for (std::uint32_t bufferIndex = 0; bufferIndex < receive.BufferCount;
+       bufferIndex++)
+    receivedBuffers.push(
+        {stream, &streamContext,
+         copy_received_buffer(receive.Buffers[bufferIndex], stream,
+                              receiveComplete)});
+  return QUIC_STATUS_SUCCESS;
+}
+
 // Control Stream Open Flags = QUIC_STREAM_OPEN_FLAG_NONE |
 // QUIC_STREAM_OPEN_FLAG_0_RTT Control Stream Start flags =
 // QUIC_STREAM_START_FLAG_PRIORITY_WORK
@@ -84,8 +168,6 @@ static constexpr auto server_control_stream_callback =
     []([[maybe_unused]] HQUIC controlStream, void *context,
        QUIC_STREAM_EVENT *event) {
       StreamContext *streamContext = static_cast<StreamContext *>(context);
-      MOQT &moqtObject = streamContext->moqtObject_;
-      auto &deserializer = streamContext->deserializer_;
 
       utils::wait_for(streamContext->streamHasBeenConstructed);
       // moqtObject.get_tbl()->StreamReceiveSetEnabled(controlStream, true);
@@ -98,30 +180,7 @@ static constexpr auto server_control_stream_callback =
         break;
       }
       case QUIC_STREAM_EVENT_RECEIVE: {
-        for (std::uint64_t bufferIndex = 0;
-             bufferIndex < event->RECEIVE.BufferCount; bufferIndex++) {
-          const QUIC_BUFFER *buffer = &event->RECEIVE.Buffers[bufferIndex];
-
-          // make a copy of the buffer, we do not need a copy, but there seems
-          // to be a bug in MsQuic with lifetime management of the buffers in
-          // MultiReceive Mode
-          QUIC_BUFFER *newBuffer =
-              (QUIC_BUFFER *)malloc(sizeof(QUIC_BUFFER) + buffer->Length);
-          newBuffer->Length = buffer->Length;
-          newBuffer->Buffer = (uint8_t *)newBuffer + sizeof(QUIC_BUFFER);
-          std::memcpy(newBuffer->Buffer, buffer->Buffer, buffer->Length);
-
-          deserializer->append_buffer(UniqueQuicBuffer(
-              newBuffer,
-              rvn::QUIC_BUFFERDeleter(
-                  controlStream, moqtObject.get_tbl()->StreamReceiveComplete)));
-        }
-
-        // https://github.com/microsoft/msquic/blob/f96015560399d60cbdd8608b6fa2120560118500/docs/Streams.md#synchronous-vs-asynchronous
-        // we are consuming the buffer in the callback because we are making a
-        // copy
-        return QUIC_STATUS_SUCCESS;
-        break;
+        return receive_buffers(controlStream, *streamContext, event->RECEIVE);
       }
       case QUIC_STREAM_EVENT_SEND_COMPLETE: {
         // Buffer has been sent
@@ -141,6 +200,10 @@ static constexpr auto server_control_stream_callback =
                   << std::endl;
         break;
       }
+      case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE: {
+        streamContext->deserializer_->detach_stream();
+        break;
+      }
       default:
         break;
       }
@@ -151,8 +214,7 @@ static constexpr auto server_control_stream_callback =
 // Data Stream Start flags = QUIC_STREAM_START_FLAG_FAIL_BLOCKED |
 // QUIC_STREAM_START_FLAG_SHUTDOWN_ON_FAIL
 static constexpr auto server_data_stream_callback =
-    []([[maybe_unused]] HQUIC dataStream, void *context,
-       QUIC_STREAM_EVENT *event) {
+    [](HQUIC dataStream, void *context, QUIC_STREAM_EVENT *event) {
       StreamContext *streamContext = static_cast<StreamContext *>(context);
 
       // TODO: wait for streamSetup
@@ -166,8 +228,37 @@ static constexpr auto server_data_stream_callback =
                                        "on data stream");
         break;
       }
+      case QUIC_STREAM_EVENT_SEND_COMPLETE: {
+        // Buffer has been sent (or send was cancelled because stream was
+        // aborted), either way we are done with the send context
+        StreamSendContext *streamSendContext = static_cast<StreamSendContext *>(
+            event->SEND_COMPLETE.ClientContext);
+
+        streamContext->connectionState_.on_data_send_complete(
+            *streamSendContext);
+        streamSendContext->send_complete_cb();
+        delete streamSendContext;
+        break;
+      }
+      // peer STOP_SENDING, or the stream was reset or ended, the stream is
+      // only erased on SHUTDOWN_COMPLETE and sends fail till then
+      case QUIC_STREAM_EVENT_PEER_RECEIVE_ABORTED:
+      case QUIC_STREAM_EVENT_SEND_SHUTDOWN_COMPLETE: {
+        streamContext->sendShutdown_.store(true, std::memory_order_release);
+        break;
+      }
       case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE: {
-        delete streamContext;
+        // we closed the handle, the stream has already been erased from
+        // dataStreams (or the connection state is being destroyed)
+        if (event->SHUTDOWN_COMPLETE.AppCloseInProgress) {
+          delete streamContext;
+          break;
+        }
+        streamContext->sendShutdown_.store(true, std::memory_order_release);
+        // the stream is still in dataStreams (or the stream pool) and sends
+        // go through its context
+        streamContext->connectionState_.on_data_stream_shutdown(dataStream,
+                                                                streamContext);
         break;
       }
 
@@ -184,7 +275,6 @@ static constexpr auto client_data_stream_callback =
     [](HQUIC dataStream, void *context, QUIC_STREAM_EVENT *event) {
       StreamContext *streamContext = static_cast<StreamContext *>(context);
       ConnectionState &connectionState = streamContext->connectionState_;
-      MOQT &moqtObject = streamContext->moqtObject_;
 
       // TODO: wait for stream setup
       switch (event->Type) {
@@ -195,32 +285,19 @@ static constexpr auto client_data_stream_callback =
       case QUIC_STREAM_EVENT_RECEIVE: {
         // accumulate all data messages received and read them when closing
         // stream
-        for (std::uint64_t bufferIndex = 0;
-             bufferIndex < event->RECEIVE.BufferCount; bufferIndex++) {
-          const QUIC_BUFFER *buffer = &event->RECEIVE.Buffers[bufferIndex];
-
-          // make a copy of the buffer, we do not need a copy, but there seems
-          // to be a bug in MsQuic with lifetime management of the buffers in
-          // MultiReceive Mode
-          QUIC_BUFFER *newBuffer =
-              (QUIC_BUFFER *)malloc(sizeof(QUIC_BUFFER) + buffer->Length);
-          newBuffer->Length = buffer->Length;
-          newBuffer->Buffer = (uint8_t *)newBuffer + sizeof(QUIC_BUFFER);
-          std::memcpy(newBuffer->Buffer, buffer->Buffer, buffer->Length);
-
-          streamContext->deserializer_->append_buffer(UniqueQuicBuffer(
-              newBuffer,
-              rvn::QUIC_BUFFERDeleter(
-                  dataStream, moqtObject.get_tbl()->StreamReceiveComplete)));
-        }
-
-        // https://github.com/microsoft/msquic/blob/f96015560399d60cbdd8608b6fa2120560118500/docs/Streams.md#synchronous-vs-asynchronous
-        // we are consuming the buffer in the callback because we are making a
-        // copy
-        return QUIC_STATUS_SUCCESS;
-        break;
+        if (streamContext->moqtObject_.receiveHandoff)
+          return hand_off_buffers(dataStream, *streamContext, event->RECEIVE);
+        return receive_buffers(dataStream, *streamContext, event->RECEIVE);
       }
       case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE: {
+        // queued buffers of the stream have to be parsed first
+        if (streamContext->moqtObject_.receiveHandoff) {
+          connectionState.receivedBuffers_.push(
+              {dataStream, streamContext,
+               UniqueQuicBuffer(nullptr, QUIC_BUFFERDeleter(NULL, nullptr))});
+          break;
+        }
+        streamContext->deserializer_->detach_stream();
         connectionState.delete_data_stream(dataStream);
         break;
       }
@@ -237,7 +314,6 @@ static constexpr auto client_control_stream_callback =
     []([[maybe_unused]] HQUIC controlStream, void *context,
        QUIC_STREAM_EVENT *event) {
       StreamContext *streamContext = static_cast<StreamContext *>(context);
-      MOQT &moqtObject = streamContext->moqtObject_;
 
       utils::wait_for(streamContext->streamHasBeenConstructed);
       // moqtObject.get_tbl()->StreamReceiveSetEnabled(controlStream, true);
@@ -248,30 +324,7 @@ static constexpr auto client_control_stream_callback =
         break;
       }
       case QUIC_STREAM_EVENT_RECEIVE: {
-        for (std::uint64_t bufferIndex = 0;
-             bufferIndex < event->RECEIVE.BufferCount; bufferIndex++) {
-          const QUIC_BUFFER *buffer = &event->RECEIVE.Buffers[bufferIndex];
-
-          // make a copy of the buffer, we do not need a copy, but there seems
-          // to be a bug in MsQuic with lifetime management of the buffers in
-          // MultiReceive Mode
-          QUIC_BUFFER *newBuffer =
-              (QUIC_BUFFER *)malloc(sizeof(QUIC_BUFFER) + buffer->Length);
-          newBuffer->Length = buffer->Length;
-          newBuffer->Buffer = (uint8_t *)newBuffer + sizeof(QUIC_BUFFER);
-          std::memcpy(newBuffer->Buffer, buffer->Buffer, buffer->Length);
-
-          streamContext->deserializer_->append_buffer(UniqueQuicBuffer(
-              newBuffer,
-              rvn::QUIC_BUFFERDeleter(
-                  controlStream, moqtObject.get_tbl()->StreamReceiveComplete)));
-        }
-
-        // https://github.com/microsoft/msquic/blob/f96015560399d60cbdd8608b6fa2120560118500/docs/Streams.md#synchronous-vs-asynchronous
-        // we are consuming the buffer in the callback because we are making a
-        // copy
-        return QUIC_STATUS_SUCCESS;
-        break;
+        return receive_buffers(controlStream, *streamContext, event->RECEIVE);
       }
       case QUIC_STREAM_EVENT_SEND_COMPLETE: {
         // Buffer has been sent
@@ -285,6 +338,10 @@ static constexpr auto client_control_stream_callback =
         delete streamSendContext;
         break;
       }
+      case QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE: {
+        streamContext->deserializer_->detach_stream();
+        break;
+      }
       default:
         break;
       }
@@ -294,7 +351,6 @@ static constexpr auto client_control_stream_callback =
 static constexpr auto client_connection_callback =
     [](HQUIC connectionHandle, void *Context, QUIC_CONNECTION_EVENT *event) {
       MOQTClient *moqtClient = static_cast<MOQTClient *>(Context);
-      const QUIC_API_TABLE *MsQuic = moqtClient->get_tbl();
 
       // wait until setup is done, once setup is done, flag is reset to false
       utils::wait_for(moqtClient->quicConnectionStateSetupFlag_);
@@ -316,9 +372,11 @@ static constexpr auto client_connection_callback =
         // The connection has completed the shutdown process and is
         // ready to be safely cleaned up.
         std::cout << "[conn][" << connectionHandle << "] All done" << std::endl;
-        if (!event->SHUTDOWN_COMPLETE.AppCloseInProgress) {
-          MsQuic->ConnectionClose(connectionHandle);
-        }
+        // the handle is owned (and closed) by the connection state
+        moqtClient->connectionShutdownFlag_.store(true,
+                                                  std::memory_order_release);
+        // fetches whose stream has arrived end with the stream
+        moqtClient->finish_pending_fetches();
         break;
       }
       case QUIC_CONNECTION_EVENT_PEER_STREAM_STARTED: {
@@ -328,6 +386,11 @@ static constexpr auto client_connection_callback =
 
         break;
       }
+      case QUIC_CONNECTION_EVENT_DATAGRAM_RECEIVED: {
+        // the buffer is only valid during the callback
+        moqtClient->accept_datagram(*event->DATAGRAM_RECEIVED.Buffer);
+        break;
+      }
       default:
         break;
       }
@@ -0,0 +1,120 @@
+#pragma once
+/////////////////////////////////////////////
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+/////////////////////////////////////////////
+#include <msquic.h>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+struct ConnectionState;
+
+// called by the server when a connection is accepted and when it is released
+// (QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE), hooks run on msquic workers
+struct ConnectionLifecycleHooks {
+  std::function<void(ConnectionState &)> onConnectionAccepted_;
+  std::function<void(ConnectionState &)> onConnectionClosed_;
+};
+
+/*
+    Owns the connection states of the server
+    Connections are only added and removed here, lookups from msquic callbacks
+    go through the connection context (see MOQTServer::get_connection_state)
+    and do not touch the registry
+    The map is sharded by connection handle so that connection storms do not
+    all serialize on a single writer lock
+*/
+class ConnectionRegistry {
+  static constexpr std::size_t numShards = 16;
+
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mtx_;
+    std::unordered_map<HQUIC, std::shared_ptr<ConnectionState>> connections_;
+  };
+  std::array<Shard, numShards> shards_;
+  std::atomic<std::size_t> size_{};
+
+  Shard &shard(HQUIC connection) noexcept {
+    // handles are heap allocated, low bits are always the same
+    auto bits = reinterpret_cast<std::uintptr_t>(connection);
+    return shards_[(bits >> 6) % numShards];
+  }
+  const Shard &shard(HQUIC connection) const noexcept {
+    return const_cast<ConnectionRegistry *>(this)->shard(connection);
+  }
+
+public:
+  // returns false if the connection is already registered
+  bool insert(HQUIC connection, std::shared_ptr<ConnectionState> state) {
+    Shard &s = shard(connection);
+    std::unique_lock l(s.mtx_);
+    bool inserted = s.connections_.emplace(connection, std::move(state)).second;
+    if (inserted)
+      size_.fetch_add(1, std::memory_order_relaxed);
+    return inserted;
+  }
+
+  // the state is returned so that it is released without holding the lock,
+  // releasing the last reference closes the connection
+  std::shared_ptr<ConnectionState> erase(HQUIC connection) {
+    Shard &s = shard(connection);
+    std::unique_lock l(s.mtx_);
+    auto iter = s.connections_.find(connection);
+    if (iter == s.connections_.end())
+      return nullptr;
+
+    std::shared_ptr<ConnectionState> state = std::move(iter->second);
+    s.connections_.erase(iter);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return state;
+  }
+
+  std::shared_ptr<ConnectionState> find(HQUIC connection) const {
+    const Shard &s = shard(connection);
+    std::shared_lock l(s.mtx_);
+    auto iter = s.connections_.find(connection);
+    if (iter == s.connections_.end())
+      return nullptr;
+    return iter->second;
+  }
+
+  // f is called with the shard lock held, it should not add or remove
+  // connections
+  template <typename F> void for_each(F &&f) const {
+    for (const Shard &s : shards_) {
+      std::shared_lock l(s.mtx_);
+      for (const auto &[connection, state] : s.connections_)
+        f(*state);
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  // removes all connections, the states are released after the locks are
+  // dropped
+  std::vector<std::shared_ptr<ConnectionState>> clear() {
+    std::vector<std::shared_ptr<ConnectionState>> states;
+    for (Shard &s : shards_) {
+      std::unique_lock l(s.mtx_);
+      for (auto &[connection, state] : s.connections_)
+        states.push_back(std::move(state));
+      size_.fetch_sub(s.connections_.size(), std::memory_order_relaxed);
+      s.connections_.clear();
+    }
+    return states;
+  }
+};
+
+} // namespace rvn
@@ -1,17 +1,26 @@
 #pragma once
 //////////////////////////////
 #include <data_manager.hpp>
+#include <deadline_heap.hpp>
 #include <serialization/messages.hpp>
 #include <strong_types.hpp>
 //////////////////////////////
+#include <array>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <unordered_map>
 //////////////////////////////
 #include <definitions.hpp>
 #include <deserializer.hpp>
+#include <fetch_stream.hpp>
 #include <message_handler.hpp>
+#include <object_pool.hpp>
 #include <serialization/serialization.hpp>
+#include <spsc_queue.hpp>
 #include <utilities.hpp>
 #include <variant>
 #include <wrappers.hpp>
@@ -22,6 +31,18 @@
 namespace rvn {
 enum class StreamType { CONTROL, DATA };
 
+/*
+    Bounds on the data handed to msquic but not yet acknowledged through
+    QUIC_STREAM_EVENT_SEND_COMPLETE, per connection
+    Subscriptions pause once outstanding bytes go above highWaterMark_ and
+    resume once they drop to lowWaterMark_, so a slow client can not make the
+    server buffer an unbounded backlog
+*/
+struct SendWatermarks {
+  std::uint64_t highWaterMark_ = 4 * 1024 * 1024;
+  std::uint64_t lowWaterMark_ = 1024 * 1024;
+};
+
 struct StreamContext {
   TimePoint streamCreationTimePoint_;
   std::atomic_bool streamHasBeenConstructed{};
@@ -33,12 +54,17 @@ struct StreamContext {
    */
   struct ConnectionState &connectionState_;
   /*
-      We can not have operator= for Deserializer because it contains
-      a non movable object (std::mutex)
+      We can not have operator= for Deserializer because its message handler
+      holds a reference to the StreamState
       We can not construct it in constructor because it requires
       StreamState which requires rvn::unique_stream which requires StreamContext
   */
   std::optional<serialization::Deserializer<MessageHandler>> deserializer_;
+  // bytes sent on this stream for which SEND_COMPLETE is pending
+  std::atomic<std::uint64_t> outstandingBytes_{};
+  // set on the MsQuic worker once the sending side of a data stream has been
+  // shut down, sends on the stream fail from then on
+  std::atomic_bool sendShutdown_{};
   StreamContext(MOQT &moqtObject, ConnectionState &connectionState)
       : streamCreationTimePoint_(Clock::now()), moqtObject_(moqtObject),
         connectionState_(connectionState) {};
@@ -46,6 +72,14 @@ struct StreamContext {
   // deserializer can not be constructed in the constructor and has to be done
   // seperately
   void construct_deserializer(StreamState &streamState, bool isControlStream);
+
+  // created for every data stream and deleted on the msquic worker
+  static void *operator new(std::size_t) {
+    return ObjectPool<StreamContext>::allocate();
+  }
+  static void operator delete(void *streamContext) noexcept {
+    ObjectPool<StreamContext>::deallocate(streamContext);
+  }
 };
 
 class StreamSendContext {
@@ -55,20 +89,44 @@ public:
   std::uint32_t bufferCount;
 
   // non owning reference
-  const StreamContext *streamContext;
-
-  std::function<void(StreamSendContext *)> sendCompleteCallback =
-      utils::NoOpVoid<StreamSendContext *>;
+  StreamContext *streamContext;
+
+  // bytes counted in the outstanding bytes of the stream and connection,
+  // 0 for sends which are not accounted (control messages)
+  std::uint64_t accountedBytes = 0;
+
+  // plain function pointer so that a send does not allocate for its callback,
+  // state needed by the callback goes in sendCompleteCallbackContext
+  using SendCompleteCallback = void (*)(StreamSendContext *);
+  SendCompleteCallback sendCompleteCallback = nullptr;
+  void *sendCompleteCallbackContext = nullptr;
+
+  // object header shared by all objects of a batch on a track or fetch stream
+  // (group id, subgroup id and publisher priority at most), the QUIC_BUFFERs
+  // of the headers point into it so it lives as long as the send
+  static constexpr std::size_t maxObjectHeaderSize =
+      2 * sizeof(std::uint64_t) + sizeof(std::uint8_t);
+  std::array<std::uint8_t, maxObjectHeaderSize> objectHeader{};
+  std::uint32_t objectHeaderSize = 0;
+
+  // copies the header into objectHeader, returns the buffer referencing it
+  QUIC_BUFFER set_object_header(std::span<const std::uint8_t> header) {
+    utils::ASSERT_LOG_THROW(header.size() <= objectHeader.size(),
+                            "object header does not fit", header.size());
+    std::memcpy(objectHeader.data(), header.data(), header.size());
+    objectHeaderSize = header.size();
+    return {objectHeaderSize, objectHeader.data()};
+  }
 
-  StreamSendContext(
-      QUIC_BUFFER *buffer_, const std::uint32_t bufferCount_,
-      const StreamContext *streamContext_,
-      std::function<void(StreamSendContext *)> sendCompleteCallback_ =
-          utils::NoOpVoid<StreamSendContext *>)
+  StreamSendContext(QUIC_BUFFER *buffer_, const std::uint32_t bufferCount_,
+                    StreamContext *streamContext_,
+                    SendCompleteCallback sendCompleteCallback_ = nullptr,
+                    void *sendCompleteCallbackContext_ = nullptr)
       : buffer(buffer_), bufferCount(bufferCount_),
         streamContext(streamContext_),
-        sendCompleteCallback(sendCompleteCallback_) {
-    utils::ASSERT_LOG_THROW(bufferCount == 1, "bufferCount should be 1",
+        sendCompleteCallback(sendCompleteCallback_),
+        sendCompleteCallbackContext(sendCompleteCallbackContext_) {
+    utils::ASSERT_LOG_THROW(bufferCount >= 1, "bufferCount should be >= 1",
                             bufferCount);
   }
 
@@ -84,7 +142,46 @@ public:
   }
 
   // callback called when the send is succsfull
-  void send_complete_cb() { sendCompleteCallback(this); }
+  void send_complete_cb() {
+    if (sendCompleteCallback != nullptr)
+      sendCompleteCallback(this);
+  }
+
+  // one is created for every send (or batch of sends)
+  static void *operator new(std::size_t) {
+    return ObjectPool<StreamSendContext>::allocate();
+  }
+  static void operator delete(void *streamSendContext) noexcept {
+    ObjectPool<StreamSendContext>::deallocate(streamSendContext);
+  }
+};
+
+/*
+    Send context of an OBJECT_DATAGRAM
+    The datagram header is serialized into the context and the object is sent
+    straight out of the group cache (after its object id, which is part of the
+    header), so sending a datagram does not copy the payload
+*/
+struct DatagramSendContext {
+  // type, track alias, group id and object id (var ints, at most 8 bytes
+  // each) and publisher priority
+  static constexpr std::size_t maxHeaderSize = 4 * 8 + 1;
+  std::uint8_t header_[maxHeaderSize];
+  QUIC_BUFFER buffers_[2];
+  // non owning reference
+  struct ConnectionState *connectionState_;
+  // bytes counted in the outstanding bytes of the connection
+  std::uint64_t accountedBytes_ = 0;
+
+  explicit DatagramSendContext(struct ConnectionState &connectionState)
+      : connectionState_(std::addressof(connectionState)) {}
+
+  static void *operator new(std::size_t) {
+    return ObjectPool<DatagramSendContext>::allocate();
+  }
+  static void operator delete(void *datagramSendContext) noexcept {
+    ObjectPool<DatagramSendContext>::deallocate(datagramSendContext);
+  }
 };
 
 struct StreamState {
@@ -112,14 +209,118 @@ public:
   // To be used by subscriber to receive objects on this stream
   std::shared_ptr<MPMCQueue<StreamHeaderSubgroupObject>> objectQueue_;
   std::shared_ptr<StreamHeaderSubgroupMessage> streamHeaderSubgroupMessage_;
+  // set instead of streamHeaderSubgroupMessage_ on track streams, on the
+  // client streamHeaderSubgroupMessage_ is then the header of the group of
+  // the last received object
+  std::shared_ptr<StreamHeaderTrackMessage> streamHeaderTrackMessage_;
+  // set on streams which carry the objects of a FETCH
+  std::shared_ptr<FetchHeaderMessage> fetchHeaderMessage_;
+  // client, where the objects of the fetch go
+  std::shared_ptr<FetchStream> fetchStream_;
+
+  // delivery timeout of the stream, see DataStreams::set_deadline
+  TimePoint deadline_;
+  std::size_t deadlineHeapIndex_ = DeadlineHeap<DataStreamState>::npos;
 
   DataStreamState(rvn::unique_stream &&stream,
                   struct ConnectionState &connectionState);
-  bool can_send_object(const ObjectIdentifier &objectIdentifier) const noexcept;
   void set_header(StreamHeaderSubgroupMessage streamHeaderSubgroupMessage);
+  void set_header(StreamHeaderTrackMessage streamHeaderTrackMessage);
+  void set_header(FetchHeaderMessage fetchHeaderMessage);
   std::weak_ptr<void> get_life_time_flag() const noexcept;
 };
 
+// identifies the subgroup carried by a data stream
+struct DataStreamKey {
+  TrackAlias trackAlias_;
+  GroupId groupId_;
+  SubGroupId subgroupId_;
+
+  bool operator==(const DataStreamKey &) const = default;
+
+  struct Hash {
+    std::size_t operator()(const DataStreamKey &key) const noexcept {
+      std::size_t hash = key.trackAlias_.hash();
+      hash = hash * 31 + key.groupId_.hash();
+      hash = hash * 31 + key.subgroupId_.hash();
+      return hash;
+    }
+  };
+};
+
+/*
+    Data streams of a connection
+    Streams we send on are indexed by the subgroup they carry so that looking
+    up the stream of an object is a single hash lookup instead of a scan over
+    all streams (which also had to resolve the track alias of every stream)
+    Track streams (DeliveryMode::Track) are indexed by track alias and fetch
+    streams by the subscribe id of the FETCH, till their last object is sent
+*/
+class DataStreams {
+  StableContainer<DataStreamState> streams_;
+  std::unordered_map<DataStreamKey, DataStreamState *, DataStreamKey::Hash>
+      subgroupIndex_;
+  std::unordered_map<std::uint64_t, DataStreamState *> trackIndex_;
+  std::unordered_map<std::uint64_t, DataStreamState *> fetchIndex_;
+  std::unordered_map<HQUIC, StableContainer<DataStreamState>::iterator>
+      handleIndex_;
+
+  /*
+      Streams with a delivery timeout, by deadline
+      Streams are removed from the heap when they are erased, so deadlines of
+      streams which are gone never fire. Streams are also erased when MsQuic
+      shuts them down (ConnectionState::on_data_stream_shutdown), before their
+      StreamContext is freed, so the context of every stream in the heap is
+      alive. Streams whose sending side MsQuic has shut down are not added
+      When a deadline passes, the stream is aborted and erased if it still
+      has bytes waiting for SEND_COMPLETE (outstandingBytes_). A stream which
+      has delivered everything, or which MsQuic has shut down, is only dropped
+      from the heap and is not aborted
+  */
+  DeadlineHeap<DataStreamState> deadlines_;
+  // earliest deadline a timer has been added for
+  std::optional<TimePoint> armedDeadline_;
+
+  void erase(StableContainer<DataStreamState>::iterator iter);
+
+public:
+  DataStreamState &emplace_back(rvn::unique_stream &&stream,
+                                ConnectionState &connectionState);
+  // sets the header of the stream and indexes it by the subgroup it carries
+  void set_header(DataStreamState &streamState,
+                  StreamHeaderSubgroupMessage streamHeaderSubgroupMessage);
+  void set_header(DataStreamState &streamState,
+                  StreamHeaderTrackMessage streamHeaderTrackMessage);
+  void set_header(DataStreamState &streamState,
+                  FetchHeaderMessage fetchHeaderMessage);
+
+  DataStreamState *find(const DataStreamKey &key) const;
+  DataStreamState *find(TrackAlias trackAlias) const;
+  DataStreamState *find(HQUIC streamHandle) const;
+  DataStreamState *find_fetch(std::uint64_t subscribeId) const;
+
+  void erase(HQUIC streamHandle);
+  void erase(const DataStreamKey &key);
+  // the stream is kept till it is done sending, it is only taken out of the
+  // fetch index. The state (and the handle) go away once MsQuic shuts the
+  // stream down after the FIN is acknowledged, see
+  // ConnectionState::on_data_stream_shutdown
+  void finish_fetch(std::uint64_t subscribeId);
+
+  std::size_t size() const noexcept { return streams_.size(); }
+
+  // returns true if a timer has to be added for the deadline, that is no timer
+  // fires at or before it
+  bool set_deadline(DataStreamState &streamState, TimePoint deadline);
+  /*
+      Aborts all streams whose deadline has passed and which still have data
+      in flight, streams which have delivered everything are just dropped from
+      the heap
+      Returns the deadline for which a timer has to be added, if any
+  */
+  std::optional<TimePoint> expire_deadlines(TimePoint now);
+};
+
 struct ConnectionState : std::enable_shared_from_this<ConnectionState> {
   // StreamManager
   // //////////////////////////////////////////////////////////////
@@ -144,31 +345,161 @@ struct ConnectionState : std::enable_shared_from_this<ConnectionState> {
   std::optional<TrackAlias>
   identifier_to_alias(const TrackIdentifier &trackIdentifier);
 
-  RWProtected<StableContainer<DataStreamState>> dataStreams;
+  RWProtected<DataStreams> dataStreams;
+
+  // Ready while the connection can take more data, subscriptions wait on it
+  // before handing objects to the connection
+  ObjectWaitSignal sendWindowSignal_ =
+      std::make_shared<std::atomic<ObjectWaitStatus>>(ObjectWaitStatus::Ready);
+  ObjectWaitSignal get_send_window_signal() const noexcept {
+    return sendWindowSignal_;
+  }
+
+  // bytes sent on data streams for which SEND_COMPLETE is pending (and
+  // datagrams which have not reached a final send state)
+  std::atomic<std::uint64_t> outstandingBytes_{};
+  SendWatermarks sendWatermarks_;
+  // update outstandingBytes_ and the send window signal
+  void add_outstanding_bytes(std::uint64_t numBytes);
+  void remove_outstanding_bytes(std::uint64_t numBytes);
+  // should be called before StreamSend, SEND_COMPLETE can race with the return
+  void on_data_send(StreamSendContext &streamSendContext);
+  // called on SEND_COMPLETE and when StreamSend fails
+  void on_data_send_complete(StreamSendContext &streamSendContext);
+  std::uint64_t get_outstanding_bytes() const noexcept {
+    return outstandingBytes_.load(std::memory_order_relaxed);
+  }
+
+  // largest datagram the peer accepts, 0 while datagrams can not be sent
+  std::atomic<std::uint16_t> maxDatagramSendLength_{};
+  // QUIC_CONNECTION_EVENT_DATAGRAM_STATE_CHANGED
+  void on_datagram_state_changed(bool sendEnabled, std::uint16_t maxSendLength);
+  // called when the datagram reaches a final send state
+  void on_datagram_send_complete(DatagramSendContext &datagramSendContext);
 
   std::optional<StreamState> controlStream;
 
   void delete_data_stream(HQUIC streamHandle);
+  /*
+      SHUTDOWN_COMPLETE of a server data stream which was not closed by us
+      (peer reset or STOP_SENDING, the FIN has been acknowledged or the
+      connection went away, which also shuts down pooled streams). The stream
+      is taken out of the pool and erased from dataStreams before its context
+      is freed, sends look the context up through dataStreams
+      Both are done on the timer thread, the MsQuic worker must not wait on
+      the dataStreams lock, threads holding it close streams and StreamClose
+      waits on the worker
+  */
+  void on_data_stream_shutdown(HQUIC streamHandle,
+                               StreamContext *streamContext);
   void enqueue_data_buffer(QUIC_BUFFER *buffer);
 
+  /*
+      Receive handoff (MOQT::set_receiveHandoff)
+      The receive callbacks of data streams only queue copies of the buffers,
+      they are parsed by the application thread in process_received_buffers
+      so that handling payloads does not hold up the MsQuic worker (and the
+      ACKs it sends)
+      MsQuic delivers the events of a connection on one worker, which is the
+      single producer, process_received_buffers should only be called from
+      one thread (single consumer)
+      A stream which has been shut down is queued with an empty buffer and is
+      deleted once the consumer gets to it
+  */
+  struct ReceivedBuffer {
+    HQUIC stream_;
+    StreamContext *streamContext_;
+    UniqueQuicBuffer buffer_;
+  };
+  SPSCQueue<ReceivedBuffer> receivedBuffers_;
+  // parses up to maxBuffers queued buffers, returns the number processed
+  std::size_t process_received_buffers(std::size_t maxBuffers);
+
   QUIC_STATUS send_object(std::weak_ptr<DataStreamState> dataStream,
                           const ObjectIdentifier &objectIdentifier,
                           QUIC_BUFFER *buffer);
+  // trackAlias is the alias the subscriber gave the track of objectIdentifier,
+  // it is passed in so that sending does not go through the alias map
+  // every subgroup is sent on its own stream
   QUIC_STATUS
-  send_object(const ObjectIdentifier &objectIdentifier, QUIC_BUFFER *buffer,
+  send_object(TrackAlias trackAlias, SubGroupId subgroupId,
+              const ObjectIdentifier &objectIdentifier, QUIC_BUFFER *buffer,
               std::optional<std::chrono::milliseconds> timeoutDuration);
+  // returned by the send functions below when the stream of the objects has
+  // been shut down by MsQuic (peer STOP_SENDING) but is not erased yet, the
+  // connection is still usable. StreamSend never returns it
+  static constexpr QUIC_STATUS StreamShutdownStatus =
+      QUIC_STATUS_STREAM_LIMIT_REACHED;
+  // sends all the buffers in a single StreamSend, all objects should belong to
+  // the same subgroup as objectIdentifier
+  // with delaySend the data is queued with QUIC_SEND_FLAG_DELAY_SEND and is
+  // only sent after flush_delayed_sends
+  QUIC_STATUS
+  send_objects(TrackAlias trackAlias, SubGroupId subgroupId,
+               const ObjectIdentifier &objectIdentifier,
+               std::span<QUIC_BUFFER *const> buffers,
+               std::optional<std::chrono::milliseconds> timeoutDuration,
+               bool delaySend = false);
+  /*
+      Sends the objects on the stream of the track (DeliveryMode::Track), all
+      objects should belong to the group of objectIdentifier
+      There is no delivery timeout, aborting the stream would drop all later
+      objects of the track
+  */
+  QUIC_STATUS send_track_objects(TrackAlias trackAlias,
+                                 const ObjectIdentifier &objectIdentifier,
+                                 std::span<QUIC_BUFFER *const> buffers,
+                                 bool delaySend = false);
+  /*
+      Sends objects of a FETCH on its stream, the stream is opened with
+      FETCH_HEADER on the first call, all objects should belong to groupId
+      and subgroupId
+      With fin the stream is ended after the objects (buffers may be empty),
+      that is how the client learns the range is done
+  */
+  QUIC_STATUS send_fetch_objects(std::uint64_t subscribeId, GroupId groupId,
+                                 SubGroupId subgroupId,
+                                 PublisherPriority publisherPriority,
+                                 std::span<QUIC_BUFFER *const> buffers,
+                                 bool fin, bool delaySend = false);
+
+  /*
+      Delayed sends
+      Streams with data queued with QUIC_SEND_FLAG_DELAY_SEND, they are
+      flushed together so that objects of different subscriptions share
+      packets
+      set_flush_pending returns true if the caller is the one which has to
+      call flush_delayed_sends (once it has queued everything it has)
+  */
+  std::mutex delayedStreamsMtx_;
+  std::vector<HQUIC> delayedStreams_;
+  std::atomic<bool> flushPending_{};
+  bool set_flush_pending();
+  void flush_delayed_sends();
+  /*
+      Sends a cached object (serialized StreamHeaderSubgroupObject) as an
+      OBJECT_DATAGRAM
+      Returns QUIC_STATUS_BUFFER_TOO_SMALL without sending if the object does
+      not fit in a datagram (or the peer does not accept datagrams), such
+      objects should be sent on a stream
+  */
+  QUIC_STATUS send_datagram(TrackAlias trackAlias, GroupId groupId,
+                            PublisherPriority publisherPriority,
+                            QUIC_BUFFER *object);
   void send_control_buffer(QUIC_BUFFER *buffer,
                            QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_NONE);
   /////////////////////////////////////////////////////////////////////////////
 
-  unique_connection connection_;
+  // declared before connection_, closing the connection delivers
+  // SHUTDOWN_COMPLETE to a callback which goes through moqtObject_
   MOQT &moqtObject_;
+  unique_connection connection_;
 
   std::string path;
   // TODO: role
 
   ConnectionState(unique_connection &&connection, class MOQT &moqtObject)
-      : connection_(std::move(connection)), moqtObject_(moqtObject) {}
+      : moqtObject_(moqtObject), connection_(std::move(connection)) {}
 
   std::optional<StreamState> &get_control_stream();
   const std::optional<StreamState> &get_control_stream() const;
@@ -179,7 +510,50 @@ struct ConnectionState : std::enable_shared_from_this<ConnectionState> {
 
   StreamState &establish_control_stream();
 
-  void abort_if_sending(const ObjectIdentifier &oid);
+  // aborts the stream of the subgroup
+  void abort_if_sending(TrackAlias trackAlias, SubGroupId subgroupId,
+                        const ObjectIdentifier &oid);
+
+  /*
+      Pre-opened data streams
+      Opening and starting a stream is taken off the path of the first object
+      of a group, open_data_stream takes a stream from the pool and the pool
+      is refilled on the timer thread
+      The pool is first filled when the peer subscribes, before that nothing
+      is sent on data streams
+  */
+  static constexpr std::size_t dataStreamPoolSize = 4;
+  std::mutex dataStreamPoolMtx_;
+  std::vector<std::tuple<rvn::unique_stream, StreamContext *>> dataStreamPool_;
+  std::atomic<bool> dataStreamPoolRefillPending_{};
+  // refills the pool asynchronously, does nothing if a refill is pending
+  void refill_data_stream_pool();
+  void fill_data_stream_pool();
+
+  // takes the stream out of the pool if MsQuic shut it down while it was
+  // pooled, its context is about to be freed
+  void discard_pooled_data_stream(HQUIC streamHandle);
+
+  // started unidirectional data stream, from the pool if it is not empty
+  // should be called with the dataStreams writer lock held and the stream put
+  // in dataStreams before it is released
+  std::tuple<rvn::unique_stream, StreamContext *> open_data_stream();
+  std::tuple<rvn::unique_stream, StreamContext *> create_data_stream();
+  // StreamSend of objects, with delaySend the stream is added to
+  // delayedStreams_, with fin the stream is ended
+  QUIC_STATUS send_data(HQUIC streamHandle, QUIC_BUFFER *buffers,
+                        std::uint32_t bufferCount,
+                        StreamSendContext *streamSendContext, bool delaySend,
+                        bool fin = false);
+  // should be called with the dataStreams lock held
+  QUIC_STATUS send_data_stream_header(DataStreamState &streamState,
+                                      QUIC_BUFFER *header,
+                                      PublisherPriority publisherPriority);
+
+  // Delivery timeouts are tracked per stream in dataStreams and processed in
+  // a batch by a single timer callback
+  void add_deadline_timer(TimePoint deadline);
+  void process_deadlines();
 };
 
 } // namespace rvn
@@ -86,6 +86,14 @@ struct DoesNotExist {
 */
 enum class ObjectWaitStatus { Wait, Ready };
 using ObjectWaitSignal = std::shared_ptr<std::atomic<ObjectWaitStatus>>;
+
+/*
+    Bumped whenever a group or subgroup is added to a track
+    Open ended subscriptions compare it against the last value they have seen
+    to discover new groups, this way they do not have to walk the group map on
+    every iteration
+*/
+using GroupSequenceCounter = std::shared_ptr<std::atomic<std::uint64_t>>;
 using ObjectType =
     std::tuple<QUIC_BUFFER *, std::optional<std::chrono::milliseconds>>;
 using ObjectOrStatus = std::variant<ObjectType, ObjectWaitSignal, DoesNotExist>;
@@ -151,8 +159,14 @@ public:
 };
 
 class ObjectIdentifier : public GroupIdentifier {
-  // we cache the subgroup id within the object identifier
-  mutable std::optional<SubGroupId> subgroupId_;
+  // we cache the subgroup id within the object identifier, along with the
+  // object it was computed for as groupId_ and objectId_ are mutable
+  struct CachedSubgroupId {
+    GroupId groupId_;
+    ObjectId objectId_;
+    SubGroupId subgroupId_;
+  };
+  mutable std::optional<CachedSubgroupId> subgroupId_;
 
 public:
   ObjectId objectId_;
@@ -175,6 +189,15 @@ public:
                    ObjectId objectId);
 };
 
+/*
+    Publisher metadata describing how objects depend on each other
+    Base layer objects are needed to decode the enhancement layers built on top
+    of them, so they are never dropped. Enhancement layers may be dropped under
+    congestion (LatestPerGroupInTrack aborts them when a newer object is ready)
+    Unmarked groups are Enhancement, which keeps the latest only behaviour
+*/
+enum class LayerType : std::uint8_t { Enhancement, Base };
+
 class SubgroupHandle {
   friend class DataManager;
   friend class GroupHandle;
@@ -184,13 +207,15 @@ class SubgroupHandle {
   ObjectId beginObjectId_;
   ObjectId endObjectId_;
   std::uint64_t numObjects_; // number of objects added using add_object
+  // inherited by the subgroup returned by cap_and_next
+  LayerType layerType_;
 
   SubgroupHandle(std::weak_ptr<GroupHandle> groupHandle,
                  DataManager &dataManager, ObjectId beginObjectId,
-                 ObjectId endObjectId)
+                 ObjectId endObjectId, LayerType layerType)
       : groupHandle_(groupHandle), dataManager_(dataManager),
         beginObjectId_(beginObjectId), endObjectId_(endObjectId),
-        numObjects_(0) {}
+        numObjects_(0), layerType_(layerType) {}
 
 public:
   bool add_object(std::string object);
@@ -213,6 +238,8 @@ public:
   GroupIdentifier groupIdentifier_;
   PublisherPriority publisherPriority_;
   std::optional<std::chrono::milliseconds> deliveryTimeout_;
+  // layer of subgroups which do not specify one
+  LayerType layerType_;
   class DataManager &dataManager_;
 
   GroupHandle &operator=(const GroupHandle &) = delete;
@@ -235,7 +262,7 @@ private:
   // stores number of concrete objects that is, objects which have been stored
   std::atomic<std::uint64_t> numStoredObjects_;
 
-  std::shared_mutex objectIdsMtx_;
+  mutable std::shared_mutex objectIdsMtx_;
   std::set<std::uint64_t, Comparator> objectIds_;
 
   struct ObjectIdHash {
@@ -246,6 +273,9 @@ private:
 
   using ObjectIdEqual = std::equal_to<ObjectId>;
 
+  // stored objects, an object which is stored but whose buffer is not
+  // cached maps to nullptr (get_object reads it back from disk). Objects
+  // which are not in the map have not been stored yet
   RWProtected<
       std::unordered_map<ObjectId, QUIC_BUFFER *, ObjectIdHash, ObjectIdEqual>>
       groupCache_;
@@ -253,34 +283,60 @@ private:
                                  ObjectIdEqual>>
       objectWaitSignals_;
 
+  // indexed by subgroup id, protected by objectIdsMtx_
+  // subgroups are contiguous, so the subgroup of an object is found with a
+  // binary search over the begin object ids
+  std::vector<std::uint64_t> subgroupBeginObjectIds_;
+  std::vector<LayerType> subgroupLayerTypes_;
+  // size of subgroupBeginObjectIds_, read without objectIdsMtx_ to find out
+  // whether an open ended subgroup has been followed by another one
+  std::atomic<std::size_t> numSubgroups_{};
+
+  // objectIdsMtx_ should be held
+  std::optional<std::size_t> get_subgroup_index(ObjectId objectId) const;
+
+  // shared with the owning track, set by TrackHandle::add_group
+  GroupSequenceCounter trackGroupSequence_;
+  void bump_track_group_sequence();
+
 public:
   GroupHandle(GroupIdentifier groupIdentifier,
               PublisherPriority publisherPriority_,
               std::optional<std::chrono::milliseconds> deliveryTimeout,
-              DataManager &dataManagerHandle);
-
-  SubgroupHandle add_subgroup(std::uint64_t numElements);
-  SubgroupHandle add_open_ended_subgroup();
-
-  SubGroupId get_subgroup_id(ObjectId objectId) const {
-    std::uint64_t objectIdInt = objectId.get();
-
-    /*
-        begin is small
-        end is capital
-
-             x                                        -> upper bound gives 1,
-       subgroup id is 0 x                                -> x == e0, upper bound
-       gives 2, subgroup id is 1 [b0     e0) [e0     e1) [e1     e2) [e2     e3)
-    */
-    auto iter = objectIds_.upper_bound(objectIdInt);
-    if (iter == objectIds_.begin())
-      throw std::invalid_argument("ObjectId not found in GroupHandle");
-    return SubGroupId(std::distance(objectIds_.begin(), iter) / 2);
-  }
+              DataManager &dataManagerHandle,
+              LayerType layerType = LayerType::Enhancement);
+
+  // subgroups take the layer of the group unless specified
+  SubgroupHandle add_subgroup(std::uint64_t numElements,
+                              std::optional<LayerType> layerType = {});
+  SubgroupHandle
+  add_open_ended_subgroup(std::optional<LayerType> layerType = {});
+
+  SubGroupId get_subgroup_id(ObjectId objectId) const;
+
+  /*
+      Subgroup of an object along with its exclusive end, looked up once for
+      a run of consecutive objects. Subgroups are contiguous, so the end is
+      the begin of the next subgroup. The last subgroup of the group has no
+      end while it is open ended, it ends once another subgroup is added
+  */
+  struct SubgroupRange {
+    SubGroupId subgroupId_;
+    std::optional<ObjectId> end_;
+    std::size_t numSubgroups_;
+  };
+  SubgroupRange get_subgroup_range(ObjectId objectId) const;
+
+  // does not take objectIdsMtx_, objectId must not precede the object the
+  // range was looked up for
+  bool in_subgroup_range(const SubgroupRange &range,
+                         ObjectId objectId) const noexcept;
 
   bool has_object_id(ObjectId objectId);
 
+  // layer of the subgroup the object belongs to
+  LayerType get_layer_type(ObjectId objectId);
+
   std::uint64_t num_objects_in_range(
       ObjectId left = ObjectId(0),
       ObjectId right = ObjectId(std::numeric_limits<std::uint64_t>::max()));
@@ -298,19 +354,28 @@ public:
 
   std::map<GroupId, std::shared_ptr<GroupHandle>> groupHandles_;
 
+  const GroupSequenceCounter groupSequence_;
+
   // should be private because but want to use std::make_shared
   TrackHandle(DataManager &dataManagerHandle, TrackIdentifier trackIdentifier);
 
   std::weak_ptr<GroupHandle>
   add_group(GroupId groupId, PublisherPriority publisherPriority,
-            std::optional<std::chrono::milliseconds> deliveryTimeout) {
+            std::optional<std::chrono::milliseconds> deliveryTimeout,
+            LayerType layerType = LayerType::Enhancement) {
     // writer lock
     std::unique_lock<std::shared_mutex> l(groupHandlesMtx_);
 
     auto [iter, success] = groupHandles_.try_emplace(
-        groupId, std::make_shared<GroupHandle>(
-                     GroupIdentifier(trackIdentifier_, groupId),
-                     publisherPriority, deliveryTimeout, dataManager_));
+        groupId,
+        std::make_shared<GroupHandle>(
+            GroupIdentifier(trackIdentifier_, groupId), publisherPriority,
+            deliveryTimeout, dataManager_, layerType));
+
+    if (success) {
+      iter->second->trackGroupSequence_ = groupSequence_;
+      groupSequence_->fetch_add(1, std::memory_order_release);
+    }
 
     return iter->second->weak_from_this();
   }
@@ -341,6 +406,19 @@ class DataManager {
   bool store_object(std::shared_ptr<GroupHandle> groupHandleWeakPtr,
                     ObjectId objectId, std::string &&object);
 
+  // registered object and its group cache entry, the entry is nullopt if the
+  // object has not been stored yet (see GroupHandle::groupCache_)
+  struct CacheLookup {
+    std::shared_ptr<GroupHandle> groupHandle_;
+    std::optional<QUIC_BUFFER *> cacheEntry_;
+  };
+  std::variant<CacheLookup, DoesNotExist>
+  lookup_cached_object(const ObjectIdentifier &objectIdentifier);
+
+  // object has not been stored yet, registers a wait signal for it and
+  // returns it, or the object if it was stored in the meantime
+  ObjectOrStatus wait_for_object(GroupHandle &groupHandle, ObjectId objectId);
+
 public:
   std::weak_ptr<TrackHandle>
   add_track_identifier(std::vector<std::string> tracknamespace,
@@ -355,12 +433,23 @@ public:
   }
 
   ObjectOrStatus get_object(const ObjectIdentifier &objectIdentifier);
+  /*
+      Same as get_object but never touches the disk, objects which are
+      registered but not stored yet get their wait signal registered on the
+      calling thread
+      Returns nullopt for objects which are stored but whose buffer is not
+      cached, get_object reads those from disk
+  */
+  std::optional<ObjectOrStatus>
+  get_cached_object(const ObjectIdentifier &objectIdentifier);
   std::weak_ptr<TrackHandle>
   get_track_handle(const TrackIdentifier &trackIdentifier);
   std::weak_ptr<GroupHandle>
   get_group_handle(const GroupIdentifier &groupIdentifier);
 
   std::optional<GroupId> get_first_group(const TrackIdentifier &);
+  // group after the given one (which need not exist) in the track
+  std::optional<GroupId> get_next_group(const GroupIdentifier &);
   std::optional<ObjectId> get_first_object(const GroupIdentifier &);
 
   // last object might be concrete (stored) or just registered (expected to be
@@ -370,6 +459,8 @@ public:
 
   std::optional<PublisherPriority>
   get_publisher_priority(const GroupIdentifier &groupIdentifier);
+  std::optional<LayerType>
+  get_layer_type(const ObjectIdentifier &objectIdentifier);
 
   // returns true if it could succesfully advance
   bool next(ObjectIdentifier &objectIdentifier, std::uint64_t advanceBy = 1);
@@ -0,0 +1,110 @@
+#pragma once
+/////////////////////////////////////////////
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+/////////////////////////////////////////////
+#include <definitions.hpp>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+/*
+    Intrusive min heap of deadlines
+    T should have members
+        TimePoint deadline_;
+        std::size_t deadlineHeapIndex_ = DeadlineHeap<T>::npos;
+    The heap position is stored in the element, so an element can be removed
+    (its deadline cancelled) in O(log n) without searching for it
+    The heap does not own the elements
+*/
+template <typename T> class DeadlineHeap {
+  std::vector<T *> heap_;
+
+  bool earlier(std::size_t l, std::size_t r) const noexcept {
+    return heap_[l]->deadline_ < heap_[r]->deadline_;
+  }
+
+  void swap_nodes(std::size_t l, std::size_t r) noexcept {
+    std::swap(heap_[l], heap_[r]);
+    heap_[l]->deadlineHeapIndex_ = l;
+    heap_[r]->deadlineHeapIndex_ = r;
+  }
+
+  void sift_up(std::size_t idx) noexcept {
+    while (idx > 0) {
+      std::size_t parent = (idx - 1) / 2;
+      if (!earlier(idx, parent))
+        break;
+      swap_nodes(idx, parent);
+      idx = parent;
+    }
+  }
+
+  void sift_down(std::size_t idx) noexcept {
+    while (true) {
+      std::size_t smallest = idx;
+      std::size_t left = 2 * idx + 1;
+      std::size_t right = left + 1;
+
+      if (left < heap_.size() && earlier(left, smallest))
+        smallest = left;
+      if (right < heap_.size() && earlier(right, smallest))
+        smallest = right;
+      if (smallest == idx)
+        break;
+
+      swap_nodes(idx, smallest);
+      idx = smallest;
+    }
+  }
+
+public:
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  static bool contains(const T &t) noexcept {
+    return t.deadlineHeapIndex_ != npos;
+  }
+
+  // inserts t, or moves it if it already has a deadline
+  void set(T &t, TimePoint deadline) {
+    t.deadline_ = deadline;
+    if (!contains(t)) {
+      t.deadlineHeapIndex_ = heap_.size();
+      heap_.push_back(&t);
+    }
+
+    sift_up(t.deadlineHeapIndex_);
+    sift_down(t.deadlineHeapIndex_);
+  }
+
+  void erase(T &t) noexcept {
+    if (!contains(t))
+      return;
+
+    std::size_t idx = t.deadlineHeapIndex_;
+    swap_nodes(idx, heap_.size() - 1);
+    heap_.pop_back();
+    t.deadlineHeapIndex_ = npos;
+
+    if (idx < heap_.size()) {
+      sift_up(idx);
+      sift_down(idx);
+    }
+  }
+
+  bool empty() const noexcept { return heap_.empty(); }
+  std::size_t size() const noexcept { return heap_.size(); }
+
+  // element with the earliest deadline, heap should not be empty
+  T &top() const noexcept { return *heap_.front(); }
+
+  T &pop() noexcept {
+    T &t = top();
+    erase(t);
+    return t;
+  }
+};
+
+} // namespace rvn
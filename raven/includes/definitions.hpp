@@ -21,6 +21,12 @@ public:
     return mpmcQueue.enqueue(std::move(t));
   }
 
+  template <typename It>
+  __attribute__((no_sanitize("thread"))) bool enqueue_bulk(It first,
+                                                           size_t count) {
+    return mpmcQueue.enqueue_bulk(first, count);
+  }
+
   template <typename U>
   __attribute__((no_sanitize("thread"))) void wait_dequeue(U &u) {
     return mpmcQueue.wait_dequeue(u);
@@ -1,14 +1,22 @@
 #pragma once
 ///////////////////////////////////////////////////////////////////////////////
 #include "strong_types.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <limits>
 #include <optional>
+#include <span>
 #include <utility>
 ///////////////////////////////////////////////////////////////////////////////
 #include <non_contiguous_span.hpp>
+#include <payload_view.hpp>
+#include <quic_buffer_queue.hpp>
 #include <serialization/deserialization_impl.hpp>
 #include <serialization/messages.hpp>
 #include <serialization/quic_var_int.hpp>
+#include <serialization/quic_var_int_batch.hpp>
 #include <serialization/serialization_impl.hpp>
 #include <utilities.hpp>
 #include <wrappers.hpp>
@@ -17,15 +25,50 @@
 
 namespace rvn::serialization {
 
+// handlers which take received objects in batches instead of one at a time
+template <typename Handler, typename Object>
+concept ObjectBatchHandler =
+    requires(Handler handler, std::span<Object> batch) {
+      handler.handle_object_batch(batch);
+    };
+
 /*
     As we get buffers from the network, we append them to the
     deserializer queue. The deserializer reads bytes from the buffers
     and construccts the appropriate message and pushes it into the
     message queue
+    Every append drains all complete messages in a loop (the read_* functions
+    return whether they made progress)
+    Single producer: append_buffer, limit_borrowed_bytes and detach_stream
+    must not be called concurrently, which holds for the receive callbacks of
+    a stream since MsQuic delivers the events of a stream one at a time (or
+    for the one thread processing the receive handoff, see
+    ConnectionState::receivedBuffers_), so there is no lock
 */
 template <typename DeserializedMessageHandler> class Deserializer {
-  std::vector<UniqueQuicBuffer> quicBuffers_;
-  std::mutex quicBuffersMutex_;
+  QuicBufferQueue quicBuffers_;
+
+#ifdef RAVEN_ENABLE_ASSERTIONS
+  // catches a broken single producer contract
+  std::atomic<bool> inProducerCall_{};
+#endif
+  struct ProducerCall {
+#ifdef RAVEN_ENABLE_ASSERTIONS
+    std::atomic<bool> &inProducerCall_;
+
+    explicit ProducerCall(Deserializer &deserializer)
+        : inProducerCall_(deserializer.inProducerCall_) {
+      utils::ASSERT_LOG_THROW(
+          !inProducerCall_.exchange(true, std::memory_order_acquire),
+          "Deserializer called from two threads at once");
+    }
+    ~ProducerCall() {
+      inProducerCall_.store(false, std::memory_order_release);
+    }
+#else
+    explicit ProducerCall(Deserializer &) {}
+#endif
+  };
 
   // begin index in first buffer
   std::uint64_t beginIndex_ = 0;
@@ -44,6 +87,7 @@ template <typename DeserializedMessageHandler> class Deserializer {
                            // (based on header)
     READING_OBJECT_DATAGRAM,
     READING_SUBGROUP_OBJECT,
+    READING_TRACK_OBJECT,
     READING_FETCH_OBJECT
   };
 
@@ -58,13 +102,14 @@ template <typename DeserializedMessageHandler> class Deserializer {
                             ">", size());
     // advance begin index
     beginIndex_ += numBytes;
-    auto iter = quicBuffers_.begin();
-    while (iter != quicBuffers_.end() && beginIndex_ >= (*iter)->Length) {
+    std::size_t numReadBuffers = 0;
+    for (auto iter = quicBuffers_.begin();
+         iter != quicBuffers_.end() && beginIndex_ >= (*iter)->Length;
+         ++iter, ++numReadBuffers)
       beginIndex_ -= (*iter)->Length;
-      ++iter;
-    }
-    quicBuffers_.erase(quicBuffers_.begin(), iter);
-    cachedSize_ = std::numeric_limits<std::uint64_t>::max();
+    quicBuffers_.pop_front(numReadBuffers);
+    // size() above has made the cached size valid
+    cachedSize_ -= numBytes;
   }
 
   // returns optinal value, std::numeric_limits<std::uint64_t>::max() is the
@@ -90,40 +135,54 @@ template <typename DeserializedMessageHandler> class Deserializer {
     return quicVarInt;
   }
 
+  // fast path for consecutive varints, decodes as many of them as are
+  // complete in the first buffer with the batch codec
+  // returns number of varints read, the rest are read with read_quic_var_int
+  std::size_t read_contiguous_quic_var_ints(std::span<std::uint64_t> values) {
+    if (quicBuffers_.empty())
+      return 0;
+
+    std::span<const std::uint8_t> bytes(quicBuffers_[0]->Buffer + beginIndex_,
+                                        quicBuffers_[0]->Length - beginIndex_);
+    auto [numValues, numBytes] = detail::decode_quic_var_ints(bytes, values);
+    if (numBytes != 0)
+      bytes_deserialized_hook(numBytes);
+
+    return numValues;
+  }
+
   ////////////////////////////////////////////////////////////////////////////
   // control message related
   // set after reading control message type
   MoQtMessageType messageType_;
   // set after reading control message length
   std::uint64_t messageLength_ = 0;
-  void read_message_type() {
+  bool read_message_type() {
     std::uint64_t messageTypeInt;
     std::uint64_t messageTypeOpt = read_quic_var_int();
     // if we don't have enough bytes to read the message type
     if (messageTypeOpt == std::numeric_limits<std::uint64_t>::max())
-      return;
+      return false;
     messageTypeInt = messageTypeOpt;
 
     messageType_ = static_cast<MoQtMessageType>(messageTypeInt);
     state_ = DeserializerState::READING_MESSAGE_LENGTH;
-
-    read_message_length();
+    return true;
   }
 
-  void read_message_length() {
+  bool read_message_length() {
     std::uint64_t messageLengthOpt = read_quic_var_int();
     // if we don't have enough bytes to read the message length
     if (messageLengthOpt == std::numeric_limits<std::uint64_t>::max())
-      return;
+      return false;
     messageLength_ = messageLengthOpt;
     state_ = DeserializerState::READING_MESSAGE;
-
-    read_message();
+    return true;
   }
 
-  void read_message() {
+  bool read_message() {
     if (size() < messageLength_)
-      return;
+      return false;
 
     // get the span
     NonContiguousSpan span(quicBuffers_, beginIndex_);
@@ -146,6 +205,14 @@ template <typename DeserializedMessageHandler> class Deserializer {
       BatchSubscribeMessage msg;
       numBytesDeserialized = detail::deserialize(msg, span);
       messageHandler_(std::move(msg));
+    } else if (messageType_ == MoQtMessageType::FETCH) {
+      FetchMessage msg;
+      numBytesDeserialized = detail::deserialize(msg, span);
+      messageHandler_(std::move(msg));
+    } else if (messageType_ == MoQtMessageType::GOAWAY) {
+      GoAwayMessage msg;
+      numBytesDeserialized = detail::deserialize(msg, span);
+      messageHandler_(std::move(msg));
     } else {
       utils::ASSERT_LOG_THROW(false, "Unsuppored message type",
                               utils::to_underlying(messageType_));
@@ -153,26 +220,26 @@ template <typename DeserializedMessageHandler> class Deserializer {
 
     bytes_deserialized_hook(numBytesDeserialized);
     state_ = DeserializerState::READING_MESSAGE_TYPE;
-
-    // proceed to next state in cycle
-    read_message_type();
-    return;
+    return true;
   }
   ////////////////////////////////////////////////////////////////////////////
 
   ////////////////////////////////////////////////////////////////////////////
   // Data stream related
   // TODO: does deserializer need to know this?
-  std::variant<std::nullopt_t, StreamHeaderSubgroupMessage> dataStreamHeader_;
+  std::variant<std::nullopt_t, StreamHeaderSubgroupMessage,
+               StreamHeaderTrackMessage, FetchHeaderMessage>
+      dataStreamHeader_;
   enum class ObjectStreamHeaderType {
     OBJECT_DATAGRAM = 0x1,
     STREAM_HEADER_SUBGROUP = 0x4,
-    FETCH_HEADER = 0x5
+    FETCH_HEADER = 0x5,
+    STREAM_HEADER_TRACK = 0x50
   };
   // clang-format off
     /*
         Object Header:
-        Header Id: 0x1 = OBJECT_DATAGRAM, 0x4 = STREAM_HEADER_SUBGROUP, 0x5 =FETCH_HEADER Header Content
+        Header Id: 0x1 = OBJECT_DATAGRAM, 0x4 = STREAM_HEADER_SUBGROUP, 0x5 = FETCH_HEADER, 0x50 = STREAM_HEADER_TRACK
         followed by the object header content
         STREAM_HEADER_SUBGROUP Message {
           Track Alias (i),
@@ -186,31 +253,42 @@ template <typename DeserializedMessageHandler> class Deserializer {
   std::optional<TrackAlias> trackAlias_;
   std::optional<GroupId> groupId_;
   std::optional<SubGroupId> subgroupId_;
-  void read_subgroup_header() {
+  bool read_subgroup_header() {
+    if (!trackAlias_.has_value()) {
+      std::array<std::uint64_t, 3> header;
+      std::size_t numRead = read_contiguous_quic_var_ints(header);
+      if (numRead > 0)
+        trackAlias_ = TrackAlias(header[0]);
+      if (numRead > 1)
+        groupId_ = GroupId(header[1]);
+      if (numRead > 2)
+        subgroupId_ = SubGroupId(header[2]);
+    }
+
     if (!trackAlias_.has_value()) {
       std::uint64_t trackAliasInt = read_quic_var_int();
       if (trackAliasInt == std::numeric_limits<std::uint64_t>::max())
-        return;
+        return false;
       trackAlias_ = TrackAlias(trackAliasInt);
     }
 
     if (!groupId_.has_value()) {
       std::uint64_t groupIdInt = read_quic_var_int();
       if (groupIdInt == std::numeric_limits<std::uint64_t>::max())
-        return;
+        return false;
       groupId_ = GroupId(groupIdInt);
     }
 
     if (!subgroupId_.has_value()) {
       std::uint64_t subgroupIdInt = read_quic_var_int();
       if (subgroupIdInt == std::numeric_limits<std::uint64_t>::max())
-        return;
+        return false;
       subgroupId_ = SubGroupId(subgroupIdInt);
     }
 
     // to read publisher priority
     if (size() < sizeof(std::uint8_t))
-      return;
+      return false;
 
     std::uint8_t publisherPriority = at(0);
     bytes_deserialized_hook(1);
@@ -222,7 +300,7 @@ template <typename DeserializedMessageHandler> class Deserializer {
     dataStreamHeader_ = msg;
 
     state_ = DeserializerState::READING_SUBGROUP_OBJECT;
-    read_subgroup_object();
+    return true;
   }
 
   /*
@@ -234,126 +312,388 @@ template <typename DeserializedMessageHandler> class Deserializer {
   */
   std::optional<ObjectId> subGroupObjectId_;
   std::optional<std::uint64_t> subGroupObjectPayloadLength_;
-  void read_subgroup_object() {
+
+  // caller should make sure that payloadLength bytes are available
+  std::string read_payload(std::uint64_t payloadLength) {
+    std::string payload;
+    payload.reserve(payloadLength);
+    std::uint64_t offset = beginIndex_;
+    for (auto iter = quicBuffers_.begin(); payload.size() < payloadLength;
+         ++iter, offset = 0) {
+      // the last buffer might have bytes of the next message
+      std::uint64_t numBytes = std::min<std::uint64_t>(
+          (*iter)->Length - offset, payloadLength - payload.size());
+      payload.append(reinterpret_cast<const char *>((*iter)->Buffer + offset),
+                     numBytes);
+    }
+    bytes_deserialized_hook(payloadLength);
+    return payload;
+  }
+
+  // payload references the buffers instead of copying them, except for
+  // borrowed buffers (zero copy receive) which have to go back to MsQuic
+  bool payloadViews_ = false;
+  PayloadView read_payload_view(std::uint64_t payloadLength) {
+    PayloadView payloadView;
+    std::uint64_t offset = beginIndex_;
+    for (auto iter = quicBuffers_.begin(); payloadView.size() < payloadLength;
+         ++iter, offset = 0) {
+      std::uint64_t numBytes = std::min<std::uint64_t>(
+          (*iter)->Length - offset, payloadLength - payloadView.size());
+      std::span<const std::uint8_t> bytes((*iter)->Buffer + offset, numBytes);
+
+      if (!iter->get_deleter().borrowed()) {
+        payloadView.append(share_quic_buffer(*iter), bytes);
+        continue;
+      }
+
+      UniqueQuicBuffer copy = make_owned_quic_buffer(numBytes);
+      std::memcpy(copy->Buffer, bytes.data(), numBytes);
+      bytes = {copy->Buffer, numBytes};
+      payloadView.append(std::shared_ptr<const QUIC_BUFFER>(std::move(copy)),
+                         bytes);
+    }
+    bytes_deserialized_hook(payloadLength);
+    return payloadView;
+  }
+
+  bool read_subgroup_object() {
+    if (!subGroupObjectId_.has_value()) {
+      std::array<std::uint64_t, 2> objectHeader;
+      std::size_t numRead = read_contiguous_quic_var_ints(objectHeader);
+      if (numRead > 0)
+        subGroupObjectId_ = ObjectId(objectHeader[0]);
+      if (numRead > 1)
+        subGroupObjectPayloadLength_ = objectHeader[1];
+    }
+
     if (!subGroupObjectId_.has_value()) {
       std::uint64_t objectId = read_quic_var_int();
       if (objectId == std::numeric_limits<std::uint64_t>::max())
-        return;
+        return false;
       subGroupObjectId_ = ObjectId(objectId);
     }
 
     if (!subGroupObjectPayloadLength_.has_value()) {
       std::uint64_t objectPayloadLength = read_quic_var_int();
       if (objectPayloadLength == std::numeric_limits<std::uint64_t>::max())
-        return;
+        return false;
       subGroupObjectPayloadLength_ = objectPayloadLength;
     }
 
     if (size() < subGroupObjectPayloadLength_)
-      return;
+      return false;
 
-    std::string payload;
-    payload.reserve(subGroupObjectPayloadLength_.value());
-    for (std::uint64_t i = 0; i < subGroupObjectPayloadLength_;) {
-      auto bytes = chunked_at(i);
-      i += bytes.size();
-      for (const auto &byte : bytes)
-        payload.push_back(byte);
+    StreamHeaderSubgroupObject msg{subGroupObjectId_.value(), {}};
+    if (payloadViews_)
+      msg.payloadView_ =
+          read_payload_view(subGroupObjectPayloadLength_.value());
+    else
+      msg.payload_ = read_payload(subGroupObjectPayloadLength_.value());
+    deliver_object(std::move(msg), subgroupObjectBatch_);
+
+    subGroupObjectId_ = std::nullopt;
+    subGroupObjectPayloadLength_ = std::nullopt;
+    return true;
+  }
+
+  /*
+      STREAM_HEADER_TRACK Message {
+        Track Alias (i),
+        Publisher Priority (8),
+      }
+  */
+  bool read_track_header() {
+    if (!trackAlias_.has_value()) {
+      std::uint64_t trackAliasInt = read_quic_var_int();
+      if (trackAliasInt == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      trackAlias_ = TrackAlias(trackAliasInt);
+    }
+
+    // to read publisher priority
+    if (size() < sizeof(std::uint8_t))
+      return false;
+
+    std::uint8_t publisherPriority = at(0);
+    bytes_deserialized_hook(1);
+
+    auto msg = StreamHeaderTrackMessage{trackAlias_.value(),
+                                        PublisherPriority(publisherPriority)};
+    messageHandler_(msg);
+    dataStreamHeader_ = msg;
+
+    state_ = DeserializerState::READING_TRACK_OBJECT;
+    return true;
+  }
+
+  /*
+      {
+        Group ID = 0
+        Object ID = 0
+        Object Payload Length = 4
+        Payload = "abcd"
+      }
+  */
+  std::optional<GroupId> trackObjectGroupId_;
+  bool read_track_object() {
+    if (!trackObjectGroupId_.has_value()) {
+      std::array<std::uint64_t, 3> objectHeader;
+      std::size_t numRead = read_contiguous_quic_var_ints(objectHeader);
+      if (numRead > 0)
+        trackObjectGroupId_ = GroupId(objectHeader[0]);
+      if (numRead > 1)
+        subGroupObjectId_ = ObjectId(objectHeader[1]);
+      if (numRead > 2)
+        subGroupObjectPayloadLength_ = objectHeader[2];
+    }
+
+    if (!trackObjectGroupId_.has_value()) {
+      std::uint64_t groupId = read_quic_var_int();
+      if (groupId == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      trackObjectGroupId_ = GroupId(groupId);
     }
-    bytes_deserialized_hook(subGroupObjectPayloadLength_.value());
 
-    auto msg = StreamHeaderSubgroupObject{subGroupObjectId_.value(),
-                                          std::move(payload)};
-    messageHandler_(std::move(msg));
+    // rest of the object is the same as a subgroup object
+    if (!subGroupObjectId_.has_value()) {
+      std::uint64_t objectId = read_quic_var_int();
+      if (objectId == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      subGroupObjectId_ = ObjectId(objectId);
+    }
+
+    if (!subGroupObjectPayloadLength_.has_value()) {
+      std::uint64_t objectPayloadLength = read_quic_var_int();
+      if (objectPayloadLength == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      subGroupObjectPayloadLength_ = objectPayloadLength;
+    }
+
+    if (size() < subGroupObjectPayloadLength_)
+      return false;
+
+    TrackStreamObjectMessage msg{trackObjectGroupId_.value(),
+                                 subGroupObjectId_.value(), {}};
+    if (payloadViews_)
+      msg.payloadView_ =
+          read_payload_view(subGroupObjectPayloadLength_.value());
+    else
+      msg.payload_ = read_payload(subGroupObjectPayloadLength_.value());
+    deliver_object(std::move(msg), trackObjectBatch_);
 
+    trackObjectGroupId_ = std::nullopt;
     subGroupObjectId_ = std::nullopt;
     subGroupObjectPayloadLength_ = std::nullopt;
+    return true;
+  }
+
+  /*
+      FETCH_HEADER Message {
+        Subscribe ID (i),
+      }
+  */
+  bool read_fetch_header() {
+    std::uint64_t subscribeId = read_quic_var_int();
+    if (subscribeId == std::numeric_limits<std::uint64_t>::max())
+      return false;
+
+    auto msg = FetchHeaderMessage{subscribeId};
+    messageHandler_(msg);
+    dataStreamHeader_ = msg;
+
+    state_ = DeserializerState::READING_FETCH_OBJECT;
+    return true;
+  }
 
-    read_subgroup_object();
+  /*
+      {
+        Group ID = 0
+        Subgroup ID = 0
+        Publisher Priority = 0
+        Object ID = 0
+        Object Payload Length = 4
+        Payload = "abcd"
+      }
+  */
+  std::optional<SubGroupId> fetchObjectSubgroupId_;
+  std::optional<PublisherPriority> fetchObjectPublisherPriority_;
+  bool read_fetch_object() {
+    // group id is kept in trackObjectGroupId_
+    if (!trackObjectGroupId_.has_value()) {
+      std::array<std::uint64_t, 2> objectHeader;
+      std::size_t numRead = read_contiguous_quic_var_ints(objectHeader);
+      if (numRead > 0)
+        trackObjectGroupId_ = GroupId(objectHeader[0]);
+      if (numRead > 1)
+        fetchObjectSubgroupId_ = SubGroupId(objectHeader[1]);
+    }
+
+    if (!trackObjectGroupId_.has_value()) {
+      std::uint64_t groupId = read_quic_var_int();
+      if (groupId == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      trackObjectGroupId_ = GroupId(groupId);
+    }
+
+    if (!fetchObjectSubgroupId_.has_value()) {
+      std::uint64_t subgroupId = read_quic_var_int();
+      if (subgroupId == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      fetchObjectSubgroupId_ = SubGroupId(subgroupId);
+    }
+
+    if (!fetchObjectPublisherPriority_.has_value()) {
+      if (size() < sizeof(std::uint8_t))
+        return false;
+      fetchObjectPublisherPriority_ = PublisherPriority(at(0));
+      bytes_deserialized_hook(1);
+    }
+
+    // rest of the object is the same as a subgroup object
+    if (!subGroupObjectId_.has_value()) {
+      std::array<std::uint64_t, 2> objectHeader;
+      std::size_t numRead = read_contiguous_quic_var_ints(objectHeader);
+      if (numRead > 0)
+        subGroupObjectId_ = ObjectId(objectHeader[0]);
+      if (numRead > 1)
+        subGroupObjectPayloadLength_ = objectHeader[1];
+    }
+
+    if (!subGroupObjectId_.has_value()) {
+      std::uint64_t objectId = read_quic_var_int();
+      if (objectId == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      subGroupObjectId_ = ObjectId(objectId);
+    }
+
+    if (!subGroupObjectPayloadLength_.has_value()) {
+      std::uint64_t objectPayloadLength = read_quic_var_int();
+      if (objectPayloadLength == std::numeric_limits<std::uint64_t>::max())
+        return false;
+      subGroupObjectPayloadLength_ = objectPayloadLength;
+    }
+
+    if (size() < subGroupObjectPayloadLength_)
+      return false;
+
+    FetchObjectMessage msg{trackObjectGroupId_.value(),
+                           fetchObjectSubgroupId_.value(),
+                           fetchObjectPublisherPriority_.value(),
+                           subGroupObjectId_.value(),
+                           {}};
+    if (payloadViews_)
+      msg.payloadView_ =
+          read_payload_view(subGroupObjectPayloadLength_.value());
+    else
+      msg.payload_ = read_payload(subGroupObjectPayloadLength_.value());
+    deliver_object(std::move(msg), fetchObjectBatch_);
+
+    trackObjectGroupId_ = std::nullopt;
+    fetchObjectSubgroupId_ = std::nullopt;
+    fetchObjectPublisherPriority_ = std::nullopt;
+    subGroupObjectId_ = std::nullopt;
+    subGroupObjectPayloadLength_ = std::nullopt;
+    return true;
   }
 
   std::optional<ObjectStreamHeaderType> dataStreamHeaderId_;
-  void read_object_header() {
+  // the header readers move to the object state of the header
+  bool read_object_header() {
     if (!dataStreamHeaderId_.has_value()) {
       std::uint64_t headerIdInt = read_quic_var_int();
       if (headerIdInt == std::numeric_limits<std::uint64_t>::max())
-        return;
+        return false;
 
       dataStreamHeaderId_ = static_cast<ObjectStreamHeaderType>(headerIdInt);
     }
 
     switch (dataStreamHeaderId_.value()) {
-    case ObjectStreamHeaderType::STREAM_HEADER_SUBGROUP: {
-      read_subgroup_header();
-      break;
-    }
+    case ObjectStreamHeaderType::STREAM_HEADER_SUBGROUP:
+      return read_subgroup_header();
+    case ObjectStreamHeaderType::STREAM_HEADER_TRACK:
+      return read_track_header();
+    case ObjectStreamHeaderType::FETCH_HEADER:
+      return read_fetch_header();
     default: {
-      // TODO handle OBJECT_DATAGRAM_HEADER and FETCH_HEADER
+      // OBJECT_DATAGRAM is only sent in QUIC datagrams (see
+      // MOQTClient::accept_datagram), never on a stream
       utils::ASSERT_LOG_THROW(
           false, "Invalid object header",
           utils::to_underlying(dataStreamHeaderId_.value()));
+      return false;
     }
     }
+  }
 
-    if (std::holds_alternative<std::nullopt_t>(dataStreamHeader_))
-      // haven't read the object header yet
-      return;
-    else if (std::holds_alternative<StreamHeaderSubgroupMessage>(
-                 dataStreamHeader_))
-      // read the object header
-      state_ = DeserializerState::READING_SUBGROUP_OBJECT;
-    else
-      // TODO handle OBJECT_DATAGRAM_HEADER and FETCH_HEADER
-      utils::ASSERT_LOG_THROW(
-          false, "Invalid object header",
-          utils::to_underlying(dataStreamHeaderId_.value()));
+  std::vector<StreamHeaderSubgroupObject> subgroupObjectBatch_;
+  std::vector<TrackStreamObjectMessage> trackObjectBatch_;
+  std::vector<FetchObjectMessage> fetchObjectBatch_;
+
+  template <typename Object>
+  void deliver_object(Object &&object, std::vector<Object> &batch) {
+    if constexpr (ObjectBatchHandler<DeserializedMessageHandler, Object>) {
+      batch.emplace_back(std::move(object));
+      if (batch.size() == maxObjectBatchSize)
+        flush_object_batch(batch);
+    } else
+      messageHandler_(std::move(object));
   }
-  ////////////////////////////////////////////////////////////////////////////
 
-  void process_state_machine_input() {
-    utils::ASSERT_LOG_THROW(quicBuffers_.size(),
-                            "Expected at least one buffer");
+  template <typename Object>
+  void flush_object_batch(std::vector<Object> &batch) {
+    if constexpr (ObjectBatchHandler<DeserializedMessageHandler, Object>) {
+      if (batch.empty())
+        return;
+      messageHandler_.handle_object_batch(std::span<Object>(batch));
+      batch.clear();
+    }
+  }
+  ////////////////////////////////////////////////////////////////////////////
 
+  // returns false when more bytes are needed to make progress
+  bool process_state() {
     switch (type_) {
     case DeserializerType::CONTROL_STREAM: {
       if (state_ == DeserializerState::READING_MESSAGE_TYPE)
-        read_message_type();
+        return read_message_type();
       else if (state_ == DeserializerState::READING_MESSAGE_LENGTH)
-        read_message_length();
+        return read_message_length();
       else if (state_ == DeserializerState::READING_MESSAGE)
-        read_message();
-      else
-        utils::ASSERT_LOG_THROW(false, "Invalid state",
-                                utils::to_underlying(state_));
+        return read_message();
       break;
     }
     case DeserializerType::DATA_STREAM: {
       if (state_ == DeserializerState::READING_OBJECT_HEADER)
-        read_object_header();
+        return read_object_header();
       else if (state_ == DeserializerState::READING_SUBGROUP_OBJECT)
-        read_subgroup_object();
-      else
-        // TOOD: implement reading OBJECT_DATAGRAM and and FETCH_HEADER
-        utils::ASSERT_LOG_THROW(false, "Invalid state",
-                                utils::to_underlying(state_));
+        return read_subgroup_object();
+      else if (state_ == DeserializerState::READING_TRACK_OBJECT)
+        return read_track_object();
+      else if (state_ == DeserializerState::READING_FETCH_OBJECT)
+        return read_fetch_object();
       break;
     }
     }
+
+    utils::ASSERT_LOG_THROW(false, "Invalid state",
+                            utils::to_underlying(state_));
+    return false;
   }
 
-  std::uint8_t &at(std::size_t index) const noexcept {
-    index += beginIndex_;
-    std::size_t bufferMaxIdx = quicBuffers_.front()->Length;
-    auto bufferIter = quicBuffers_.begin();
-    while (index >= bufferMaxIdx) {
-      ++bufferIter;
-      bufferMaxIdx += (*bufferIter)->Length;
-    }
+  void process_state_machine_input() {
+    utils::ASSERT_LOG_THROW(quicBuffers_.size(),
+                            "Expected at least one buffer");
 
-    return (*bufferIter)->Buffer[index - bufferMaxIdx + (*bufferIter)->Length];
+    while (!quicBuffers_.empty() && process_state())
+      ;
+
+    flush_object_batch(subgroupObjectBatch_);
+    flush_object_batch(trackObjectBatch_);
+    flush_object_batch(fetchObjectBatch_);
   }
 
-  std::span<const std::uint8_t> chunked_at(std::size_t index) const noexcept {
+  std::uint8_t &at(std::size_t index) const noexcept {
     index += beginIndex_;
     std::size_t bufferMaxIdx = quicBuffers_.front()->Length;
     auto bufferIter = quicBuffers_.begin();
@@ -362,10 +702,7 @@ template <typename DeserializedMessageHandler> class Deserializer {
       bufferMaxIdx += (*bufferIter)->Length;
     }
 
-    return {std::addressof(
-                (*bufferIter)
-                    ->Buffer[index - bufferMaxIdx + (*bufferIter)->Length]),
-            std::addressof((*bufferIter)->Buffer[(*bufferIter)->Length])};
+    return (*bufferIter)->Buffer[index - bufferMaxIdx + (*bufferIter)->Length];
   }
 
   // computing size is a relatively expensive operation, so we cache the size
@@ -401,13 +738,71 @@ public:
   }
 
   void append_buffer(UniqueQuicBuffer buffer) {
-    std::unique_lock<std::mutex> lock(quicBuffersMutex_);
+    ProducerCall producerCall(*this);
     if (cachedSize_ != std::numeric_limits<std::uint64_t>::max())
       cachedSize_ += buffer->Length;
     numBytesReceived += buffer->Length;
-    quicBuffers_.emplace_back(std::move(buffer));
+    quicBuffers_.push_back(std::move(buffer));
 
     process_state_machine_input();
   }
+
+  // objects parsed from one append are handed over together to handlers
+  // which take batches, large appends are split into batches of this size
+  static constexpr std::size_t maxObjectBatchSize = 64;
+
+  // zero copy receive, unread bytes in borrowed buffers beyond this are
+  // copied so that a large partially received message does not hold on to
+  // the stream receive window of MsQuic
+  static constexpr std::uint64_t maxBorrowedBytes = 64 * 1024;
+
+  // should be called after the buffers of a receive event have been appended
+  void limit_borrowed_bytes() {
+    ProducerCall producerCall(*this);
+
+    // borrowed buffers are always after the copied ones
+    auto firstBorrowed = std::find_if(
+        quicBuffers_.begin(), quicBuffers_.end(),
+        [](const UniqueQuicBuffer &buffer) {
+          return buffer.get_deleter().borrowed();
+        });
+    if (firstBorrowed == quicBuffers_.end())
+      return;
+
+    std::uint64_t offset =
+        firstBorrowed == quicBuffers_.begin() ? beginIndex_ : 0;
+    std::uint64_t numBorrowedBytes = 0;
+    for (auto iter = firstBorrowed; iter != quicBuffers_.end(); ++iter)
+      numBorrowedBytes += (*iter)->Length;
+    numBorrowedBytes -= offset;
+
+    if (numBorrowedBytes <= maxBorrowedBytes)
+      return;
+
+    UniqueQuicBuffer ownedBuffer = make_owned_quic_buffer(numBorrowedBytes);
+    std::uint8_t *dest = ownedBuffer->Buffer;
+    for (auto iter = firstBorrowed; iter != quicBuffers_.end(); ++iter) {
+      std::memcpy(dest, (*iter)->Buffer + offset, (*iter)->Length - offset);
+      dest += (*iter)->Length - offset;
+      offset = 0;
+    }
+
+    // borrowed bytes are handed back to MsQuic here
+    if (firstBorrowed == quicBuffers_.begin())
+      beginIndex_ = 0;
+    quicBuffers_.truncate(firstBorrowed);
+    quicBuffers_.push_back(std::move(ownedBuffer));
+    cachedSize_ = std::numeric_limits<std::uint64_t>::max();
+  }
+
+  // objects are delivered with payload views instead of payload strings
+  void set_payload_views(bool payloadViews) { payloadViews_ = payloadViews; }
+
+  // stream has been shut down, borrowed buffers are not completed anymore
+  void detach_stream() {
+    ProducerCall producerCall(*this);
+    for (auto &buffer : quicBuffers_)
+      buffer.get_deleter().detach_stream();
+  }
 };
 } // namespace rvn::serialization
@@ -0,0 +1,107 @@
+#pragma once
+/////////////////////////////////////////////
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+/////////////////////////////////////////////
+#include <serialization/messages.hpp>
+#include <spsc_queue.hpp>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+/*
+    Objects of a FETCH in (group, object) order, as they come off its stream
+    Filled by the thread receiving the objects (MsQuic worker, or the receive
+    handoff thread) and read by one application thread, either with try_next
+    or by iterating over the stream which waits for the objects
+    The queue is unbounded, the range is bounded and the server sends it as
+    fast as the connection takes it, a slow consumer only makes it buffer more
+    The range ends with the stream (FIN, or the stream being reset), or when
+    the connection shuts down before the stream arrives (see
+    MOQTClient::fetch), so next never waits on a stream which will not come
+*/
+class FetchStream {
+  SPSCQueue<FetchObjectMessage> objects_;
+  // number of objects pushed times 2, the low bit is set once the range has
+  // ended, the consumer waits on it
+  std::atomic<std::uint64_t> sequence_ = 0;
+
+public:
+  FetchStream() = default;
+  FetchStream(const FetchStream &) = delete;
+  FetchStream &operator=(const FetchStream &) = delete;
+
+  // receiving thread
+  void push(std::span<FetchObjectMessage> objects) {
+    for (auto &object : objects)
+      objects_.push(std::move(object));
+    sequence_.fetch_add(2 * objects.size(), std::memory_order_release);
+    sequence_.notify_one();
+  }
+
+  void finish() {
+    sequence_.fetch_or(1, std::memory_order_release);
+    sequence_.notify_one();
+  }
+
+  // the stream has ended, objects might still be queued
+  bool finished() const noexcept {
+    return sequence_.load(std::memory_order_acquire) & 1;
+  }
+
+  // consumer
+  std::optional<FetchObjectMessage> try_next() { return objects_.try_pop(); }
+
+  // next object of the range, waits for it, nullopt once the range has ended
+  std::optional<FetchObjectMessage> next() {
+    while (true) {
+      std::uint64_t sequence = sequence_.load(std::memory_order_acquire);
+      if (auto object = objects_.try_pop())
+        return object;
+      // objects are pushed before the end is, so all of them have been popped
+      if (sequence & 1)
+        return std::nullopt;
+      sequence_.wait(sequence, std::memory_order_acquire);
+    }
+  }
+
+  // for (FetchObjectMessage &object : *fetchStream)
+  class Iterator {
+    FetchStream *fetchStream_ = nullptr;
+    mutable std::optional<FetchObjectMessage> object_;
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = FetchObjectMessage;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+    explicit Iterator(FetchStream &fetchStream)
+        : fetchStream_(std::addressof(fetchStream)),
+          object_(fetchStream.next()) {}
+
+    FetchObjectMessage &operator*() const { return *object_; }
+    FetchObjectMessage *operator->() const { return std::addressof(*object_); }
+
+    Iterator &operator++() {
+      object_ = fetchStream_->next();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    bool operator==(std::default_sentinel_t) const noexcept {
+      return !object_.has_value();
+    }
+  };
+
+  Iterator begin() { return Iterator(*this); }
+  std::default_sentinel_t end() const noexcept { return {}; }
+};
+
+} // namespace rvn
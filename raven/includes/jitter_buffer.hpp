@@ -0,0 +1,168 @@
+#pragma once
+/////////////////////////////////////////////
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+/////////////////////////////////////////////
+#include <definitions.hpp>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+struct JitterBufferConfig {
+  // objects are held at least this long after they arrive, objects which
+  // come in out of order within the delay are put back in order for free
+  std::chrono::milliseconds playoutDelay_{0};
+  // how long an object after a gap waits (from its arrival) for the missing
+  // objects before the gap is skipped
+  std::chrono::milliseconds maxGapWait_{100};
+  // objects which can not be delivered within this time of their arrival are
+  // dropped instead of being handed to the application
+  std::optional<std::chrono::milliseconds> deliveryTimeout_{};
+};
+
+/*
+    Per track reorder (jitter) buffer
+    Objects of different groups come in on different streams, so they arrive
+    out of (group, object) order. The buffer hands them out in order:
+    - the object after the last one handed out (next object of the group, or
+      object 0 of a later group) is due once the playout delay has passed
+    - any other object is after a gap and is due once maxGapWait_ has passed,
+      the gap is skipped
+    - objects before the last one handed out arrive too late and are dropped
+    Filled by the thread receiving the objects and emptied by the application
+    with pop, which should be called again at next_due()
+    EnrichedObject is MOQTClient::EnrichedObjectMessage
+*/
+template <typename EnrichedObject> class JitterBuffer {
+  struct Entry {
+    EnrichedObject object_;
+    TimePoint arrival_;
+  };
+
+  using Key = std::pair<std::uint64_t, std::uint64_t>;
+
+  const JitterBufferConfig config_;
+
+  mutable std::mutex mutex_;
+  // (group, object) -> object
+  std::map<Key, Entry> objects_;
+  std::optional<Key> lastPopped_;
+
+  std::uint64_t numLate_ = 0;
+  std::uint64_t numExpired_ = 0;
+  std::uint64_t numGapsSkipped_ = 0;
+
+  static Key key(const EnrichedObject &object) {
+    return {object.header_->groupId_, object.object_.objectId_};
+  }
+
+  bool in_order(const Key &key) const noexcept {
+    if (!lastPopped_)
+      return true;
+    auto [group, object] = *lastPopped_;
+    return (key.first == group && key.second == object + 1) ||
+           (key.first > group && key.second == 0);
+  }
+
+  // when the object can be handed out
+  TimePoint due(const Key &key, const Entry &entry) const noexcept {
+    TimePoint due = entry.arrival_ + config_.playoutDelay_;
+    if (!in_order(key))
+      due = std::max(due, entry.arrival_ + config_.maxGapWait_);
+    return due;
+  }
+
+  bool expired(const Entry &entry, TimePoint now) const noexcept {
+    return config_.deliveryTimeout_ &&
+           now > entry.arrival_ + *config_.deliveryTimeout_;
+  }
+
+public:
+  explicit JitterBuffer(JitterBufferConfig config) : config_(config) {}
+
+  // receiving thread
+  void push(EnrichedObject object, TimePoint arrival = Clock::now()) {
+    Key objectKey = key(object);
+
+    std::lock_guard lock(mutex_);
+    if (lastPopped_ && objectKey <= *lastPopped_) {
+      ++numLate_;
+      return;
+    }
+    // duplicates (e.g. resubscribing from the last received object) are
+    // dropped as well
+    if (!objects_.try_emplace(objectKey, Entry{std::move(object), arrival})
+             .second)
+      ++numLate_;
+  }
+
+  // next object in order if it is due at now, expired objects are dropped
+  // on the way
+  std::optional<EnrichedObject> pop(TimePoint now = Clock::now()) {
+    std::lock_guard lock(mutex_);
+    while (!objects_.empty()) {
+      auto iter = objects_.begin();
+      auto &[objectKey, entry] = *iter;
+
+      if (expired(entry, now)) {
+        ++numExpired_;
+        lastPopped_ = objectKey;
+        objects_.erase(iter);
+        continue;
+      }
+
+      if (now < due(objectKey, entry))
+        return std::nullopt;
+
+      numGapsSkipped_ += !in_order(objectKey);
+      lastPopped_ = objectKey;
+      std::optional<EnrichedObject> object(std::move(entry.object_));
+      objects_.erase(iter);
+      return object;
+    }
+    return std::nullopt;
+  }
+
+  // when pop will have an object (or drop one), nothing if the buffer is
+  // empty
+  std::optional<TimePoint> next_due() const {
+    std::lock_guard lock(mutex_);
+    if (objects_.empty())
+      return std::nullopt;
+
+    const auto &[objectKey, entry] = *objects_.begin();
+    TimePoint nextDue = due(objectKey, entry);
+    if (config_.deliveryTimeout_)
+      nextDue = std::min(nextDue, entry.arrival_ + *config_.deliveryTimeout_);
+    return nextDue;
+  }
+
+  std::size_t size() const {
+    std::lock_guard lock(mutex_);
+    return objects_.size();
+  }
+
+  // objects which arrived after a later object had been handed out
+  std::uint64_t num_late() const {
+    std::lock_guard lock(mutex_);
+    return numLate_;
+  }
+
+  // objects dropped because of the delivery timeout
+  std::uint64_t num_expired() const {
+    std::lock_guard lock(mutex_);
+    return numExpired_;
+  }
+
+  std::uint64_t num_gaps_skipped() const {
+    std::lock_guard lock(mutex_);
+    return numGapsSkipped_;
+  }
+};
+
+} // namespace rvn
@@ -1,5 +1,6 @@
 #pragma once
 #include <serialization/messages.hpp>
+#include <span>
 #include <subscription_manager.hpp>
 
 namespace rvn {
@@ -17,6 +18,18 @@ public:
   void operator()(SubscribeMessage subscribeMessage);
   void operator()(StreamHeaderSubgroupObject streamHeaderSubgroupObject);
   void operator()(StreamHeaderSubgroupMessage streamHeaderSubgroupMessage);
+  void operator()(TrackStreamObjectMessage trackStreamObjectMessage);
+  void operator()(StreamHeaderTrackMessage streamHeaderTrackMessage);
   void operator()(BatchSubscribeMessage batchSubscribeMessage);
+  void operator()(GoAwayMessage goAwayMessage);
+  void operator()(FetchMessage fetchMessage);
+  void operator()(FetchHeaderMessage fetchHeaderMessage);
+  void operator()(FetchObjectMessage fetchObjectMessage);
+
+  // objects parsed from one receive are delivered together (see
+  // serialization::ObjectBatchHandler)
+  void handle_object_batch(std::span<StreamHeaderSubgroupObject> batch);
+  void handle_object_batch(std::span<TrackStreamObjectMessage> batch);
+  void handle_object_batch(std::span<FetchObjectMessage> batch);
 };
 } // namespace rvn
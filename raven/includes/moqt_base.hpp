@@ -73,6 +73,10 @@ public:
 
   std::uint64_t secondaryCounter;
 
+  bool zeroCopyReceive = false;
+  bool payloadViews = false;
+  bool receiveHandoff = false;
+
   void add_to_secondary_counter(SecondaryIndices idx) {
     secondaryCounter |= sec_index_to_val(idx);
   }
@@ -138,6 +142,20 @@ public:
 
   MOQT &set_controlStreamCb(stream_cb_lamda_t controlStreamCb_);
   MOQT &set_dataStreamCb(stream_cb_lamda_t dataStreamCb_);
+
+  // optional, received buffers are handed to the deserializer without a copy
+  // and returned to MsQuic once consumed, requires StreamMultiReceiveEnabled
+  // (should be called after set_Settings)
+  MOQT &set_zeroCopyReceive(bool zeroCopyReceive_);
+
+  // optional, received objects carry a PayloadView (payloadView_) which
+  // references the receive buffers instead of a payload_ copy
+  MOQT &set_payloadViews(bool payloadViews_);
+
+  // optional (client), buffers received on data streams are parsed by the
+  // application thread in MOQTClient::process_received_data instead of on the
+  // MsQuic worker, the buffers are always copied
+  MOQT &set_receiveHandoff(bool receiveHandoff_);
   //////////////////////////////////////////////////////////////////////////
 
   const QUIC_API_TABLE *get_tbl();
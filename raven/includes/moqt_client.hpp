@@ -7,8 +7,20 @@
 ////////////////////////////////////////////
 #include <atomic>
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 ////////////////////////////////////////////
 #include <contexts.hpp>
+#include <fetch_stream.hpp>
+#include <jitter_buffer.hpp>
+#include <object_ring.hpp>
 #include <serialization/serialization.hpp>
 #include <subscription_manager.hpp>
 #include <utilities.hpp>
@@ -38,16 +50,120 @@ public:
   };
   MPMCQueue<EnrichedObjectMessage> receivedObjects_;
 
+  /*
+      Alternatives to receivedObjects_
+      - the object callback is called inline on the thread which received the
+        objects (MsQuic worker, or the receive handoff thread), nothing is
+        queued and the header is not shared, so it should not block. It
+        should be set before subscribing
+      - subscriptions made with an ObjectRingConfig get a bounded ring of
+        their own (one producer, the connection, one consumer, the user)
+      - subscriptions made with a JitterBufferConfig get a JitterBuffer of
+        their own which hands the objects out in (group, object) order
+      Objects of a subscription with a ring or jitter buffer go there, the
+      rest to the callback if it is set and to receivedObjects_ otherwise
+  */
+  using ObjectCallback = std::function<void(const StreamHeaderSubgroupMessage &,
+                                            StreamHeaderSubgroupObject)>;
+  void set_object_callback(ObjectCallback objectCallback) {
+    objectCallback_ = std::move(objectCallback);
+  }
+
+  using TrackObjectRing = ObjectRing<EnrichedObjectMessage>;
+  struct ObjectRingConfig {
+    std::size_t capacity_ = 1024;
+    OverflowPolicy overflowPolicy_ = OverflowPolicy::DROP_OLDEST;
+  };
+
+  using TrackJitterBuffer = JitterBuffer<EnrichedObjectMessage>;
+
   void subscribe(SubscribeMessage &&subscribeMessage) {
+    add_subscription_progress(subscribeMessage);
+    QUIC_BUFFER *quicBuffer = serialization::serialize(subscribeMessage);
+    connectionState->send_control_buffer(quicBuffer);
+  }
+
+  // objects of the subscription are delivered through the returned ring
+  std::shared_ptr<TrackObjectRing>
+  subscribe(SubscribeMessage &&subscribeMessage,
+            ObjectRingConfig objectRingConfig) {
+    auto objectRing = std::make_shared<TrackObjectRing>(
+        objectRingConfig.capacity_, objectRingConfig.overflowPolicy_);
+    add_subscription_progress(subscribeMessage, objectRing);
     QUIC_BUFFER *quicBuffer = serialization::serialize(subscribeMessage);
     connectionState->send_control_buffer(quicBuffer);
+    return objectRing;
+  }
+
+  // objects of the subscription are delivered in order through the returned
+  // jitter buffer
+  std::shared_ptr<TrackJitterBuffer>
+  subscribe(SubscribeMessage &&subscribeMessage,
+            JitterBufferConfig jitterBufferConfig) {
+    auto jitterBuffer = std::make_shared<TrackJitterBuffer>(jitterBufferConfig);
+    add_subscription_progress(subscribeMessage, jitterBuffer);
+    QUIC_BUFFER *quicBuffer = serialization::serialize(subscribeMessage);
+    connectionState->send_control_buffer(quicBuffer);
+    return jitterBuffer;
   }
 
   void subscribe(BatchSubscribeMessage &&batchSubscribeMessage) {
+    for (SubscribeMessage subscribeMessage :
+         batchSubscribeMessage.subscriptions_) {
+      // progress is kept for the full namespace
+      subscribeMessage.trackNamespace_.insert(
+          subscribeMessage.trackNamespace_.begin(),
+          batchSubscribeMessage.trackNamespacePrefix_.begin(),
+          batchSubscribeMessage.trackNamespacePrefix_.end());
+      add_subscription_progress(subscribeMessage);
+    }
+
     QUIC_BUFFER *quicBuffer = serialization::serialize(batchSubscribeMessage);
     connectionState->send_control_buffer(quicBuffer);
   }
 
+  /*
+      Range of objects which have already been published, read in (group,
+      object) order from the returned stream which ends after the last object
+      of the range
+      subscribeId_ should not be shared with another fetch in flight on this
+      connection
+      The stream also ends (possibly without any objects) if the connection
+      shuts down before the server opens the fetch stream, or is already shut
+      down. If the FETCH can not be sent the stream is ended and the
+      exception is rethrown
+  */
+  std::shared_ptr<FetchStream> fetch(FetchMessage &&fetchMessage) {
+    auto fetchStream = std::make_shared<FetchStream>();
+    {
+      std::lock_guard lock(pendingFetchesMtx_);
+      if (pendingFetchesClosed_) {
+        fetchStream->finish();
+        return fetchStream;
+      }
+      pendingFetches_[fetchMessage.subscribeId_] = fetchStream;
+    }
+    QUIC_BUFFER *quicBuffer = serialization::serialize(fetchMessage);
+    try {
+      connectionState->send_control_buffer(quicBuffer);
+    } catch (...) {
+      // nobody would ever finish it
+      if (auto pendingFetchStream =
+              take_fetch_stream(fetchMessage.subscribeId_))
+        pendingFetchStream->finish();
+      throw;
+    }
+    return fetchStream;
+  }
+
+  // stream of the fetch whose FETCH_HEADER has been received, nullptr if the
+  // fetch is not known
+  std::shared_ptr<FetchStream> take_fetch_stream(std::uint64_t subscribeId);
+
+  // the connection has shut down, no fetch stream is going to arrive, ends
+  // the streams of the pending fetches and of the fetches made after this
+  void finish_pending_fetches();
+
   MOQTClient(
       std::tuple<QUIC_EXECUTION_CONFIG *, std::uint64_t> execConfigTuple = {
           nullptr, 0});
@@ -61,6 +177,17 @@ public:
     return connectionState->accept_data_stream(streamHandle);
   }
 
+  // OBJECT_DATAGRAM, objects are delivered through receivedObjects_
+  void accept_datagram(const QUIC_BUFFER &datagram);
+
+  // receive handoff (set_receiveHandoff), parses up to maxBuffers received
+  // buffers on the calling thread, there should be a single such thread
+  // returns the number of buffers processed, 0 when there was nothing queued
+  std::size_t process_received_data(
+      std::size_t maxBuffers = std::numeric_limits<std::size_t>::max()) {
+    return connectionState->process_received_buffers(maxBuffers);
+  }
+
   // atomic flags for multi thread synchronization
   // make sure no connections are accepted until whole setup required is
   // completed
@@ -68,5 +195,69 @@ public:
 
   // make sure no communication untill setup messages are exchanged
   std::atomic_bool ravenConnectionSetupFlag_{};
+
+  // GOAWAY ///////////////////////////////////////////////////////////////////
+  // set once the server asks us to move to a new session, goAwayMessage_ is
+  // written before the flag is set
+  // the new session is set up by the user: make a new client connected to
+  // goAwayMessage_.newSessionURI_ (same server if empty), subscribe with
+  // get_resume_subscriptions() and close_connection() this one
+  std::atomic_bool goAwayFlag_{};
+  GoAwayMessage goAwayMessage_;
+
+  // set on QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE
+  std::atomic_bool connectionShutdownFlag_{};
+
+  void on_go_away(GoAwayMessage goAwayMessage);
+
+  /*
+      Subscriptions sent on this session, starting at the last object received
+      on them (or unchanged if nothing was received)
+      The last received object is requested again because it is known to
+      exist, it will be received twice
+  */
+  std::vector<SubscribeMessage> get_resume_subscriptions();
+
+  // streams still being received are reset, when moving to a new session
+  // this should be called once the objects in flight have been received
+  void close_connection();
+
+  // called for all received objects (streams and datagrams), objects which
+  // share a header are handed over together
+  void
+  deliver_objects(const std::shared_ptr<StreamHeaderSubgroupMessage> &header,
+                  std::span<StreamHeaderSubgroupObject> objects);
+
+private:
+  ObjectCallback objectCallback_;
+
+  // where the objects of a subscription go, the callback or receivedObjects_
+  // if it is empty
+  using ObjectSink =
+      std::variant<std::monostate, std::shared_ptr<TrackObjectRing>,
+                   std::shared_ptr<TrackJitterBuffer>>;
+
+  struct SubscriptionProgress {
+    SubscribeMessage subscribeMessage_;
+    std::optional<GroupObjectPair> lastReceived_;
+    ObjectSink objectSink_;
+  };
+
+  std::mutex subscriptionProgressMtx_;
+  // track alias -> progress
+  std::unordered_map<std::uint64_t, SubscriptionProgress> subscriptionProgress_;
+
+  std::mutex pendingFetchesMtx_;
+  // subscribe id -> stream, till the fetch stream arrives
+  std::unordered_map<std::uint64_t, std::shared_ptr<FetchStream>>
+      pendingFetches_;
+  // set by finish_pending_fetches
+  bool pendingFetchesClosed_ = false;
+
+  void add_subscription_progress(const SubscribeMessage &subscribeMessage,
+                                 ObjectSink objectSink = {});
+  // updates the progress of the subscription, returns where its objects go
+  ObjectSink on_object_received(const StreamHeaderSubgroupMessage &header,
+                                ObjectId objectId);
 };
 } // namespace rvn
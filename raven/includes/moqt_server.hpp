@@ -1,5 +1,6 @@
 #pragma once
 ////////////////////////////////////////////
+#include <connection_registry.hpp>
 #include <contexts.hpp>
 #include <data_manager.hpp>
 #include <moqt_base.hpp>
@@ -9,6 +10,9 @@
 #include <utilities.hpp>
 #include <wrappers.hpp>
 ////////////////////////////////////////////
+#include <chrono>
+#include <string>
+////////////////////////////////////////////
 
 namespace rvn {
 class MOQTServer : public MOQT {
@@ -18,17 +22,50 @@ public:
   std::shared_ptr<DataManager> dataManager_;
   std::shared_ptr<SubscriptionManager> subscriptionManager_;
 
-  std::shared_mutex connectionStateMapMtx;
-  std::unordered_map<HQUIC, std::shared_ptr<ConnectionState>>
-      connectionStateMap;
+  ConnectionRegistry connections_;
+  // should be set before start_listener
+  ConnectionLifecycleHooks connectionLifecycleHooks_;
+
+  // applied to every accepted connection
+  const SendWatermarks sendWatermarks_;
 
   MOQTServer(
       std::shared_ptr<DataManager> dataManager,
       std::tuple<QUIC_EXECUTION_CONFIG *, std::uint64_t> execConfigTuple = {
-          nullptr, 0});
+          nullptr, 0},
+      SendBudget sendBudget = {}, SendWatermarks sendWatermarks = {});
+
+  // connections are closed here (AppCloseInProgress is set on their
+  // SHUTDOWN_COMPLETE), so no connection is cleaned up twice
+  ~MOQTServer();
 
   void start_listener(QUIC_ADDR *LocalAddress);
 
+  /*
+      Drains the server (e.g. before a restart)
+      Stops accepting connections and sends GOAWAY to every connection, the
+      clients are expected to move their subscriptions to newSessionURI (this
+      server if empty) and close their connection
+      Connections still open after gracePeriod are shut down
+      Blocks till then
+  */
+  void drain(std::string newSessionURI, std::chrono::milliseconds gracePeriod);
+
+  // the context of server connections is their connection state, it is
+  // forwarded to the connection callback as the MOQTServer
+  static QUIC_STATUS
+  server_connection_cb_wrapper(HQUIC connection, void *context,
+                               QUIC_CONNECTION_EVENT *event) {
+    MOQT &moqtObject = static_cast<ConnectionState *>(context)->moqtObject_;
+    return moqtObject.connection_cb_lamda(connection, &moqtObject, event);
+  }
+
+  // lock free, connection should be one accepted by this server which has
+  // not been cleaned up
+  ConnectionState &get_connection_state(HQUIC connection) {
+    return *static_cast<ConnectionState *>(get_tbl()->GetContext(connection));
+  }
+
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   // these functions will later be pushed into cgUtils
   // utils::MOQTComplexGetterUtils *cgUtils{this};
@@ -42,25 +79,28 @@ public:
   */
   QUIC_STATUS accept_new_connection(auto newConnectionInfo) {
     HQUIC connectionHandle = newConnectionInfo.Connection;
-    get_tbl()->ConnectionSetConfiguration(connectionHandle,
-                                          configuration.get());
-
-    get_tbl()->SetCallbackHandler(newConnectionInfo.Connection,
-                                  (void *)(this->connection_cb_wrapper),
-                                  (void *)(this));
-
-    utils::ASSERT_LOG_THROW(connectionStateMap.find(connectionHandle) ==
-                                connectionStateMap.end(),
-                            "Trying to accept connection which already "
-                            "exists");
 
     unique_connection connection =
         unique_connection(tbl.get(), connectionHandle);
 
-    std::unique_lock l(connectionStateMapMtx);
-    connectionStateMap.emplace(
-        connectionHandle,
-        std::make_shared<ConnectionState>(std::move(connection), *this));
+    auto connectionState =
+        std::make_shared<ConnectionState>(std::move(connection), *this);
+    connectionState->sendWatermarks_ = sendWatermarks_;
+    ConnectionState *connectionStatePtr = connectionState.get();
+
+    utils::ASSERT_LOG_THROW(
+        connections_.insert(connectionHandle, std::move(connectionState)),
+        "Trying to accept connection which already exists");
+
+    // no events are delivered for the connection till we return
+    get_tbl()->SetCallbackHandler(connectionHandle,
+                                  (void *)(server_connection_cb_wrapper),
+                                  (void *)(connectionStatePtr));
+    get_tbl()->ConnectionSetConfiguration(connectionHandle,
+                                          configuration.get());
+
+    if (connectionLifecycleHooks_.onConnectionAccepted_)
+      connectionLifecycleHooks_.onConnectionAccepted_(*connectionStatePtr);
 
     return QUIC_STATUS_SUCCESS;
   }
@@ -73,15 +113,25 @@ public:
       }
   */
   QUIC_STATUS accept_control_stream(HQUIC connection, auto newStreamInfo) {
-    // get connection state object
-    ConnectionState &connectionState = *connectionStateMap.at(connection);
-
-    return connectionState.accept_control_stream(newStreamInfo.Stream);
+    return get_connection_state(connection).accept_control_stream(
+        newStreamInfo.Stream);
   }
 
-  void cleanup_connection(HQUIC connection) {
-    std::unique_lock l(connectionStateMapMtx);
-    connectionStateMap.erase(connection);
+  /*
+      decltype(datagramStateChanged) is
+      struct {
+          BOOLEAN SendEnabled;
+          uint16_t MaxSendLength;
+      }
+  */
+  void datagram_state_changed(HQUIC connection, auto datagramStateChanged) {
+    get_connection_state(connection).on_datagram_state_changed(
+        datagramStateChanged.SendEnabled, datagramStateChanged.MaxSendLength);
   }
+
+  // called on QUIC_CONNECTION_EVENT_SHUTDOWN_COMPLETE (if we are not the ones
+  // closing the connection), the connection is closed once the last
+  // reference to its state is released
+  void cleanup_connection(HQUIC connection);
 };
 } // namespace rvn
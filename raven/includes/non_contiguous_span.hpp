@@ -1,15 +1,23 @@
 #pragma once
 
 #include <algorithm>
-#include <boost/container/small_vector.hpp>
+#include <cstring>
+#include <limits>
 #include <msquic.h>
 #include <span>
 #include <utilities.hpp>
-#include <vector>
 #include <wrappers.hpp>
 
 namespace rvn::serialization {
 
+/*
+    Span over bytes in a sequence of QUIC_BUFFERs
+    Construction does not allocate (or walk the buffers), the size is computed
+    on first use
+    Element access keeps a cursor (buffer index and the span index where that
+    buffer begins), so sequential access is O(1) and copies are done per
+    contiguous segment with memcpy
+*/
 class NonContiguousSpan {
   std::span<UniqueQuicBuffer> buffers_;
   // where is begins in the first QUIC_BUFFER
@@ -18,8 +26,68 @@ class NonContiguousSpan {
   // where it ends in the last QUIC_BUFFER
   std::uint64_t endIdx_;
 
-  // cumulativeSize_[i] = sum of sizes of first i + 1 buffers
-  std::vector<std::uint64_t> cumulativeSize_;
+  static constexpr std::uint64_t unknownSize =
+      std::numeric_limits<std::uint64_t>::max();
+  mutable std::uint64_t size_ = unknownSize;
+
+  // cursor, buffers_[cursorBufferIdx_] begins at index cursorBeginIdx_ of the
+  // span
+  mutable std::size_t cursorBufferIdx_ = 0;
+  mutable std::uint64_t cursorBeginIdx_ = 0;
+
+  // number of bytes of the buffer which are in the span
+  std::uint64_t buffer_size(std::size_t bufferIdx) const noexcept {
+    std::uint64_t end = bufferIdx + 1 == buffers_.size()
+                            ? endIdx_
+                            : buffers_[bufferIdx]->Length;
+    std::uint64_t begin = bufferIdx == 0 ? beginIdx_ : 0;
+    return end - begin;
+  }
+
+  std::uint8_t *buffer_begin(std::size_t bufferIdx) const noexcept {
+    return buffers_[bufferIdx]->Buffer + (bufferIdx == 0 ? beginIdx_ : 0);
+  }
+
+  // moves the cursor to the buffer which has index, returns offset of index
+  // in that buffer (from buffer_begin)
+  std::uint64_t seek(std::uint64_t index) const noexcept {
+    if (index < cursorBeginIdx_) {
+      cursorBufferIdx_ = 0;
+      cursorBeginIdx_ = 0;
+    }
+
+    std::uint64_t bufferSize;
+    while (index - cursorBeginIdx_ >=
+           (bufferSize = buffer_size(cursorBufferIdx_))) {
+      cursorBeginIdx_ += bufferSize;
+      ++cursorBufferIdx_;
+    }
+    return index - cursorBeginIdx_;
+  }
+
+  // calls f(segmentBegin, segmentSize) for every contiguous segment of
+  // [index, index + numBytes)
+  template <typename F>
+  void for_each_segment(std::uint64_t index, std::uint64_t numBytes,
+                        F &&f) const noexcept {
+    if (numBytes == 0)
+      return;
+
+    std::uint64_t offset = seek(index);
+    for (;;) {
+      std::uint64_t segmentSize =
+          std::min(buffer_size(cursorBufferIdx_) - offset, numBytes);
+      f(buffer_begin(cursorBufferIdx_) + offset, segmentSize);
+
+      numBytes -= segmentSize;
+      if (numBytes == 0)
+        return;
+
+      cursorBeginIdx_ += buffer_size(cursorBufferIdx_);
+      ++cursorBufferIdx_;
+      offset = 0;
+    }
+  }
 
 public:
   NonContiguousSpan(std::span<UniqueQuicBuffer> buffers, std::uint64_t beginIdx,
@@ -27,20 +95,8 @@ public:
       : buffers_(buffers), beginIdx_(beginIdx), endIdx_(endIdx) {
     utils::ASSERT_LOG_THROW(buffers_[0]->Length > beginIdx_,
                             "beginIdx out of bounds");
-
-    std::uint64_t cumulativeLen = buffers_[0]->Length - beginIdx_;
-    // pushes cumulativeSize_ of first buffers_.size() - 1 buffers
-    for (std::size_t i = 1; i < buffers_.size(); ++i) {
-      cumulativeSize_.push_back(cumulativeLen);
-      cumulativeLen += buffers_[i]->Length;
-    }
-
-    // we have added full Length of last buffer, which is not required
     utils::ASSERT_LOG_THROW(buffers_.back()->Length >= endIdx_,
                             "endIdx out of bounds");
-    cumulativeLen -= buffers_.back()->Length;
-    cumulativeLen += endIdx_;
-    cumulativeSize_.push_back(cumulativeLen);
   }
 
   NonContiguousSpan(std::span<UniqueQuicBuffer> buffers, std::uint64_t beginIdx)
@@ -50,9 +106,13 @@ public:
       : NonContiguousSpan(buffers, 0, buffers.back()->Length) {}
 
   std::uint64_t size() const noexcept {
-    if (cumulativeSize_.empty())
-      return 0;
-    return cumulativeSize_.back();
+    if (size_ != unknownSize)
+      return size_;
+
+    std::uint64_t totalSize = 0;
+    for (std::size_t i = 0; i < buffers_.size(); ++i)
+      totalSize += buffer_size(i);
+    return size_ = totalSize;
   }
 
   std::uint8_t &at(std::uint64_t index) {
@@ -75,51 +135,40 @@ public:
   }
 
   const std::uint8_t &operator[](std::uint64_t index) const noexcept {
-    std::size_t quicBufferIdx = std::upper_bound(cumulativeSize_.begin(),
-                                                 cumulativeSize_.end(), index) -
-                                cumulativeSize_.begin();
-
-    std::uint64_t idxInSpecificBuffer = index;
-    if (quicBufferIdx != 0)
-      idxInSpecificBuffer -= cumulativeSize_[quicBufferIdx - 1];
-    else
-      idxInSpecificBuffer += beginIdx_;
-
-    return buffers_[quicBufferIdx]->Buffer[idxInSpecificBuffer];
+    std::uint64_t offset = seek(index);
+    return buffer_begin(cursorBufferIdx_)[offset];
   }
 
-  // we are going for linear algorithm because we expect numBytes to be small
   void advance_begin(std::uint64_t numBytes) noexcept {
     utils::ASSERT_LOG_THROW(numBytes <= size(), "Advancing more than size",
                             "Advancing:", numBytes, "Size:", size());
-    if (numBytes == size()) {
-      beginIdx_ = 0;
-      endIdx_ = 0;
-      cumulativeSize_.clear();
+    size_ -= numBytes;
+    if (size_ == 0) {
+      // keep the last buffer so that buffers_ is never empty
+      buffers_ = buffers_.last(1);
+      beginIdx_ = endIdx_;
+      cursorBufferIdx_ = 0;
+      cursorBeginIdx_ = 0;
       return;
     }
 
-    std::uint64_t newBeginIdx = beginIdx_ + numBytes;
-    std::size_t quicBufferIdx = 0;
-    while (newBeginIdx >= buffers_[quicBufferIdx]->Length) {
-      newBeginIdx -= buffers_[quicBufferIdx]->Length;
-      ++quicBufferIdx;
-    }
-
-    beginIdx_ = newBeginIdx;
-    cumulativeSize_.erase(cumulativeSize_.begin(),
-                          cumulativeSize_.begin() + quicBufferIdx);
-    buffers_ = buffers_.subspan(quicBufferIdx);
-    // TODO: make sure simd execution
-    for (std::uint64_t &i : cumulativeSize_)
-      i -= numBytes;
+    std::uint64_t offset = seek(numBytes);
+    if (cursorBufferIdx_ == 0)
+      offset += beginIdx_;
+    buffers_ = buffers_.subspan(cursorBufferIdx_);
+    beginIdx_ = offset;
+    cursorBufferIdx_ = 0;
+    cursorBeginIdx_ = 0;
   }
 
   // copies numBytes from src to this span starting from beginIdx
   void copy_into(std::uint64_t copyAtIdx, std::uint8_t *src,
                  std::uint64_t numBytes) noexcept {
-    for (std::uint64_t i = 0; i < numBytes; ++i)
-      operator[](copyAtIdx + i) = src[i];
+    for_each_segment(copyAtIdx, numBytes,
+                     [&src](std::uint8_t *segment, std::uint64_t segmentSize) {
+                       std::memcpy(segment, src, segmentSize);
+                       src += segmentSize;
+                     });
   };
 
   void copy_into(std::uint8_t *src, std::uint64_t numBytes) noexcept {
@@ -128,8 +177,13 @@ public:
 
   void copy_to(void *dst, std::uint64_t numBytes,
                std::uint64_t copyFromBeginIdx) const noexcept {
-    for (std::uint64_t i = 0; i < numBytes; ++i)
-      static_cast<std::uint8_t *>(dst)[i] = operator[](i + copyFromBeginIdx);
+    auto *dstBytes = static_cast<std::uint8_t *>(dst);
+    for_each_segment(
+        copyFromBeginIdx, numBytes,
+        [&dstBytes](std::uint8_t *segment, std::uint64_t segmentSize) {
+          std::memcpy(dstBytes, segment, segmentSize);
+          dstBytes += segmentSize;
+        });
   };
   void copy_to(void *dst, std::uint64_t numBytes) const noexcept {
     copy_to(dst, numBytes, 0);
@@ -0,0 +1,132 @@
+#pragma once
+/////////////////////////////////////////////
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+/*
+    Per thread pool of memory blocks for objects of type T, to be used from
+    class specific operator new/delete
+    Contexts are allocated on one thread (subscription thread) and freed on
+    another (msquic worker), so a block freed on a different thread is handed
+    back to the thread which allocated it through a lock free stack (multi
+    producer, the owner takes the whole stack at once, so there is no ABA)
+    Neither allocation nor deallocation takes a lock or touches the allocator
+    once the pool is warm
+*/
+template <typename T> class ObjectPool {
+  struct ThreadPool;
+
+  struct Block {
+    alignas(T) std::byte storage_[sizeof(T)];
+    Block *next_;
+    ThreadPool *owner_;
+  };
+
+  struct ThreadPool {
+    // only touched by the owning thread
+    Block *localFree_ = nullptr;
+    // blocks freed by other threads
+    std::atomic<Block *> remoteFree_ = nullptr;
+    // one for every block allocated by this pool and one for the thread,
+    // blocks can be freed to the pool after the thread has exited
+    std::atomic<std::size_t> refCount_ = 1;
+
+    void release(std::size_t numRefs) noexcept {
+      if (refCount_.fetch_sub(numRefs, std::memory_order_acq_rel) == numRefs)
+        delete this;
+    }
+  };
+
+  // remoteFree_ of a thread which has exited, blocks are deleted instead
+  static Block *closed() noexcept {
+    static Block closedMarker;
+    return &closedMarker;
+  }
+
+  static std::size_t delete_list(Block *block) noexcept {
+    std::size_t numBlocks = 0;
+    for (; block != nullptr; ++numBlocks)
+      delete std::exchange(block, block->next_);
+    return numBlocks;
+  }
+
+  struct ThreadPoolHandle {
+    ThreadPool *threadPool_ = nullptr;
+
+    ~ThreadPoolHandle() {
+      if (threadPool_ == nullptr)
+        return;
+
+      std::size_t numBlocks = delete_list(threadPool_->localFree_);
+      numBlocks += delete_list(threadPool_->remoteFree_.exchange(
+          closed(), std::memory_order_acquire));
+      threadPool_->release(numBlocks + 1);
+    }
+  };
+
+  static thread_local ThreadPoolHandle threadPoolHandle_;
+
+  // created on first allocation, threads which only free never get a pool
+  static ThreadPool &local() {
+    if (threadPoolHandle_.threadPool_ == nullptr)
+      threadPoolHandle_.threadPool_ = new ThreadPool;
+    return *threadPoolHandle_.threadPool_;
+  }
+
+public:
+  static void *allocate() {
+    ThreadPool &threadPool = local();
+
+    if (threadPool.localFree_ == nullptr)
+      threadPool.localFree_ =
+          threadPool.remoteFree_.exchange(nullptr, std::memory_order_acquire);
+
+    Block *block = threadPool.localFree_;
+    if (block != nullptr)
+      threadPool.localFree_ = block->next_;
+    else {
+      block = new Block;
+      block->owner_ = &threadPool;
+      threadPool.refCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return block->storage_;
+  }
+
+  static void deallocate(void *object) noexcept {
+    if (object == nullptr)
+      return;
+
+    // storage_ is the first member of Block
+    Block *block = reinterpret_cast<Block *>(object);
+    ThreadPool *owner = block->owner_;
+
+    if (owner == threadPoolHandle_.threadPool_) {
+      block->next_ = owner->localFree_;
+      owner->localFree_ = block;
+      return;
+    }
+
+    Block *head = owner->remoteFree_.load(std::memory_order_relaxed);
+    do {
+      if (head == closed()) {
+        delete block;
+        owner->release(1);
+        return;
+      }
+      block->next_ = head;
+    } while (!owner->remoteFree_.compare_exchange_weak(
+        head, block, std::memory_order_release, std::memory_order_relaxed));
+  }
+};
+
+template <typename T>
+thread_local typename ObjectPool<T>::ThreadPoolHandle
+    ObjectPool<T>::threadPoolHandle_;
+
+} // namespace rvn
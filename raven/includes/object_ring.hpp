@@ -0,0 +1,160 @@
+#pragma once
+/////////////////////////////////////////////
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+// what push does when the ring is full
+enum class OverflowPolicy {
+  DROP_OLDEST, // the oldest object in the ring is dropped for the new one
+  DROP_NEWEST, // the new object is dropped
+  BLOCK        // the producer waits till the consumer makes room
+};
+
+/*
+    Bounded ring with a single producer and a single consumer
+    Every slot carries a sequence number (Vyukov's bounded queue) which tells
+    whether it is free for the position of the producer or holds the object
+    for the position of the consumer. Positions are taken out of the ring with
+    a CAS because with DROP_OLDEST the producer takes objects out as well
+    With BLOCK a consumer which falls behind holds up the producer, on the
+    client that is the MsQuic worker and every stream of the connection
+*/
+template <typename T> class ObjectRing {
+  static constexpr std::size_t cacheLineSize = 64;
+
+  struct Slot {
+    std::atomic<std::size_t> sequence_;
+    alignas(T) std::byte storage_[sizeof(T)];
+
+    T *object() noexcept {
+      return std::launder(reinterpret_cast<T *>(storage_));
+    }
+  };
+
+  const std::size_t mask_;
+  const OverflowPolicy overflowPolicy_;
+  std::unique_ptr<Slot[]> slots_;
+
+  // only written by the producer
+  alignas(cacheLineSize) std::atomic<std::size_t> writePos_ = 0;
+  alignas(cacheLineSize) std::atomic<std::size_t> readPos_ = 0;
+  std::atomic<std::uint64_t> numDropped_ = 0;
+
+  // value is only moved from if it is stored
+  bool try_store(T &value) {
+    std::size_t pos = writePos_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[pos & mask_];
+    if (slot.sequence_.load(std::memory_order_acquire) != pos)
+      return false;
+
+    new (slot.object()) T(std::move(value));
+    slot.sequence_.store(pos + 1, std::memory_order_release);
+    writePos_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // slot at the write position is being emptied by the consumer (as opposed
+  // to holding the oldest object)
+  bool being_emptied() const noexcept {
+    return readPos_.load(std::memory_order_acquire) + capacity() >
+           writePos_.load(std::memory_order_relaxed);
+  }
+
+public:
+  // capacity is rounded up to a power of 2
+  ObjectRing(std::size_t capacity, OverflowPolicy overflowPolicy)
+      : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1),
+        overflowPolicy_(overflowPolicy),
+        slots_(std::make_unique<Slot[]>(mask_ + 1)) {
+    for (std::size_t pos = 0; pos <= mask_; ++pos)
+      slots_[pos].sequence_.store(pos, std::memory_order_relaxed);
+  }
+
+  ObjectRing(const ObjectRing &) = delete;
+  ObjectRing &operator=(const ObjectRing &) = delete;
+
+  ~ObjectRing() {
+    std::size_t writePos = writePos_.load(std::memory_order_acquire);
+    for (std::size_t pos = readPos_.load(std::memory_order_acquire);
+         pos != writePos; ++pos)
+      slots_[pos & mask_].object()->~T();
+  }
+
+  std::size_t capacity() const noexcept { return mask_ + 1; }
+
+  std::size_t size_approx() const noexcept {
+    return writePos_.load(std::memory_order_relaxed) -
+           readPos_.load(std::memory_order_relaxed);
+  }
+
+  // objects dropped by the overflow policy
+  std::uint64_t num_dropped() const noexcept {
+    return numDropped_.load(std::memory_order_relaxed);
+  }
+
+  // producer
+  void push(T value) {
+    while (!try_store(value)) {
+      switch (overflowPolicy_) {
+      case OverflowPolicy::DROP_NEWEST:
+        numDropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      case OverflowPolicy::DROP_OLDEST:
+        if (being_emptied())
+          std::this_thread::yield();
+        else if (try_pop().has_value())
+          numDropped_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      case OverflowPolicy::BLOCK: {
+        Slot &slot =
+            slots_[writePos_.load(std::memory_order_relaxed) & mask_];
+        std::size_t sequence = slot.sequence_.load(std::memory_order_acquire);
+        if (sequence != writePos_.load(std::memory_order_relaxed))
+          slot.sequence_.wait(sequence, std::memory_order_acquire);
+        break;
+      }
+      }
+    }
+  }
+
+  // consumer
+  std::optional<T> try_pop() {
+    std::size_t pos = readPos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slots_[pos & mask_];
+      std::size_t sequence = slot.sequence_.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+      if (diff < 0)
+        return std::nullopt;
+      // the other side took the object at pos
+      if (diff > 0) {
+        pos = readPos_.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (!readPos_.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed))
+        continue;
+
+      std::optional<T> value(std::move(*slot.object()));
+      slot.object()->~T();
+      slot.sequence_.store(pos + capacity(), std::memory_order_release);
+      if (overflowPolicy_ == OverflowPolicy::BLOCK)
+        slot.sequence_.notify_one();
+      return value;
+    }
+  }
+};
+
+} // namespace rvn
@@ -0,0 +1,101 @@
+#pragma once
+/////////////////////////////////////////////
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+/////////////////////////////////////////////
+#include <boost/container/small_vector.hpp>
+/////////////////////////////////////////////
+#include <wrappers.hpp>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+/*
+    Payload of a received object which references the receive buffers it was
+    deserialized from instead of owning a copy
+    It is a rope of slices of refcounted buffers, an object which is within
+    one buffer is a single slice and can be used in place, objects spanning
+    buffers are copied (once) only if contiguous memory is asked for
+*/
+class PayloadView {
+public:
+  struct Slice {
+    // keeps the bytes alive
+    std::shared_ptr<const QUIC_BUFFER> buffer_;
+    std::span<const std::uint8_t> bytes_;
+  };
+
+private:
+  boost::container::small_vector<Slice, 2> slices_;
+  std::uint64_t size_ = 0;
+
+public:
+  void append(std::shared_ptr<const QUIC_BUFFER> buffer,
+              std::span<const std::uint8_t> bytes) {
+    size_ += bytes.size();
+    slices_.push_back({std::move(buffer), bytes});
+  }
+
+  std::uint64_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  bool is_contiguous() const noexcept { return slices_.size() <= 1; }
+
+  // for scatter gather consumers, no copy
+  std::span<const Slice> slices() const noexcept {
+    return {slices_.data(), slices_.size()};
+  }
+
+  // coalesces the slices into one buffer if there are several
+  std::span<const std::uint8_t> contiguous() {
+    if (slices_.empty())
+      return {};
+
+    if (slices_.size() > 1) {
+      UniqueQuicBuffer buffer = make_owned_quic_buffer(size_);
+      copy_to(buffer->Buffer);
+      std::span<const std::uint8_t> bytes(buffer->Buffer, size_);
+
+      slices_.clear();
+      slices_.push_back(
+          {std::shared_ptr<const QUIC_BUFFER>(std::move(buffer)), bytes});
+    }
+    return slices_.front().bytes_;
+  }
+
+  std::string_view string_view() {
+    auto bytes = contiguous();
+    return {reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+  }
+
+  void copy_to(std::uint8_t *dst) const noexcept {
+    for (const auto &slice : slices_) {
+      std::memcpy(dst, slice.bytes_.data(), slice.bytes_.size());
+      dst += slice.bytes_.size();
+    }
+  }
+
+  std::string to_string() const {
+    std::string payload(size_, '\0');
+    copy_to(reinterpret_cast<std::uint8_t *>(payload.data()));
+    return payload;
+  }
+
+  // compares bytes, not buffers
+  bool operator==(const PayloadView &rhs) const {
+    return size_ == rhs.size_ && to_string() == rhs.to_string();
+  }
+
+  friend inline std::ostream &operator<<(std::ostream &os,
+                                         const PayloadView &payloadView) {
+    os << "PayloadViewLength: " << payloadView.size_
+       << " Slices: " << payloadView.slices_.size();
+    return os;
+  }
+};
+
+} // namespace rvn
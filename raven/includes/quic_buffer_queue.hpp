@@ -0,0 +1,81 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////////
+#include <cstdint>
+#include <span>
+#include <vector>
+///////////////////////////////////////////////////////////////////////////////
+#include <wrappers.hpp>
+///////////////////////////////////////////////////////////////////////////////
+
+namespace rvn::serialization {
+
+/*
+    Queue of received buffers of a Deserializer
+    Unread buffers stay contiguous so that they can be viewed as a span (see
+    NonContiguousSpan). Popping moves the head instead of erasing from the
+    front of the vector, the storage is reused from the start once every
+    buffer is read and is compacted only when the read prefix is at least
+    half of it, so popping is amortized O(1)
+*/
+class QuicBufferQueue {
+  std::vector<UniqueQuicBuffer> buffers_;
+  // index of the first unread buffer
+  std::size_t head_ = 0;
+
+  // small read prefixes are not worth moving the unread buffers for
+  static constexpr std::size_t minCompactSize = 32;
+
+public:
+  using iterator = std::vector<UniqueQuicBuffer>::iterator;
+  using const_iterator = std::vector<UniqueQuicBuffer>::const_iterator;
+
+  iterator begin() noexcept { return buffers_.begin() + head_; }
+  iterator end() noexcept { return buffers_.end(); }
+  const_iterator begin() const noexcept { return buffers_.begin() + head_; }
+  const_iterator end() const noexcept { return buffers_.end(); }
+
+  std::size_t size() const noexcept { return buffers_.size() - head_; }
+  bool empty() const noexcept { return size() == 0; }
+
+  UniqueQuicBuffer &front() noexcept { return buffers_[head_]; }
+  const UniqueQuicBuffer &front() const noexcept { return buffers_[head_]; }
+  UniqueQuicBuffer &back() noexcept { return buffers_.back(); }
+
+  UniqueQuicBuffer &operator[](std::size_t index) noexcept {
+    return buffers_[head_ + index];
+  }
+
+  operator std::span<UniqueQuicBuffer>() noexcept {
+    return {buffers_.data() + head_, size()};
+  }
+
+  void push_back(UniqueQuicBuffer buffer) {
+    buffers_.emplace_back(std::move(buffer));
+  }
+
+  // buffers are released right away (borrowed buffers go back to MsQuic)
+  void pop_front(std::size_t numBuffers) noexcept {
+    for (std::size_t i = 0; i < numBuffers; ++i)
+      buffers_[head_ + i].reset();
+    head_ += numBuffers;
+
+    if (head_ == buffers_.size()) {
+      buffers_.clear();
+      head_ = 0;
+    } else if (head_ >= minCompactSize && 2 * head_ >= buffers_.size()) {
+      buffers_.erase(buffers_.begin(), buffers_.begin() + head_);
+      head_ = 0;
+    }
+  }
+
+  // removes the buffers from first to the end
+  void truncate(iterator first) noexcept {
+    buffers_.erase(first, end());
+    if (head_ == buffers_.size()) {
+      buffers_.clear();
+      head_ = 0;
+    }
+  }
+};
+
+} // namespace rvn::serialization
@@ -216,4 +216,35 @@ public:
     return os;
   }
 };
+
+// Same as ChunkSpan, over memory we do not own (QUIC_BUFFER of a datagram)
+class BufferSpan {
+  const std::uint8_t *data_;
+  std::uint64_t size_;
+
+public:
+  BufferSpan(const std::uint8_t *data, std::uint64_t size)
+      : data_(data), size_(size) {}
+
+  void copy_to(void *dest, std::uint64_t size) const {
+    utils::ASSERT_LOG_THROW(size <= size_,
+                            "size must be less than or equal to span size");
+    std::memcpy(dest, data_, size);
+  }
+
+  const std::uint8_t *data() const noexcept { return data_; }
+
+  std::uint64_t size() const noexcept { return size_; }
+
+  std::uint8_t operator[](std::uint64_t index) const noexcept {
+    return data_[index];
+  }
+
+  void advance_begin(std::uint64_t size) {
+    utils::ASSERT_LOG_THROW(size <= size_,
+                            "can not advance past the end of the span");
+    data_ += size;
+    size_ -= size;
+  }
+};
 } // namespace rvn::ds
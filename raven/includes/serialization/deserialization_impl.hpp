@@ -146,6 +146,14 @@ deserialize_params(std::vector<Parameter> &parameters, ConstSpan &span,
       parameter.parameter_ = deliveryTimeoutParameter;
       break;
     }
+    case ParameterType::DeliveryMode: {
+      DeliveryModeParameter deliveryModeParameter;
+      std::uint64_t mode;
+      deserializedBytes += deserialize<ds::quic_var_int>(mode, span);
+      deliveryModeParameter.mode_ = static_cast<DeliveryMode>(mode);
+      parameter.parameter_ = deliveryModeParameter;
+      break;
+    }
     default:
       utils::ASSERT_LOG_THROW(false, "Unknown parameter type: ", parameterType);
     }
@@ -211,6 +219,22 @@ deserialize(rvn::ServerSetupMessage &serverSetupMessage, ConstSpan &span,
   return deserializedBytes;
 }
 
+template <typename ConstSpan>
+static inline deserialize_return_t
+deserialize(rvn::GoAwayMessage &goAwayMessage, ConstSpan &span,
+            NetworkEndian = network_endian) {
+  std::uint64_t deserializedBytes = 0;
+
+  std::uint64_t newSessionURILength;
+  deserializedBytes += deserialize<ds::quic_var_int>(newSessionURILength, span);
+  goAwayMessage.newSessionURI_ = std::string(newSessionURILength, '\0');
+  span.copy_to(goAwayMessage.newSessionURI_.data(), newSessionURILength);
+  deserializedBytes += newSessionURILength;
+  span.advance_begin(newSessionURILength);
+
+  return deserializedBytes;
+}
+
 template <typename ConstSpan>
 static inline deserialize_return_t
 deserialize(rvn::SubscribeMessage &subscribeMessage, ConstSpan &span,
@@ -276,6 +300,54 @@ deserialize(rvn::SubscribeMessage &subscribeMessage, ConstSpan &span,
   return deserializedBytes;
 }
 
+template <typename ConstSpan>
+static inline deserialize_return_t
+deserialize(rvn::FetchMessage &fetchMessage, ConstSpan &span,
+            NetworkEndian = network_endian) {
+  std::uint64_t deserializedBytes = 0;
+
+  deserializedBytes +=
+      deserialize<ds::quic_var_int>(fetchMessage.subscribeId_, span);
+
+  std::uint64_t numTrackNamespace;
+  deserializedBytes += deserialize<ds::quic_var_int>(numTrackNamespace, span);
+  fetchMessage.trackNamespace_.resize(numTrackNamespace);
+  for (auto &ns : fetchMessage.trackNamespace_) {
+    std::uint64_t nsLength;
+    deserializedBytes += deserialize<ds::quic_var_int>(nsLength, span);
+
+    ns = std::string(nsLength, '\0');
+    span.copy_to(ns.data(), nsLength);
+    deserializedBytes += nsLength;
+    span.advance_begin(nsLength);
+  }
+
+  std::uint64_t trackNameLength;
+  deserializedBytes += deserialize<ds::quic_var_int>(trackNameLength, span);
+  fetchMessage.trackName_ = std::string(trackNameLength, '\0');
+  span.copy_to(fetchMessage.trackName_.data(), trackNameLength);
+  deserializedBytes += trackNameLength;
+  span.advance_begin(trackNameLength);
+
+  deserializedBytes += deserialize_trivial<std::uint8_t>(
+      fetchMessage.subscriberPriority_, span);
+  deserializedBytes +=
+      deserialize_trivial<std::uint8_t>(fetchMessage.groupOrder_, span);
+
+  deserializedBytes +=
+      deserialize<ds::quic_var_int>(fetchMessage.start_.group_.get(), span);
+  deserializedBytes +=
+      deserialize<ds::quic_var_int>(fetchMessage.start_.object_.get(), span);
+  deserializedBytes +=
+      deserialize<ds::quic_var_int>(fetchMessage.end_.group_.get(), span);
+  deserializedBytes +=
+      deserialize<ds::quic_var_int>(fetchMessage.end_.object_.get(), span);
+
+  deserializedBytes += deserialize_params(fetchMessage.parameters_, span);
+
+  return deserializedBytes;
+}
+
 template <typename ConstSpan>
 static inline deserialize_return_t
 deserialize(rvn::BatchSubscribeMessage &batchSubscribeMessage, ConstSpan &span,
@@ -329,4 +401,44 @@ deserialize(rvn::SubscribeErrorMessage &subscribeErrorMessage, ConstSpan &span,
   return deserializedBytes;
 }
 
+// span is the whole datagram, including the type
+template <typename ConstSpan>
+static inline deserialize_return_t
+deserialize(rvn::ObjectDatagramMessage &objectDatagramMessage, ConstSpan &span,
+            NetworkEndian = network_endian) {
+  std::uint64_t deserializedBytes = 0;
+
+  std::uint64_t type;
+  deserializedBytes += deserialize<ds::quic_var_int>(type, span);
+  utils::ASSERT_LOG_THROW(static_cast<DataStreamType>(type) ==
+                              DataStreamType::OBJECT_DATAGRAM,
+                          "Invalid datagram type", type);
+
+  deserializedBytes += deserialize<ds::quic_var_int>(
+      objectDatagramMessage.trackAlias_.get(), span);
+  deserializedBytes += deserialize<ds::quic_var_int>(
+      objectDatagramMessage.groupId_.get(), span);
+  deserializedBytes += deserialize<ds::quic_var_int>(
+      objectDatagramMessage.objectId_.get(), span);
+
+  std::uint8_t publisherPriority;
+  deserializedBytes +=
+      deserialize_trivial<std::uint8_t>(publisherPriority, span);
+  objectDatagramMessage.publisherPriority_ =
+      PublisherPriority(publisherPriority);
+
+  std::uint64_t payloadLength;
+  deserializedBytes += deserialize<ds::quic_var_int>(payloadLength, span);
+  utils::ASSERT_LOG_THROW(payloadLength <= span.size(),
+                          "Datagram payload length exceeds datagram",
+                          payloadLength, ">", span.size());
+
+  objectDatagramMessage.payload_.resize(payloadLength);
+  span.copy_to(objectDatagramMessage.payload_.data(), payloadLength);
+  span.advance_begin(payloadLength);
+  deserializedBytes += payloadLength;
+
+  return deserializedBytes;
+}
+
 } // namespace rvn::serialization::detail
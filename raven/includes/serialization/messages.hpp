@@ -3,6 +3,7 @@
 #pragma once
 ////////////////////////////////////////////
 #include <chrono>
+#include <payload_view.hpp>
 #include <serialization/quic_var_int.hpp>
 #include <strong_types.hpp>
 #include <utilities.hpp>
@@ -39,6 +40,7 @@ enum class MoQtMessageType {
   TRACK_STATUS = 0xE,
   GOAWAY = 0x10,
   BATCH_SUBSCRIBE = 0x11,
+  FETCH = 0x16,
   CLIENT_SETUP = 0x40,
   SERVER_SETUP = 0x41,
   // not in draft v7 // STREAM_HEADER_TRACK = 0x50,
@@ -54,6 +56,8 @@ struct ControlMessageHeader {
 
 enum class ParameterType : std::uint64_t {
   DeliveryTimeout = 0x03,
+  // not in draft v7, raven extension
+  DeliveryMode = 0x7E,
 };
 
 // Only one parameter of each type should be sent
@@ -70,7 +74,31 @@ struct DeliveryTimeoutParameter {
   }
 };
 
-using ParameterImpl = std::variant<DeliveryTimeoutParameter>;
+// how objects of a subscription are sent to the subscriber
+enum class DeliveryMode : std::uint8_t {
+  // one stream per subgroup (STREAM_HEADER_SUBGROUP)
+  Subgroup,
+  // every object in its own QUIC datagram (OBJECT_DATAGRAM), objects which do
+  // not fit in a datagram are sent on streams
+  Datagram,
+  // one stream for the whole track (STREAM_HEADER_TRACK)
+  Track,
+};
+
+struct DeliveryModeParameter {
+  DeliveryMode mode_;
+
+  bool operator==(const DeliveryModeParameter &) const = default;
+
+  friend inline std::ostream &operator<<(std::ostream &os,
+                                         const DeliveryModeParameter &param) {
+    os << "DeliveryMode: " << static_cast<int>(param.mode_);
+    return os;
+  }
+};
+
+using ParameterImpl =
+    std::variant<DeliveryTimeoutParameter, DeliveryModeParameter>;
 struct Parameter {
   ParameterImpl parameter_;
 
@@ -323,11 +351,93 @@ struct BatchSubscribeMessage
 
 /*
     GOAWAY Message {
+      Type (i) = 0x10,
+      Length (i),
       New Session URI (b)
     }
 */
-struct GoAwayMessage {
-  BinaryBufferData newSessionURI;
+struct GoAwayMessage : ControlMessageBase<GoAwayMessage> {
+  // empty => reconnect to the same server
+  BinaryBufferData newSessionURI_;
+
+  GoAwayMessage() : ControlMessageBase(MoQtMessageType::GOAWAY) {}
+  GoAwayMessage(BinaryBufferData newSessionURI)
+      : ControlMessageBase(MoQtMessageType::GOAWAY),
+        newSessionURI_(std::move(newSessionURI)) {}
+
+  bool operator==(const GoAwayMessage &) const = default;
+
+  friend inline std::ostream &operator<<(std::ostream &os,
+                                         const GoAwayMessage &msg) {
+    os << "NewSessionURI: " << msg.newSessionURI_;
+    return os;
+  }
+};
+
+/*
+    FETCH Message {
+      Type (i) = 0x16,
+      Length (i),
+      Subscribe ID (i),
+      Track Namespace (tuple),
+      Track Name Length (i),
+      Track Name (..),
+      Subscriber Priority (8),
+      Group Order (8),
+      StartGroup (i),
+      StartObject (i),
+      EndGroup (i),
+      EndObject (i),
+      Number of Parameters (i),
+      Parameters (..) ...
+    }
+    Range of objects which have already been published, sent in order on a
+    single stream starting with FETCH_HEADER
+    StartGroup/StartObject and EndGroup are inclusive, EndObject is the end
+    object plus 1, 0 means the whole of EndGroup
+*/
+struct FetchMessage : ControlMessageBase<FetchMessage> {
+  std::uint64_t subscribeId_;
+  // encoding moqt tuple as vector<string>
+  std::vector<std::string> trackNamespace_;
+  std::string trackName_;
+  std::uint8_t subscriberPriority_;
+  std::uint8_t groupOrder_;
+  GroupObjectPair start_;
+  GroupObjectPair end_;
+  std::vector<Parameter> parameters_;
+
+  FetchMessage() : ControlMessageBase(MoQtMessageType::FETCH) {}
+
+  bool operator==(const FetchMessage &rhs) const {
+    bool isEqual = true;
+
+    isEqual &= subscribeId_ == rhs.subscribeId_;
+    isEqual &= trackNamespace_ == rhs.trackNamespace_;
+    isEqual &= trackName_ == rhs.trackName_;
+    isEqual &= subscriberPriority_ == rhs.subscriberPriority_;
+    isEqual &= groupOrder_ == rhs.groupOrder_;
+    isEqual &= start_ == rhs.start_;
+    isEqual &= end_ == rhs.end_;
+    isEqual &= parameters_ == rhs.parameters_;
+
+    return isEqual;
+  }
+
+  friend inline std::ostream &operator<<(std::ostream &os,
+                                         const FetchMessage &msg) {
+    os << "SubscribeId: " << msg.subscribeId_ << " TrackNamespace: ";
+    for (const auto &ns : msg.trackNamespace_)
+      os << ns << " ";
+    os << " TrackName: " << msg.trackName_
+       << " SubscriberPriority: " << msg.subscriberPriority_
+       << " GroupOrder: " << msg.groupOrder_ << " Start: " << msg.start_.group_
+       << " " << msg.start_.object_ << " End: " << msg.end_.group_ << " "
+       << msg.end_.object_ << " Parameters: ";
+    for (const auto &parameter : msg.parameters_)
+      os << parameter;
+    return os;
+  }
 };
 
 /*
@@ -452,38 +562,66 @@ struct ObjectStreamMessage {
   BinaryBufferData objectPayload;
 };
 
+// Data Stream messages
+enum class DataStreamType {
+  OBJECT_DATAGRAM = 0x1,
+  STREAM_HEADER_SUBGROUP = 0x4,
+  FETCH_HEADER = 0x5,
+  // not in draft v7 (was in earlier drafts), raven extension
+  STREAM_HEADER_TRACK = 0x50
+};
+
 /*
     OBJECT_DATAGRAM Message {
-      Subscribe ID (i),
       Track Alias (i),
       Group ID (i),
       Object ID (i),
       Publisher Priority (8),
-      Object Status (i),
+      Object Payload Length (i),
       Object Payload (..),
     }
+    Sent as a QUIC datagram, one object per datagram
 */
 struct ObjectDatagramMessage {
-  iType subscribeId;
-  iType trackAlias;
-  iType group;
-  iType object;
-  std::uint8_t publisherPriority;
-  ObjectStatus objectStatus;
-  BinaryBufferData objectPayload;
+  static constexpr auto id_ = DataStreamType::OBJECT_DATAGRAM;
+  TrackAlias trackAlias_;
+  GroupId groupId_;
+  ObjectId objectId_;
+  PublisherPriority publisherPriority_;
+  std::string payload_;
+
+  bool operator==(const ObjectDatagramMessage &rhs) const = default;
+
+  inline friend std::ostream &operator<<(std::ostream &os,
+                                         const ObjectDatagramMessage &msg) {
+    os << "TrackAlias: " << msg.trackAlias_ << " GroupId: " << msg.groupId_
+       << " ObjectId: " << msg.objectId_
+       << " PublisherPriority: " << msg.publisherPriority_
+       << " PayloadLength: " << msg.payload_.size();
+    return os;
+  }
 };
 
 /*
     STREAM_HEADER_TRACK Message {
-      Subscribe ID (i)
       Track Alias (i),
-      Publisher Priority (8),(i)
+      Publisher Priority (8),
     }
+    All objects of the track are sent on one stream
 */
 struct StreamHeaderTrackMessage {
-  iType subscribeId;
-  iType trackAlias;
-  std::uint8_t publisherPriority;
+  static constexpr auto id_ = DataStreamType::STREAM_HEADER_TRACK;
+  TrackAlias trackAlias_;
+  PublisherPriority publisherPriority_;
+
+  bool operator==(const StreamHeaderTrackMessage &rhs) const = default;
+
+  inline friend std::ostream &
+  operator<<(std::ostream &os, const StreamHeaderTrackMessage &msg) {
+    os << "TrackAlias: " << msg.trackAlias_
+       << " PublisherPriority: " << msg.publisherPriority_;
+    return os;
+  }
 };
 
 /*
@@ -491,17 +629,83 @@ struct StreamHeaderTrackMessage {
       Group ID (i),
       Object ID (i),
       Object Payload Length (i),
-      [Object Status (i)],
       Object Payload (..),
     }
+    Object type sent on StreamHeaderTrack data streams
 */
 struct TrackStreamObjectMessage {
-  iType group;
-  iType object;
-  iType objectPayloadLength;
-  std::optional<ObjectStatus> objectStatus; // optional, exists only is
-                                            // payload length is 0
-  BinaryBufferData objectPayload;
+  GroupId groupId_;
+  ObjectId objectId_;
+  std::string payload_;
+  // set instead of payload_ by deserializers which make payload views
+  PayloadView payloadView_{};
+
+  bool operator==(const TrackStreamObjectMessage &rhs) const = default;
+
+  inline friend std::ostream &
+  operator<<(std::ostream &os, const TrackStreamObjectMessage &msg) {
+    os << "GroupId: " << msg.groupId_ << " ObjectId: " << msg.objectId_
+       << " PayloadLength: " << msg.payload_.size() << " "
+       << msg.payloadView_;
+    return os;
+  }
+};
+
+/*
+    FETCH_HEADER Message {
+      Subscribe ID (i),
+    }
+    Header of the stream carrying the objects of a FETCH
+*/
+struct FetchHeaderMessage {
+  static constexpr auto id_ = DataStreamType::FETCH_HEADER;
+  std::uint64_t subscribeId_;
+
+  bool operator==(const FetchHeaderMessage &rhs) const = default;
+
+  inline friend std::ostream &operator<<(std::ostream &os,
+                                         const FetchHeaderMessage &msg) {
+    os << "SubscribeId: " << msg.subscribeId_;
+    return os;
+  }
+};
+
+/*
+    FetchObject Message{
+      Group ID (i),
+      Subgroup ID (i),
+      Publisher Priority (8),
+      Object ID (i),
+      Object Payload Length (i),
+      Object Payload (..),
+    }
+    Object type sent on FETCH_HEADER data streams, objects come in (group,
+    object) order and the stream ends (FIN) after the last one of the range
+    Draft v7 puts Object ID before Publisher Priority, raven sends the
+    priority first so that the rest of the object is the object as the
+    DataManager caches it (see StreamHeaderSubgroupObject) and is sent
+    without a copy
+*/
+struct FetchObjectMessage {
+  GroupId groupId_;
+  SubGroupId subgroupId_;
+  PublisherPriority publisherPriority_;
+  ObjectId objectId_;
+  std::string payload_;
+  // set instead of payload_ by deserializers which make payload views
+  PayloadView payloadView_{};
+
+  bool operator==(const FetchObjectMessage &rhs) const = default;
+
+  inline friend std::ostream &operator<<(std::ostream &os,
+                                         const FetchObjectMessage &msg) {
+    os << "GroupId: " << msg.groupId_ << " SubgroupId: " << msg.subgroupId_
+       << " PublisherPriority: " << msg.publisherPriority_
+       << " ObjectId: " << msg.objectId_
+       << " PayloadLength: " << msg.payload_.size() << " "
+       << msg.payloadView_;
+    return os;
+  }
 };
 
 /*
@@ -634,13 +838,6 @@ struct TrackStatusMessage {
   iType lastObjectId;
 };
 
-// Data Stream messages
-enum class DataStreamType {
-  OBJECT_DATAGRAM = 0x1,
-  STREAM_HEADER_SUBGROUP = 0x4,
-  FETCH_HEADER = 0x5
-};
-
 /*
     STREAM_HEADER_SUBGROUP Message {
       Track Alias (i),
@@ -671,13 +868,16 @@ struct StreamHeaderSubgroupMessage {
 struct StreamHeaderSubgroupObject {
   std::uint64_t objectId_;
   std::string payload_;
+  // set instead of payload_ by deserializers which make payload views (see
+  // MOQT::set_payloadViews), only on received objects
+  PayloadView payloadView_{};
 
   bool operator==(const StreamHeaderSubgroupObject &rhs) const = default;
   inline friend std::ostream &
   operator<<(std::ostream &os, const StreamHeaderSubgroupObject &msg) {
     os << "ObjectId: " << msg.objectId_
        << " PayloadLength: " << msg.payload_.size()
-       << " Payload: " << msg.payload_;
+       << " Payload: " << msg.payload_ << " " << msg.payloadView_;
     return os;
   }
 };
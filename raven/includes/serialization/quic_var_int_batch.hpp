@@ -0,0 +1,348 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <span>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RAVEN_QUIC_VAR_INT_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace rvn::serialization::detail {
+/*
+    Batch codec for runs of quic_var_ints in contiguous memory
+
+    The position of a varint depends on the length of the previous one, so
+    lengths are classified one by one (from the 2 bit prefix), the rest is done
+    in bulk:
+    SSSE3: 2 varints per 16 byte load, one shuffle byte swaps both into two
+           64 bit lanes and one mask clears the prefixes
+    AVX2:  4 varints per iteration, two 16 byte windows in the two 128 bit
+           lanes of a 256 bit register
+    Both use a shuffle table indexed by the prefixes of the 2 varints of a
+    lane. The scalar fallback does one 8 byte load and byte swap per varint
+    and is used for the tail of a batch
+
+    SIMD paths are compiled with target attributes and selected at runtime,
+    so the library does not need to be built with -mavx2
+*/
+
+enum class QuicVarIntCodec { SCALAR, SSSE3, AVX2 };
+
+struct QuicVarIntBatch {
+  // number of varints decoded/encoded
+  std::size_t numValues_;
+  // number of bytes consumed/produced
+  std::uint64_t numBytes_;
+};
+
+// destination of encode_quic_var_ints should have room for this many bytes
+constexpr std::uint64_t max_encoded_size(std::size_t numValues) noexcept {
+  return 8 * numValues;
+}
+
+namespace quic_var_int_batch {
+
+inline std::uint8_t length(std::uint8_t firstByte) noexcept {
+  return 1 << (firstByte >> 6);
+}
+
+inline std::uint8_t code(std::uint64_t value) noexcept {
+  return (value >= (1 << 6)) + (value >= (1 << 14)) + (value >= (1 << 30));
+}
+
+// clears the 2 bit prefix of a varint of the given length
+constexpr std::uint64_t value_mask(std::uint8_t length) noexcept {
+  return (std::uint64_t(1) << (8 * length - 2)) - 1;
+}
+
+// src should have 8 readable bytes
+inline std::uint64_t decode_unchecked(const std::uint8_t *src,
+                                      std::uint8_t length) noexcept {
+  std::uint64_t bigEndian;
+  std::memcpy(&bigEndian, src, sizeof(bigEndian));
+  return (be64toh(bigEndian) >> (64 - 8 * length)) & value_mask(length);
+}
+
+inline std::uint64_t decode_bytewise(const std::uint8_t *src,
+                                     std::uint8_t length) noexcept {
+  std::uint64_t value = src[0];
+  for (std::uint8_t i = 1; i < length; ++i)
+    value = (value << 8) | src[i];
+  return value & value_mask(length);
+}
+
+// writes 8 bytes to dst, returns number of bytes of the varint
+inline std::uint8_t encode_unchecked(std::uint8_t *dst,
+                                     std::uint64_t value) noexcept {
+  std::uint8_t c = code(value);
+  std::uint8_t length = 1 << c;
+  std::uint64_t prefixed = value | (std::uint64_t(c) << (8 * length - 2));
+  std::uint64_t bigEndian = htobe64(prefixed << (64 - 8 * length));
+  std::memcpy(dst, &bigEndian, sizeof(bigEndian));
+  return length;
+}
+
+inline QuicVarIntBatch decode_scalar(std::span<const std::uint8_t> bytes,
+                                     std::span<std::uint64_t> values,
+                                     QuicVarIntBatch batch) noexcept {
+  while (batch.numValues_ < values.size() && batch.numBytes_ < bytes.size()) {
+    const std::uint8_t *src = bytes.data() + batch.numBytes_;
+    std::uint64_t remaining = bytes.size() - batch.numBytes_;
+    std::uint8_t length = quic_var_int_batch::length(*src);
+    if (remaining < length)
+      break;
+
+    values[batch.numValues_++] = remaining >= 8
+                                     ? decode_unchecked(src, length)
+                                     : decode_bytewise(src, length);
+    batch.numBytes_ += length;
+  }
+  return batch;
+}
+
+inline QuicVarIntBatch encode_scalar(std::uint8_t *dst,
+                                     std::span<const std::uint64_t> values,
+                                     QuicVarIntBatch batch) noexcept {
+  for (; batch.numValues_ < values.size(); ++batch.numValues_)
+    batch.numBytes_ +=
+        encode_unchecked(dst + batch.numBytes_, values[batch.numValues_]);
+  return batch;
+}
+
+#ifdef RAVEN_QUIC_VAR_INT_SIMD
+using ShuffleTable = std::array<std::array<std::uint8_t, 16>, 16>;
+
+// index: (code of first varint << 2) | code of second varint
+// the first varint (at byte 0) is byte swapped into the low 64 bit lane, the
+// second (right after the first) into the high lane
+constexpr ShuffleTable make_decode_shuffle_table() {
+  ShuffleTable table{};
+  for (std::uint8_t index = 0; index < 16; ++index) {
+    std::uint8_t length0 = 1 << (index >> 2);
+    std::uint8_t length1 = 1 << (index & 0b11);
+    for (std::uint8_t i = 0; i < 8; ++i) {
+      table[index][i] = i < length0 ? length0 - 1 - i : 0x80;
+      table[index][8 + i] = i < length1 ? length0 + length1 - 1 - i : 0x80;
+    }
+  }
+  return table;
+}
+
+// inverse of the decode shuffle, the two prefixed values in the 64 bit lanes
+// are byte swapped into consecutive big endian varints
+constexpr ShuffleTable make_encode_shuffle_table() {
+  ShuffleTable table{};
+  for (std::uint8_t index = 0; index < 16; ++index) {
+    std::uint8_t length0 = 1 << (index >> 2);
+    std::uint8_t length1 = 1 << (index & 0b11);
+    for (std::uint8_t i = 0; i < 16; ++i)
+      table[index][i] = 0x80;
+    for (std::uint8_t i = 0; i < length0; ++i)
+      table[index][i] = length0 - 1 - i;
+    for (std::uint8_t i = 0; i < length1; ++i)
+      table[index][length0 + i] = 8 + length1 - 1 - i;
+  }
+  return table;
+}
+
+alignas(16) inline constexpr ShuffleTable decodeShuffleTable =
+    make_decode_shuffle_table();
+alignas(16) inline constexpr ShuffleTable encodeShuffleTable =
+    make_encode_shuffle_table();
+inline constexpr std::array<std::uint64_t, 4> valueMasks = {
+    value_mask(1), value_mask(2), value_mask(4), value_mask(8)};
+
+__attribute__((target("ssse3"))) inline __m128i
+load_128(const std::uint8_t *src) noexcept {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+}
+
+// low and high 128 bit lanes
+__attribute__((target("avx2"))) inline __m256i
+load_2x128(const std::uint8_t *low, const std::uint8_t *high) noexcept {
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(load_128(low)),
+                                 load_128(high), 1);
+}
+
+__attribute__((target("ssse3"))) inline QuicVarIntBatch
+decode_ssse3(std::span<const std::uint8_t> bytes,
+             std::span<std::uint64_t> values, QuicVarIntBatch batch) noexcept {
+  while (values.size() - batch.numValues_ >= 2 &&
+         bytes.size() - batch.numBytes_ >= 16) {
+    const std::uint8_t *src = bytes.data() + batch.numBytes_;
+    std::uint8_t code0 = src[0] >> 6;
+    std::uint8_t code1 = src[1 << code0] >> 6;
+
+    __m128i shuffle = load_128(decodeShuffleTable[(code0 << 2) | code1].data());
+    __m128i mask = _mm_set_epi64x(valueMasks[code1], valueMasks[code0]);
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(values.data() + batch.numValues_),
+        _mm_and_si128(_mm_shuffle_epi8(load_128(src), shuffle), mask));
+    batch.numValues_ += 2;
+    batch.numBytes_ += (1 << code0) + (1 << code1);
+  }
+  return batch;
+}
+
+__attribute__((target("avx2"))) inline QuicVarIntBatch
+decode_avx2(std::span<const std::uint8_t> bytes,
+            std::span<std::uint64_t> values, QuicVarIntBatch batch) noexcept {
+  while (values.size() - batch.numValues_ >= 4 &&
+         bytes.size() - batch.numBytes_ >= 32) {
+    const std::uint8_t *src = bytes.data() + batch.numBytes_;
+    std::uint8_t code0 = src[0] >> 6;
+    std::uint8_t code1 = src[1 << code0] >> 6;
+    std::uint8_t pairLength0 = (1 << code0) + (1 << code1);
+    std::uint8_t code2 = src[pairLength0] >> 6;
+    std::uint8_t code3 = src[pairLength0 + (1 << code2)] >> 6;
+    std::uint8_t pairLength1 = (1 << code2) + (1 << code3);
+
+    __m256i shuffle =
+        load_2x128(decodeShuffleTable[(code0 << 2) | code1].data(),
+                   decodeShuffleTable[(code2 << 2) | code3].data());
+    __m256i mask = _mm256_set_epi64x(valueMasks[code3], valueMasks[code2],
+                                     valueMasks[code1], valueMasks[code0]);
+    __m256i windows = load_2x128(src, src + pairLength0);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(values.data() + batch.numValues_),
+        _mm256_and_si256(_mm256_shuffle_epi8(windows, shuffle), mask));
+    batch.numValues_ += 4;
+    batch.numBytes_ += pairLength0 + pairLength1;
+  }
+  return batch;
+}
+
+__attribute__((target("ssse3"))) inline QuicVarIntBatch
+encode_ssse3(std::uint8_t *dst, std::span<const std::uint64_t> values,
+             QuicVarIntBatch batch) noexcept {
+  // 16 byte store for 2 varints stays within max_encoded_size
+  while (values.size() - batch.numValues_ >= 2) {
+    std::uint64_t value0 = values[batch.numValues_];
+    std::uint64_t value1 = values[batch.numValues_ + 1];
+    std::uint8_t code0 = code(value0);
+    std::uint8_t code1 = code(value1);
+    std::uint8_t length0 = 1 << code0;
+    std::uint8_t length1 = 1 << code1;
+
+    __m128i prefixed = _mm_set_epi64x(
+        value1 | (std::uint64_t(code1) << (8 * length1 - 2)),
+        value0 | (std::uint64_t(code0) << (8 * length0 - 2)));
+    __m128i shuffle = load_128(encodeShuffleTable[(code0 << 2) | code1].data());
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + batch.numBytes_),
+                     _mm_shuffle_epi8(prefixed, shuffle));
+    batch.numValues_ += 2;
+    batch.numBytes_ += length0 + length1;
+  }
+  return batch;
+}
+
+__attribute__((target("avx2"))) inline QuicVarIntBatch
+encode_avx2(std::uint8_t *dst, std::span<const std::uint64_t> values,
+            QuicVarIntBatch batch) noexcept {
+  // varints are < 2^62 so signed comparisons are fine
+  const __m256i threshold0 = _mm256_set1_epi64x((1 << 6) - 1);
+  const __m256i threshold1 = _mm256_set1_epi64x((1 << 14) - 1);
+  const __m256i threshold2 = _mm256_set1_epi64x((1 << 30) - 1);
+  const __m256i eight = _mm256_set1_epi64x(8);
+  const __m256i two = _mm256_set1_epi64x(2);
+
+  while (values.size() - batch.numValues_ >= 4) {
+    __m256i value = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(values.data() + batch.numValues_));
+    // comparisons are -1 when true
+    __m256i codes = _mm256_sub_epi64(
+        _mm256_setzero_si256(),
+        _mm256_add_epi64(
+            _mm256_add_epi64(_mm256_cmpgt_epi64(value, threshold0),
+                             _mm256_cmpgt_epi64(value, threshold1)),
+            _mm256_cmpgt_epi64(value, threshold2)));
+    // prefix is shifted by 8 * length - 2 = (8 << code) - 2
+    __m256i shift = _mm256_sub_epi64(_mm256_sllv_epi64(eight, codes), two);
+    __m256i prefixed = _mm256_or_si256(value, _mm256_sllv_epi64(codes, shift));
+
+    alignas(32) std::array<std::uint64_t, 4> laneCodes;
+    _mm256_store_si256(reinterpret_cast<__m256i *>(laneCodes.data()), codes);
+    std::uint8_t pairLength0 = (1 << laneCodes[0]) + (1 << laneCodes[1]);
+    std::uint8_t pairLength1 = (1 << laneCodes[2]) + (1 << laneCodes[3]);
+
+    __m256i shuffle = load_2x128(
+        encodeShuffleTable[(laneCodes[0] << 2) | laneCodes[1]].data(),
+        encodeShuffleTable[(laneCodes[2] << 2) | laneCodes[3]].data());
+    __m256i encoded = _mm256_shuffle_epi8(prefixed, shuffle);
+
+    // second store overwrites the zero padding of the first
+    std::uint8_t *pairDst = dst + batch.numBytes_;
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pairDst),
+                     _mm256_castsi256_si128(encoded));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pairDst + pairLength0),
+                     _mm256_extracti128_si256(encoded, 1));
+    batch.numValues_ += 4;
+    batch.numBytes_ += pairLength0 + pairLength1;
+  }
+  return batch;
+}
+#endif
+
+} // namespace quic_var_int_batch
+
+// best codec supported by the cpu, checked once
+inline QuicVarIntCodec best_quic_var_int_codec() noexcept {
+#ifdef RAVEN_QUIC_VAR_INT_SIMD
+  static const QuicVarIntCodec codec = [] {
+    if (__builtin_cpu_supports("avx2"))
+      return QuicVarIntCodec::AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+      return QuicVarIntCodec::SSSE3;
+    return QuicVarIntCodec::SCALAR;
+  }();
+  return codec;
+#else
+  return QuicVarIntCodec::SCALAR;
+#endif
+}
+
+/*
+    Decodes consecutive varints from bytes into values
+    Stops when values is full or the next varint is not complete in bytes
+*/
+inline QuicVarIntBatch
+decode_quic_var_ints(std::span<const std::uint8_t> bytes,
+                     std::span<std::uint64_t> values,
+                     QuicVarIntCodec codec = best_quic_var_int_codec()) {
+  QuicVarIntBatch batch{0, 0};
+#ifdef RAVEN_QUIC_VAR_INT_SIMD
+  if (codec == QuicVarIntCodec::AVX2)
+    batch = quic_var_int_batch::decode_avx2(bytes, values, batch);
+  if (codec != QuicVarIntCodec::SCALAR)
+    batch = quic_var_int_batch::decode_ssse3(bytes, values, batch);
+#else
+  (void)codec;
+#endif
+  return quic_var_int_batch::decode_scalar(bytes, values, batch);
+}
+
+/*
+    Encodes values as consecutive varints, values should be < 2^62
+    dst should have room for max_encoded_size(values.size()) bytes (bytes after
+    the returned size may be overwritten)
+*/
+inline QuicVarIntBatch
+encode_quic_var_ints(std::uint8_t *dst, std::span<const std::uint64_t> values,
+                     QuicVarIntCodec codec = best_quic_var_int_codec()) {
+  QuicVarIntBatch batch{0, 0};
+#ifdef RAVEN_QUIC_VAR_INT_SIMD
+  if (codec == QuicVarIntCodec::AVX2)
+    batch = quic_var_int_batch::encode_avx2(dst, values, batch);
+  if (codec != QuicVarIntCodec::SCALAR)
+    batch = quic_var_int_batch::encode_ssse3(dst, values, batch);
+#else
+  (void)codec;
+#endif
+  return quic_var_int_batch::encode_scalar(dst, values, batch);
+}
+
+} // namespace rvn::serialization::detail
@@ -116,16 +116,27 @@ template <UnsignedInteger T>
 ///////////////////////////////////////////////////////////////////////////////////////////////
 // Parameter Serialization
 [[nodiscard]]  serialize_return_t mock_serialize(const rvn::DeliveryTimeoutParameter& parameter);
+[[nodiscard]]  serialize_return_t mock_serialize(const rvn::DeliveryModeParameter& parameter);
 [[nodiscard]]  serialize_return_t mock_serialize(const rvn::Parameter& parameter);
  serialize_return_t serialize(ds::chunk& c, const rvn::DeliveryTimeoutParameter& parameter);
+ serialize_return_t serialize(ds::chunk& c, const rvn::DeliveryModeParameter& parameter);
  serialize_return_t serialize(ds::chunk& c, const rvn::Parameter& parameter);
 ///////////////////////////////////////////////////////////////////////////////////////////////
 // Message serialization
  serialize_return_t serialize(ds::chunk& c, const rvn::ClientSetupMessage& clientSetupMessage);
  serialize_return_t serialize(ds::chunk& c, const rvn::ServerSetupMessage& serverSetupMessage);
+ serialize_return_t serialize(ds::chunk& c, const rvn::GoAwayMessage& goAwayMessage);
  serialize_return_t serialize(ds::chunk& c, const rvn::SubscribeMessage& subscribeMessage);
+ serialize_return_t serialize(ds::chunk& c, const rvn::FetchMessage& fetchMessage);
  serialize_return_t serialize(ds::chunk& c, const StreamHeaderSubgroupMessage& msg);
  serialize_return_t serialize(ds::chunk& c, const StreamHeaderSubgroupObject& msg);
+ serialize_return_t serialize(ds::chunk& c, const StreamHeaderTrackMessage& msg);
+ serialize_return_t serialize(ds::chunk& c, const TrackStreamObjectMessage& msg);
+ serialize_return_t serialize(ds::chunk& c, const FetchHeaderMessage& msg);
+ serialize_return_t serialize(ds::chunk& c, const FetchObjectMessage& msg);
+ serialize_return_t serialize(ds::chunk& c, const ObjectDatagramMessage& msg);
+// OBJECT_DATAGRAM without payload length and payload
+ serialize_return_t serialize_header(ds::chunk& c, const ObjectDatagramMessage& msg);
  serialize_return_t serialize(ds::chunk& c, const rvn::SubscribeErrorMessage& subscribeErrorMessage);
  serialize_return_t serialize(ds::chunk& c, const rvn::BatchSubscribeMessage& batchSubscribeMessage);
 ///////////////////////////////////////////////////////////////////////////////////////////////
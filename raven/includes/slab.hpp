@@ -0,0 +1,80 @@
+#pragma once
+/////////////////////////////////////////////
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+/*
+    Allocates objects of type T in fixed size slabs
+    Addresses are stable for the lifetime of the object (like StableContainer)
+    but objects are packed together instead of being a node each
+    Freed slots are reused in LIFO order, so recently touched (cache hot) slots
+    are handed out first
+*/
+template <typename T, std::size_t SlabSize = 1024> class Slab {
+  struct Slot {
+    alignas(T) std::byte storage_[sizeof(T)];
+    bool live_ = false;
+
+    T *get() noexcept { return std::launder(reinterpret_cast<T *>(storage_)); }
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  std::vector<Slot *> freeSlots_;
+  std::size_t size_ = 0;
+
+  void add_slab() {
+    slabs_.emplace_back(std::make_unique<Slot[]>(SlabSize));
+    Slot *slab = slabs_.back().get();
+    // reverse so that slots are handed out in address order
+    for (std::size_t i = SlabSize; i > 0; --i)
+      freeSlots_.push_back(slab + i - 1);
+  }
+
+public:
+  Slab() = default;
+  Slab(const Slab &) = delete;
+  Slab &operator=(const Slab &) = delete;
+  // slots are owned by the slabs (which do not move), so moving is fine
+  Slab(Slab &&) = default;
+
+  template <typename... Args> T *emplace(Args &&...args) {
+    if (freeSlots_.empty())
+      add_slab();
+
+    Slot *slot = freeSlots_.back();
+    ::new (static_cast<void *>(slot->storage_)) T(std::forward<Args>(args)...);
+    // only pop once construction succeeded
+    freeSlots_.pop_back();
+    slot->live_ = true;
+    ++size_;
+
+    return slot->get();
+  }
+
+  // t should have been returned by emplace of this slab
+  void erase(T *t) {
+    // storage_ is the first member of Slot
+    Slot *slot = reinterpret_cast<Slot *>(t);
+    t->~T();
+    slot->live_ = false;
+    freeSlots_.push_back(slot);
+    --size_;
+  }
+
+  std::size_t size() const noexcept { return size_; }
+
+  ~Slab() {
+    for (auto &slab : slabs_)
+      for (std::size_t i = 0; i < SlabSize; ++i)
+        if (slab[i].live_)
+          slab[i].get()->~T();
+  }
+};
+
+} // namespace rvn
@@ -0,0 +1,96 @@
+#pragma once
+/////////////////////////////////////////////
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <utility>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+/*
+    Unbounded lock free queue with a single producer and a single consumer
+    Items are stored in a linked list of blocks of blockSize slots, the
+    producer publishes a slot by moving the tail of its block and links a new
+    block once the block is full, the consumer deletes a block once it has
+    read all of it and the next block has been linked (the producer never
+    touches a block again after linking the next one)
+    push never blocks, so the producer (a MsQuic worker) is never held up by a
+    slow consumer
+*/
+template <typename T, std::size_t blockSize = 256> class SPSCQueue {
+  static constexpr std::size_t cacheLineSize = 64;
+
+  struct Block {
+    alignas(T) std::byte storage_[blockSize * sizeof(T)];
+    // written by the producer, slots before it are constructed
+    alignas(cacheLineSize) std::atomic<std::size_t> tail_ = 0;
+    std::atomic<Block *> next_ = nullptr;
+    // only touched by the consumer
+    alignas(cacheLineSize) std::size_t head_ = 0;
+
+    T *slot(std::size_t index) noexcept {
+      return std::launder(reinterpret_cast<T *>(storage_)) + index;
+    }
+  };
+
+  // consumer
+  alignas(cacheLineSize) Block *headBlock_;
+  // producer
+  alignas(cacheLineSize) Block *tailBlock_;
+
+public:
+  SPSCQueue() : headBlock_(new Block), tailBlock_(headBlock_) {}
+
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  ~SPSCQueue() {
+    while (headBlock_ != nullptr) {
+      Block *block = headBlock_;
+      std::size_t tail = block->tail_.load(std::memory_order_acquire);
+      for (std::size_t index = block->head_; index < tail; ++index)
+        block->slot(index)->~T();
+      headBlock_ = block->next_.load(std::memory_order_acquire);
+      delete block;
+    }
+  }
+
+  // producer
+  void push(T value) {
+    Block *block = tailBlock_;
+    std::size_t tail = block->tail_.load(std::memory_order_relaxed);
+    if (tail == blockSize) {
+      Block *next = new Block;
+      block->next_.store(next, std::memory_order_release);
+      tailBlock_ = block = next;
+      tail = 0;
+    }
+
+    new (block->slot(tail)) T(std::move(value));
+    block->tail_.store(tail + 1, std::memory_order_release);
+  }
+
+  // consumer
+  std::optional<T> try_pop() {
+    Block *block = headBlock_;
+    if (block->head_ == blockSize) {
+      Block *next = block->next_.load(std::memory_order_acquire);
+      if (next == nullptr)
+        return std::nullopt;
+      delete block;
+      headBlock_ = block = next;
+    }
+
+    if (block->head_ == block->tail_.load(std::memory_order_acquire))
+      return std::nullopt;
+
+    T *slot = block->slot(block->head_++);
+    std::optional<T> value(std::move(*slot));
+    slot->~T();
+    return value;
+  }
+};
+
+} // namespace rvn
@@ -44,6 +44,7 @@ class SubscriptionBuilder {
   void set_defaults() {
     subscribeMessage_.subscribeId_ =
         subscribeIDCounter_.fetch_add(1, std::memory_order_relaxed);
+    subscribeMessage_.parameters_.clear();
     setElementsCounter_ = 0;
   }
 
@@ -145,6 +146,17 @@ public:
     return *this;
   }
 
+  // optional, objects are sent on subgroup streams by default
+  SubscriptionBuilder &set_delivery_mode(DeliveryMode deliveryMode) {
+    // only one parameter of each type should be sent
+    std::erase_if(subscribeMessage_.parameters_, [](const Parameter &param) {
+      return std::holds_alternative<DeliveryModeParameter>(param.parameter_);
+    });
+    subscribeMessage_.parameters_.push_back(
+        Parameter{DeliveryModeParameter{deliveryMode}});
+    return *this;
+  }
+
   SubscribeMessage build() {
     utils::ASSERT_LOG_THROW(setElementsCounter_ == all_elements_set(),
                             "Not all elements set in subscribe message",
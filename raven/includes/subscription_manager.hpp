@@ -6,73 +6,138 @@
 #include <optional>
 #include <serialization/messages.hpp>
 #include <serialization/serialization.hpp>
+#include <slab.hpp>
 #include <strong_types.hpp>
+#include <subscription_task.hpp>
 #include <utilities.hpp>
 
 namespace rvn {
 
 struct ConnectionState;
 
-struct SubscriptionStateErr {
-  // clang-format off
-    struct ConnectionExpired{};
-    struct ObjectDoesNotExist{};
-  // clang-format on
+// Per iteration budget of a minor subscription
+// Ready objects are drained till either limit is hit and are submitted as a
+// single multi buffer StreamSend, this amortizes the per object overhead
+// (locks, weak_ptr locks, variants) for tracks with small objects
+struct SendBudget {
+  // the first object is always sent even if it is larger than maxBytes_
+  std::size_t maxBytes_ = 64 * 1024;
+  std::size_t maxObjects_ = 16;
 };
 
-// bool is true => subscription fulfilled
-// bool is false => continue to next object
-using FulfillSomeReturn =
-    std::variant<bool, SubscriptionStateErr::ConnectionExpired,
-                 SubscriptionStateErr::ObjectDoesNotExist>;
-
-// Each stream corresponds to one minor subscription state
-class MinorSubscriptionState {
-  friend class SubscriptionState;
-  class SubscriptionState *subscriptionState_;
-  std::optional<ObjectIdentifier> previouslySentObject_;
-  ObjectIdentifier objectToSend_;
-  std::optional<ObjectIdentifier> lastObjectToBeSent_;
-
-  bool mustBeSent_;
-  std::optional<ObjectWaitSignal> objectWaitSignal_;
-
-  std::optional<std::chrono::milliseconds> subscribeDeliveryTimeout;
+class SubscriptionState;
+
+/*
+    All minor subscriptions handled by a subscription thread
+    Each row corresponds to one stream (minor subscription) and is fulfilled by
+    a coroutine (SubscriptionState::fulfill_minor_subscription), the state of
+    the minor subscription (cursor, last sent object...) lives in its frame
+
+    Laid out as structure of arrays. The subscription thread scans every row on
+    every iteration, but most rows are waiting on an object to be published, so
+    the scan only reads waitFlags_, a dense array of pointers. The coroutine
+    frames (tasks_), which hold the cursor, last sent object and delivery
+    timeout of the row, are only touched for rows which are ready
+*/
+class MinorSubscriptionTable {
+  // hot ///////////////////////////////////////////////////////////////////
+  // flag the coroutine is suspended on, nullptr => resume on next pass
+  std::vector<std::atomic<ObjectWaitStatus> *> waitFlags_;
+  std::vector<SubscriptionTask> tasks_;
+
+  // cold //////////////////////////////////////////////////////////////////
+  std::vector<SubscriptionState *> subscriptionStates_;
 
 public:
-  MinorSubscriptionState(
-      SubscriptionState &subscriptionState, ObjectIdentifier objectToSend,
-      std::optional<ObjectIdentifier> lastObjectToBeSent, bool mustBeSent,
-      std::optional<std::chrono::milliseconds> deliveryTimeout);
-
-  // returs true if minor subscription state has been fulfilled
-  FulfillSomeReturn fulfill_some_minor();
+  std::size_t size() const noexcept { return waitFlags_.size(); }
+
+  void add_row(SubscriptionState &subscriptionState, SubscriptionTask task);
+
+  // last row is moved in place of the removed row, order of rows is not
+  // preserved
+  void remove_row(std::size_t row);
+  void remove_rows(const SubscriptionState &subscriptionState);
+
+  // not waiting on anything or waiting on a flag and it is ready
+  // basically the mathematical logical statement: (waiting -> ready)
+  // inlined (for better performance) as it is called in tight loop
+  bool is_ready(std::size_t row) const noexcept {
+    std::atomic<ObjectWaitStatus> *waitFlag = waitFlags_[row];
+    // we wait on the flag, only is flag is ready, we do acquire operation
+    // (when the coroutine resumes) might have performance benefits on weaker
+    // memory models (ARM, POWERPC...)
+    return waitFlag == nullptr ||
+           waitFlag->load(std::memory_order_relaxed) == ObjectWaitStatus::Ready;
+  }
 
-  // need this function to be inlined (for better performance) as it is called
-  // in tight loop
-  inline bool is_waiting_for_object();
+  SubscriptionState &get_subscription_state(std::size_t row) const noexcept {
+    return *subscriptionStates_[row];
+  }
 
-  // TODO: cleanup in destructor, notify client that minor subscription has
-  // ended WARNING: adding destructor will disable implicitly generated move
-  // operations
+  // resumes the coroutine of the row till it suspends again
+  // returns the result if the coroutine has finished
+  std::optional<FulfillSomeReturn> resume(std::size_t row);
 };
 
-// Each subscription state corresponds to one subscription message
+// Each subscription state corresponds to one subscription message (or one
+// FETCH, which is fulfilled by a single row)
 class SubscriptionState {
-  friend MinorSubscriptionState;
+  friend class MinorSubscriptionTable;
+  friend struct ThreadLocalState;
   // NOTE: should be protected by checking if it actually exists
   std::weak_ptr<ConnectionState> connectionStateWeakPtr_;
-  // can not be reference because we need Subscription State to be assignable
-  // (while removing it from vector)
   DataManager *dataManager_;
   class SubscriptionManager *subscriptionManager_;
-  SubscribeMessage subscriptionMessage_;
 
-  std::vector<MinorSubscriptionState> minorSubscriptionStates_;
+  // rows of the table which belong to this subscription
+  MinorSubscriptionTable *minorSubscriptionTable_;
+  std::size_t numMinorSubscriptions_;
+  // connections this thread has queued delayed sends on in the current pass
+  std::vector<std::weak_ptr<ConnectionState>> *connectionsToFlush_;
+
+  // Only present for open ended (AbsoluteStart) subscriptions, used to pick up
+  // groups which are created after the subscription
+  struct GroupDiscoveryState {
+    std::weak_ptr<TrackHandle> trackHandle_;
+    GroupSequenceCounter groupSequence_;
+    std::uint64_t lastSeenGroupSequence_;
+    GroupId lastDiscoveredGroupId_;
+    // groups which had no objects registered when they were discovered, the
+    // start group keeps the start object and delivery timeout of the
+    // subscription for when it is retried
+    struct EmptyGroup {
+      GroupId groupId_;
+      std::optional<ObjectId> beginObjectId_;
+      std::optional<std::chrono::milliseconds> deliveryTimeout_;
+    };
+    std::vector<EmptyGroup> emptyGroups_;
+  };
+  std::optional<GroupDiscoveryState> groupDiscoveryState_;
+
+  // only needed while resolving the subscription
+  SubscribeMessage subscriptionMessage_;
+  // from the DeliveryModeParameter of the subscription
+  DeliveryMode deliveryMode_;
 
   void error_handler(SubscriptionStateErr::ConnectionExpired);
   void error_handler(SubscriptionStateErr::ObjectDoesNotExist);
 
+  SubscriptionTask fulfill_minor_subscription(
+      ObjectIdentifier objectToSend,
+      std::optional<ObjectIdentifier> lastObjectToBeSent, bool mustBeSent,
+      std::optional<std::chrono::milliseconds> subscribeDeliveryTimeout);
+
+  /*
+      Sends the objects of a FETCH from objectToSend (which ends its group at
+      groupEnd, exclusive) to end, in (group, object) order on one stream,
+      reading them straight out of the DataManager (group cache or disk)
+      There is no delivery timeout and nothing is dropped, the stream is
+      ended after the last object
+  */
+  SubscriptionTask fulfill_fetch(std::uint64_t subscribeId,
+                                 ObjectIdentifier objectToSend,
+                                 ObjectId groupEnd, GroupObjectPair end);
+
   FulfillSomeReturn add_group_subscription(
       const GroupHandle &groupHandle, bool mustBeSent,
       std::optional<std::chrono::milliseconds> deliveryTimeout = {},
@@ -84,9 +149,24 @@ public:
   SubscriptionState(std::weak_ptr<ConnectionState> &&connectionState,
                     DataManager &dataManager,
                     SubscriptionManager &subscriptionManager,
+                    MinorSubscriptionTable &minorSubscriptionTable,
+                    std::vector<std::weak_ptr<ConnectionState>> &
+                        connectionsToFlush,
                     SubscribeMessage subscriptionMessage);
+  SubscriptionState(std::weak_ptr<ConnectionState> &&connectionState,
+                    DataManager &dataManager,
+                    SubscriptionManager &subscriptionManager,
+                    MinorSubscriptionTable &minorSubscriptionTable,
+                    std::vector<std::weak_ptr<ConnectionState>> &
+                        connectionsToFlush,
+                    FetchMessage fetchMessage);
+
+  bool is_open_ended() const noexcept {
+    return groupDiscoveryState_.has_value();
+  }
 
-  FulfillSomeReturn fulfill_some();
+  // adds minor subscriptions for groups added since the last call
+  void discover_new_groups();
 
   std::weak_ptr<ConnectionState> &get_connection_state_weak_ptr() noexcept {
     return connectionStateWeakPtr_;
@@ -96,18 +176,37 @@ public:
   get_connection_state_weak_ptr() const noexcept {
     return connectionStateWeakPtr_;
   }
-
-  // TODO: removing this destructor causes groups not to advance or abort, need
-  // to investigate
-  ~SubscriptionState() = default;
 };
 
 struct ThreadLocalState {
   SubscriptionManager &subscriptionManager_;
-  // subscription state which this thread is handling
-  // has to be stable container because we have pointers back to subscription
-  // state
-  StableContainer<SubscriptionState> subscriptionStates_;
+  // subscription states which this thread is handling
+  // rows of the table point back to subscription states, so they need stable
+  // addresses
+  Slab<SubscriptionState> subscriptionStates_;
+  MinorSubscriptionTable minorSubscriptionTable_;
+  // subscriptions which need to look for new groups
+  std::vector<SubscriptionState *> openEndedSubscriptions_;
+  /*
+      Objects are sent with QUIC_SEND_FLAG_DELAY_SEND during a pass and every
+      connection is flushed once at the end of it, so objects of different
+      subscriptions on a connection share packets and msquic is not asked to
+      flush after every object
+  */
+  std::vector<std::weak_ptr<ConnectionState>> connectionsToFlush_;
+  void flush_connections();
+
+  ThreadLocalState(SubscriptionManager &subscriptionManager)
+      : subscriptionManager_(subscriptionManager) {}
+
+  void add_subscription(std::weak_ptr<ConnectionState> &&connectionStateWeakPtr,
+                        SubscribeMessage &&subscriptionMessage);
+  void add_fetch(std::weak_ptr<ConnectionState> &&connectionStateWeakPtr,
+                 FetchMessage &&fetchMessage);
+  void remove_subscription(SubscriptionState &subscriptionState);
+
+  // one pass over all the subscriptions handled by this thread
+  void fulfill_some();
 
   void operator()();
 };
@@ -120,20 +219,37 @@ class SubscriptionManager {
   // holds subscriptions messages which need to be processed and start executing
   MPMCQueue<std::tuple<std::weak_ptr<ConnectionState>, SubscribeMessage>>
       subscriptionQueue_;
+  MPMCQueue<std::tuple<std::weak_ptr<ConnectionState>, FetchMessage>>
+      fetchQueue_;
+
+  const SendBudget sendBudget_;
 
+  // objects which are not in the group cache are read on this thread, so
+  // subscription threads never block on disk
+  DiskReadQueue diskReadQueue_;
+  std::jthread diskReadThread_;
+
+  // declared last so that subscription threads are joined before anything
+  // they use is destroyed
   std::vector<ThreadLocalState> threadLocalStates_;
   // thread pool to manage subscriptions
   std::vector<std::jthread> threadPool_;
 
 public:
-  SubscriptionManager(DataManager &dataManager, std::size_t numThreads = 1);
+  SubscriptionManager(DataManager &dataManager, std::size_t numThreads = 1,
+                      SendBudget sendBudget = {});
   void add_subscription(std::weak_ptr<ConnectionState> connectionStateWeakPtr,
                         SubscribeMessage subscribeMessage);
+  void add_fetch(std::weak_ptr<ConnectionState> connectionStateWeakPtr,
+                 FetchMessage fetchMessage);
 
   // Error Handling functions
   void mark_subscription_cleanup(SubscriptionState &subscriptionState);
   void notify_subscription_error(SubscriptionState &subscriptionState);
 
+  const SendBudget &get_send_budget() const noexcept { return sendBudget_; }
+  DiskReadQueue &get_disk_read_queue() noexcept { return diskReadQueue_; }
+
   ~SubscriptionManager();
 };
 } // namespace rvn
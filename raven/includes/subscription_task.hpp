@@ -0,0 +1,240 @@
+#pragma once
+/////////////////////////////////////////////
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <utility>
+#include <variant>
+#include <vector>
+/////////////////////////////////////////////
+#include <data_manager.hpp>
+#include <definitions.hpp>
+/////////////////////////////////////////////
+
+namespace rvn {
+
+struct SubscriptionStateErr {
+  // clang-format off
+    struct ConnectionExpired{};
+    struct ObjectDoesNotExist{};
+  // clang-format on
+};
+
+// bool is true => subscription fulfilled
+// bool is false => continue to next object
+using FulfillSomeReturn =
+    std::variant<bool, SubscriptionStateErr::ConnectionExpired,
+                 SubscriptionStateErr::ObjectDoesNotExist>;
+
+/*
+    Thread local pool of coroutine frames
+    All minor subscription coroutines have the same frame size, so after warm
+    up frames are recycled from the free list and starting a minor subscription
+    does not hit the allocator
+    Frames freed on a different thread end up in that threads pool
+*/
+class FramePool {
+  static constexpr std::size_t granularity = 64;
+  // frames bigger than this are not pooled
+  static constexpr std::size_t numSizeClasses = 64;
+
+  std::array<std::vector<void *>, numSizeClasses> freeFrames_;
+
+  static std::size_t size_class(std::size_t size) noexcept {
+    return (size + granularity - 1) / granularity;
+  }
+
+public:
+  static FramePool &get() {
+    static thread_local FramePool framePool;
+    return framePool;
+  }
+
+  void *allocate(std::size_t size) {
+    std::size_t sizeClass = size_class(size);
+    if (sizeClass >= numSizeClasses)
+      return ::operator new(size);
+
+    auto &freeFrames = freeFrames_[sizeClass];
+    if (freeFrames.empty())
+      return ::operator new(sizeClass * granularity);
+
+    void *frame = freeFrames.back();
+    freeFrames.pop_back();
+    return frame;
+  }
+
+  void deallocate(void *frame, std::size_t size) {
+    std::size_t sizeClass = size_class(size);
+    if (sizeClass >= numSizeClasses)
+      return ::operator delete(frame);
+
+    freeFrames_[sizeClass].push_back(frame);
+  }
+
+  ~FramePool() {
+    for (auto &freeFrames : freeFrames_)
+      for (void *frame : freeFrames)
+        ::operator delete(frame);
+  }
+};
+
+/*
+    Coroutine fulfilling one minor subscription
+    It is resumed by the subscription thread (ThreadLocalState) which polls the
+    flag the coroutine is suspended on, awaitables just record the flag in the
+    promise
+    Starts suspended, so the subscription thread decides when it first runs
+*/
+class SubscriptionTask {
+public:
+  struct promise_type {
+    // flag the coroutine is waiting on, nullptr => resume on next pass
+    std::atomic<ObjectWaitStatus> *waitFlag_ = nullptr;
+    FulfillSomeReturn result_ = false;
+
+    SubscriptionTask get_return_object() noexcept {
+      return SubscriptionTask(Handle::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_value(FulfillSomeReturn result) noexcept {
+      result_ = std::move(result);
+    }
+    void unhandled_exception() { throw; }
+
+    static void *operator new(std::size_t size) {
+      return FramePool::get().allocate(size);
+    }
+    static void operator delete(void *frame, std::size_t size) {
+      FramePool::get().deallocate(frame, size);
+    }
+  };
+  using Handle = std::coroutine_handle<promise_type>;
+
+private:
+  Handle handle_;
+
+  explicit SubscriptionTask(Handle handle) noexcept : handle_(handle) {}
+
+public:
+  SubscriptionTask(SubscriptionTask &&other) noexcept
+      : handle_(std::exchange(other.handle_, {})) {}
+  SubscriptionTask &operator=(SubscriptionTask &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  SubscriptionTask(const SubscriptionTask &) = delete;
+  SubscriptionTask &operator=(const SubscriptionTask &) = delete;
+
+  ~SubscriptionTask() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  Handle handle() const noexcept { return handle_; }
+};
+
+// suspends till the flag is ready
+class WaitFlagAwaitable {
+  std::atomic<ObjectWaitStatus> *waitFlag_;
+
+public:
+  explicit WaitFlagAwaitable(std::atomic<ObjectWaitStatus> *waitFlag) noexcept
+      : waitFlag_(waitFlag) {}
+
+  bool await_ready() const noexcept {
+    return waitFlag_->load(std::memory_order_acquire) ==
+           ObjectWaitStatus::Ready;
+  }
+  void await_suspend(SubscriptionTask::Handle handle) const noexcept {
+    handle.promise().waitFlag_ = waitFlag_;
+  }
+  // subscription thread only does a relaxed load while polling
+  void await_resume() const noexcept {
+    waitFlag_->load(std::memory_order_acquire);
+  }
+};
+
+// object has been published
+class ObjectReady : public WaitFlagAwaitable {
+  // keeps the flag alive while we are suspended
+  ObjectWaitSignal objectWaitSignal_;
+
+public:
+  explicit ObjectReady(ObjectWaitSignal objectWaitSignal) noexcept
+      : WaitFlagAwaitable(objectWaitSignal.get()),
+        objectWaitSignal_(std::move(objectWaitSignal)) {}
+};
+
+// connection can take more data, see ConnectionState::get_send_window_signal
+class SendWindow : public WaitFlagAwaitable {
+  ObjectWaitSignal sendWindowSignal_;
+
+public:
+  explicit SendWindow(ObjectWaitSignal sendWindowSignal) noexcept
+      : WaitFlagAwaitable(sendWindowSignal.get()),
+        sendWindowSignal_(std::move(sendWindowSignal)) {}
+};
+
+// give other minor subscriptions a turn, resumed on the next pass
+struct Yield {
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(SubscriptionTask::Handle handle) const noexcept {
+    handle.promise().waitFlag_ = nullptr;
+  }
+  void await_resume() const noexcept {}
+};
+
+// Object which is not in the group cache, read on the disk read thread
+struct DiskReadRequest {
+  DataManager &dataManager_;
+  ObjectIdentifier objectIdentifier_;
+  ObjectOrStatus result_;
+  std::atomic<ObjectWaitStatus> done_{ObjectWaitStatus::Wait};
+
+  DiskReadRequest(DataManager &dataManager, ObjectIdentifier objectIdentifier)
+      : dataManager_(dataManager),
+        objectIdentifier_(std::move(objectIdentifier)) {}
+
+  void operator()() {
+    result_ = dataManager_.get_object(objectIdentifier_);
+    done_.store(ObjectWaitStatus::Ready, std::memory_order_release);
+  }
+};
+
+using DiskReadQueue = MPMCQueue<std::shared_ptr<DiskReadRequest>>;
+
+class DiskRead {
+  DiskReadQueue &diskReadQueue_;
+  // shared with the disk read thread, the coroutine might be destroyed while
+  // the read is in flight
+  std::shared_ptr<DiskReadRequest> diskReadRequest_;
+
+public:
+  DiskRead(DiskReadQueue &diskReadQueue, DataManager &dataManager,
+           const ObjectIdentifier &objectIdentifier)
+      : diskReadQueue_(diskReadQueue),
+        diskReadRequest_(
+            std::make_shared<DiskReadRequest>(dataManager, objectIdentifier)) {}
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(SubscriptionTask::Handle handle) {
+    handle.promise().waitFlag_ = &diskReadRequest_->done_;
+    diskReadQueue_.enqueue(diskReadRequest_);
+  }
+  ObjectOrStatus await_resume() {
+    diskReadRequest_->done_.load(std::memory_order_acquire);
+    return std::move(diskReadRequest_->result_);
+  }
+};
+
+} // namespace rvn
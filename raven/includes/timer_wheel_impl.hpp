@@ -44,14 +44,19 @@ class Timer {
 
   //////////////////////////////////////////////////////////////////////////
 
+  // callbacks are run without holding the lock of the slot, so that they can
+  // add timers themselves
+  void fire_slot(RWProtected<std::vector<TimerEvent>> &slot) {
+    std::vector<TimerEvent> timerEvents;
+    slot.write([&](std::vector<TimerEvent> &slot) { timerEvents.swap(slot); });
+
+    for (auto &timerEvent : timerEvents)
+      timerEvent.callback_(timerEvent.index_);
+  }
+
   void clear_all() {
-    for (auto &slot : timers_) {
-      slot.write([](auto &slot) {
-        for (auto &timerEvent : slot)
-          timerEvent.callback_(timerEvent.index_);
-        slot.clear();
-      });
-    }
+    for (auto &slot : timers_)
+      fire_slot(slot);
   }
 
   void poll() {
@@ -69,14 +74,7 @@ class Timer {
       std::uint64_t endIndex = (currMsTime.count() / Jitter) % NumSlots;
 
       while (beginIndex != endIndex) {
-        timers_[beginIndex].write([&](std::vector<TimerEvent> &slot) {
-          for (auto &timerEvent : slot) {
-            timerEvent.callback_(timerEvent.index_);
-          }
-
-          slot.clear();
-        });
-
+        fire_slot(timers_[beginIndex]);
         beginIndex = (beginIndex + 1) % NumSlots;
       }
     }
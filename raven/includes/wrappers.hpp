@@ -2,9 +2,14 @@
 ////////////////////////////////////////////
 #include <msquic.h>
 ////////////////////////////////////////////
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <new>
 #include <stdexcept>
 ////////////////////////////////////////////
+#include <object_pool.hpp>
 #include <utilities.hpp>
 ////////////////////////////////////////////
 namespace rvn::detail {
@@ -421,26 +426,102 @@ public:
 };
 
 class QUIC_BUFFERDeleter {
-  // Check chunk_transfer.cpp to understand why this is unused
-  // Ideally we would be calling receive complete, but we are making a copy of
-  // QUIC_BUFFER provided by MsQuic, because of lifetime management issues of
-  // the MsQuic buffer when multireceive is enabled
-  [[maybe_unused]] HQUIC streamHandle_;
-  [[maybe_unused]] QUIC_STREAM_RECEIVE_COMPLETE_FN
-      streamReceiveCompletefunction_;
+  // Check chunk_transfer.cpp to understand why buffers are copied by default
+  // In zero copy receive the buffer references MsQuic's receive memory, the
+  // bytes are handed back with StreamReceiveComplete when it is released
+  HQUIC streamHandle_;
+  QUIC_STREAM_RECEIVE_COMPLETE_FN streamReceiveCompletefunction_;
+  bool borrowed_ = false;
+  // set once the buffer is shared with payload views (see PayloadView), it is
+  // released with the last reference
+  std::shared_ptr<const QUIC_BUFFER> sharedBuffer_;
 
 public:
   void operator()(const QUIC_BUFFER *buffer) {
-    free(const_cast<QUIC_BUFFER *>(buffer));
+    if (sharedBuffer_) {
+      sharedBuffer_.reset();
+      return;
+    }
+
+    if (!borrowed_) {
+      free(const_cast<QUIC_BUFFER *>(buffer));
+      return;
+    }
+
+    // stream is detached once it has been shut down
+    if (streamHandle_ != NULL)
+      streamReceiveCompletefunction_(streamHandle_, buffer->Length);
+    ObjectPool<QUIC_BUFFER>::deallocate(const_cast<QUIC_BUFFER *>(buffer));
   }
 
   QUIC_BUFFERDeleter(
       HQUIC streamHandle,
-      QUIC_STREAM_RECEIVE_COMPLETE_FN streamReceiveCompletefunction)
+      QUIC_STREAM_RECEIVE_COMPLETE_FN streamReceiveCompletefunction,
+      bool borrowed = false)
       : streamHandle_(streamHandle),
-        streamReceiveCompletefunction_(streamReceiveCompletefunction) {}
+        streamReceiveCompletefunction_(streamReceiveCompletefunction),
+        borrowed_(borrowed) {}
+
+  explicit QUIC_BUFFERDeleter(std::shared_ptr<const QUIC_BUFFER> sharedBuffer)
+      : streamHandle_(NULL), streamReceiveCompletefunction_(nullptr),
+        sharedBuffer_(std::move(sharedBuffer)) {}
+
+  bool borrowed() const noexcept { return borrowed_; }
+  const std::shared_ptr<const QUIC_BUFFER> &shared_buffer() const noexcept {
+    return sharedBuffer_;
+  }
+
+  // after QUIC_STREAM_EVENT_SHUTDOWN_COMPLETE MsQuic has released the receive
+  // buffers itself and the handle might be closed
+  void detach_stream() noexcept { streamHandle_ = NULL; }
 };
 
 using UniqueQuicBuffer = std::unique_ptr<const QUIC_BUFFER, QUIC_BUFFERDeleter>;
 
+// buffer of length bytes owned by us, data follows the QUIC_BUFFER
+inline UniqueQuicBuffer make_owned_quic_buffer(std::uint32_t length) {
+  QUIC_BUFFER *buffer = (QUIC_BUFFER *)malloc(sizeof(QUIC_BUFFER) + length);
+  buffer->Length = length;
+  buffer->Buffer = (uint8_t *)buffer + sizeof(QUIC_BUFFER);
+  return UniqueQuicBuffer(buffer, QUIC_BUFFERDeleter(NULL, nullptr));
+}
+
+// copy of a received buffer, MsQuic's buffer can be completed right away
+inline UniqueQuicBuffer
+copy_received_buffer(const QUIC_BUFFER &buffer, HQUIC streamHandle,
+                     QUIC_STREAM_RECEIVE_COMPLETE_FN receiveComplete) {
+  QUIC_BUFFER *newBuffer =
+      (QUIC_BUFFER *)malloc(sizeof(QUIC_BUFFER) + buffer.Length);
+  newBuffer->Length = buffer.Length;
+  newBuffer->Buffer = (uint8_t *)newBuffer + sizeof(QUIC_BUFFER);
+  std::memcpy(newBuffer->Buffer, buffer.Buffer, buffer.Length);
+  return UniqueQuicBuffer(newBuffer,
+                          QUIC_BUFFERDeleter(streamHandle, receiveComplete));
+}
+
+// buffer keeps its place (in the deserializer) and is kept alive till the
+// returned reference is released as well, borrowed buffers should not be
+// shared, they would hold on to the receive window of MsQuic
+inline std::shared_ptr<const QUIC_BUFFER>
+share_quic_buffer(UniqueQuicBuffer &buffer) {
+  if (!buffer.get_deleter().shared_buffer()) {
+    const QUIC_BUFFER *rawBuffer = buffer.get();
+    std::shared_ptr<const QUIC_BUFFER> sharedBuffer(std::move(buffer));
+    buffer = UniqueQuicBuffer(rawBuffer,
+                              QUIC_BUFFERDeleter(std::move(sharedBuffer)));
+  }
+  return buffer.get_deleter().shared_buffer();
+}
+
+// references MsQuic's receive memory, only the QUIC_BUFFER is allocated, the
+// receive event has to return QUIC_STATUS_PENDING
+inline UniqueQuicBuffer
+borrow_received_buffer(const QUIC_BUFFER &buffer, HQUIC streamHandle,
+                       QUIC_STREAM_RECEIVE_COMPLETE_FN receiveComplete) {
+  QUIC_BUFFER *newBuffer =
+      new (ObjectPool<QUIC_BUFFER>::allocate()) QUIC_BUFFER(buffer);
+  return UniqueQuicBuffer(
+      newBuffer, QUIC_BUFFERDeleter(streamHandle, receiveComplete, true));
+}
+
 }; // namespace rvn
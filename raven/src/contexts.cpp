@@ -14,9 +14,11 @@
 #include <variant>
 #include <wrappers.hpp>
 ////////////////////////////////
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <stdexcept>
+#include <utility>
 ////////////////////////////////
 
 namespace rvn {
@@ -27,46 +29,228 @@ DataStreamState::DataStreamState(rvn::unique_stream &&stream,
       lifeTimeFlag_(std::make_shared<std::monostate>()),
       objectQueue_(std::make_shared<MPMCQueue<StreamHeaderSubgroupObject>>()) {}
 
-bool DataStreamState::can_send_object(
-    const ObjectIdentifier &objectIdentifier) const noexcept {
-  auto trackAliasOpt = connectionState_.identifier_to_alias(objectIdentifier);
-  if (!trackAliasOpt.has_value())
+void DataStreamState::set_header(
+    StreamHeaderSubgroupMessage streamHeaderSubgroupMessage) {
+  streamHeaderSubgroupMessage_ = std::make_shared<StreamHeaderSubgroupMessage>(
+      std::move(streamHeaderSubgroupMessage));
+}
+
+void DataStreamState::set_header(
+    StreamHeaderTrackMessage streamHeaderTrackMessage) {
+  streamHeaderTrackMessage_ = std::make_shared<StreamHeaderTrackMessage>(
+      std::move(streamHeaderTrackMessage));
+}
+
+void DataStreamState::set_header(FetchHeaderMessage fetchHeaderMessage) {
+  fetchHeaderMessage_ =
+      std::make_shared<FetchHeaderMessage>(std::move(fetchHeaderMessage));
+}
+
+std::weak_ptr<void> DataStreamState::get_life_time_flag() const noexcept {
+  return lifeTimeFlag_;
+}
+
+DataStreamState &
+DataStreams::emplace_back(rvn::unique_stream &&stream,
+                          ConnectionState &connectionState) {
+  DataStreamState &streamState =
+      streams_.emplace_back(std::move(stream), connectionState);
+  handleIndex_.emplace(streamState.stream.get(), std::prev(streams_.end()));
+  return streamState;
+}
+
+void DataStreams::set_header(
+    DataStreamState &streamState,
+    StreamHeaderSubgroupMessage streamHeaderSubgroupMessage) {
+  DataStreamKey key{streamHeaderSubgroupMessage.trackAlias_,
+                    streamHeaderSubgroupMessage.groupId_,
+                    streamHeaderSubgroupMessage.subgroupId_};
+  streamState.set_header(std::move(streamHeaderSubgroupMessage));
+  subgroupIndex_.insert_or_assign(key, &streamState);
+}
+
+void DataStreams::set_header(
+    DataStreamState &streamState,
+    StreamHeaderTrackMessage streamHeaderTrackMessage) {
+  std::uint64_t trackAlias = streamHeaderTrackMessage.trackAlias_.get();
+  streamState.set_header(std::move(streamHeaderTrackMessage));
+  trackIndex_.insert_or_assign(trackAlias, &streamState);
+}
+
+void DataStreams::set_header(DataStreamState &streamState,
+                             FetchHeaderMessage fetchHeaderMessage) {
+  std::uint64_t subscribeId = fetchHeaderMessage.subscribeId_;
+  streamState.set_header(std::move(fetchHeaderMessage));
+  fetchIndex_.insert_or_assign(subscribeId, &streamState);
+}
+
+DataStreamState *DataStreams::find(const DataStreamKey &key) const {
+  auto iter = subgroupIndex_.find(key);
+  if (iter == subgroupIndex_.end())
+    return nullptr;
+
+  return iter->second;
+}
+
+DataStreamState *DataStreams::find(HQUIC streamHandle) const {
+  auto iter = handleIndex_.find(streamHandle);
+  if (iter == handleIndex_.end())
+    return nullptr;
+
+  return &*iter->second;
+}
+
+DataStreamState *DataStreams::find(TrackAlias trackAlias) const {
+  auto iter = trackIndex_.find(trackAlias.get());
+  if (iter == trackIndex_.end())
+    return nullptr;
+
+  return iter->second;
+}
+
+DataStreamState *DataStreams::find_fetch(std::uint64_t subscribeId) const {
+  auto iter = fetchIndex_.find(subscribeId);
+  if (iter == fetchIndex_.end())
+    return nullptr;
+
+  return iter->second;
+}
+
+void DataStreams::erase(StableContainer<DataStreamState>::iterator iter) {
+  deadlines_.erase(*iter);
+
+  if (const auto &header = iter->streamHeaderSubgroupMessage_) {
+    auto indexIter = subgroupIndex_.find(
+        {header->trackAlias_, header->groupId_, header->subgroupId_});
+    // a newer stream might have taken over the subgroup
+    if (indexIter != subgroupIndex_.end() && indexIter->second == &*iter)
+      subgroupIndex_.erase(indexIter);
+  }
+
+  if (const auto &header = iter->streamHeaderTrackMessage_) {
+    auto indexIter = trackIndex_.find(header->trackAlias_.get());
+    if (indexIter != trackIndex_.end() && indexIter->second == &*iter)
+      trackIndex_.erase(indexIter);
+  }
+
+  if (const auto &header = iter->fetchHeaderMessage_) {
+    auto indexIter = fetchIndex_.find(header->subscribeId_);
+    if (indexIter != fetchIndex_.end() && indexIter->second == &*iter)
+      fetchIndex_.erase(indexIter);
+  }
+
+  handleIndex_.erase(iter->stream.get());
+  streams_.erase(iter);
+}
+
+void DataStreams::erase(HQUIC streamHandle) {
+  auto iter = handleIndex_.find(streamHandle);
+  if (iter != handleIndex_.end())
+    erase(iter->second);
+}
+
+void DataStreams::erase(const DataStreamKey &key) {
+  auto iter = subgroupIndex_.find(key);
+  if (iter != subgroupIndex_.end())
+    erase(iter->second->stream.get());
+}
+
+void DataStreams::finish_fetch(std::uint64_t subscribeId) {
+  fetchIndex_.erase(subscribeId);
+}
+
+bool DataStreams::set_deadline(DataStreamState &streamState,
+                               TimePoint deadline) {
+  // there is nothing left to abort, the stream is erased once MsQuic is done
+  // with it
+  if (streamState.streamContext_->sendShutdown_.load(
+          std::memory_order_acquire))
     return false;
 
-  bool trackBoolMatch =
-      (streamHeaderSubgroupMessage_->groupId_ == objectIdentifier.groupId_) &&
-      (trackAliasOpt.value() == streamHeaderSubgroupMessage_->trackAlias_);
+  deadlines_.set(streamState, deadline);
 
-  if (!trackBoolMatch)
+  if (armedDeadline_.has_value() && *armedDeadline_ <= deadline)
     return false;
 
-  // TODO: return true should be replaced with subgroupId match
+  armedDeadline_ = deadline;
   return true;
 }
 
-void DataStreamState::set_header(
-    StreamHeaderSubgroupMessage streamHeaderSubgroupMessage) {
-  streamHeaderSubgroupMessage_ = std::make_shared<StreamHeaderSubgroupMessage>(
-      std::move(streamHeaderSubgroupMessage));
-}
+std::optional<TimePoint> DataStreams::expire_deadlines(TimePoint now) {
+  // the timer which was armed has fired (or an earlier one)
+  armedDeadline_.reset();
 
-std::weak_ptr<void> DataStreamState::get_life_time_flag() const noexcept {
-  return lifeTimeFlag_;
+  while (!deadlines_.empty() && deadlines_.top().deadline_ <= now) {
+    DataStreamState &streamState = deadlines_.pop();
+
+    // the stream has not been erased, so its context has not been freed
+    const StreamContext &streamContext = *streamState.streamContext_;
+    // everything sent on the stream has been delivered, or MsQuic has shut
+    // the stream down and it waits to be erased (on_data_stream_shutdown)
+    if (streamContext.outstandingBytes_.load(std::memory_order_relaxed) == 0 ||
+        streamContext.sendShutdown_.load(std::memory_order_acquire))
+      continue;
+
+    erase(handleIndex_.at(streamState.stream.get()));
+  }
+
+  if (deadlines_.empty())
+    return std::nullopt;
+
+  armedDeadline_ = deadlines_.top().deadline_;
+  return armedDeadline_;
 }
 
 void ConnectionState::delete_data_stream(HQUIC streamHandle) {
-  dataStreams.write(
-      [&streamHandle](StableContainer<DataStreamState> &dataStreams) {
-        auto iter =
-            std::find_if(dataStreams.begin(), dataStreams.end(),
-                         [&streamHandle](const DataStreamState &streamState) {
-                           return streamState.stream.get() == streamHandle;
-                         });
-
-        dataStreams.erase(iter);
+  dataStreams.write([&streamHandle](DataStreams &dataStreams) {
+    // the range of a fetch ends with its stream
+    const DataStreamState *dataStreamState = dataStreams.find(streamHandle);
+    if (dataStreamState != nullptr && dataStreamState->fetchStream_)
+      dataStreamState->fetchStream_->finish();
+
+    dataStreams.erase(streamHandle);
+  });
+}
+
+void ConnectionState::on_data_stream_shutdown(HQUIC streamHandle,
+                                              StreamContext *streamContext) {
+  TimerHandle()->add_timer(
+      std::chrono::milliseconds(0),
+      [connState = this->weak_from_this(), streamHandle,
+       streamContext](auto...) {
+        // the handle is only closed by the erase, so it can not have been
+        // reused for another stream
+        if (auto connStateSharedPtr = connState.lock()) {
+          // a stream leaves the pool only to be put in dataStreams under its
+          // writer lock, so it is found in one of the two. Streams are put in
+          // the pool on this thread, so it is not on its way there
+          connStateSharedPtr->discard_pooled_data_stream(streamHandle);
+          connStateSharedPtr->delete_data_stream(streamHandle);
+        }
+        // nothing refers to the context once the stream is out of the pool
+        // and dataStreams (or the connection state is gone)
+        delete streamContext;
       });
 }
 
+std::size_t ConnectionState::process_received_buffers(std::size_t maxBuffers) {
+  std::size_t numBuffers = 0;
+  for (; numBuffers < maxBuffers; ++numBuffers) {
+    std::optional<ReceivedBuffer> receivedBuffer = receivedBuffers_.try_pop();
+    if (!receivedBuffer.has_value())
+      break;
+
+    auto &deserializer = *receivedBuffer->streamContext_->deserializer_;
+    if (receivedBuffer->buffer_)
+      deserializer.append_buffer(std::move(receivedBuffer->buffer_));
+    else {
+      deserializer.detach_stream();
+      delete_data_stream(receivedBuffer->stream_);
+    }
+  }
+  return numBuffers;
+}
+
 void ConnectionState::send_control_buffer(QUIC_BUFFER *buffer,
                                           QUIC_SEND_FLAGS flags) {
   // control messages have higher priority
@@ -94,12 +278,11 @@ std::optional<StreamState> &ConnectionState::get_control_stream() {
 
 QUIC_STATUS ConnectionState::accept_data_stream(HQUIC streamHandle) {
   // register new data stream into connectionState object
-  return dataStreams.write([&](StableContainer<DataStreamState> &dataStreams) {
-    dataStreams.emplace_back(
+  return dataStreams.write([&](DataStreams &dataStreams) {
+    DataStreamState &streamState = dataStreams.emplace_back(
         rvn::unique_stream(moqtObject_.get_tbl(), streamHandle), *this);
 
     // set stream context for stream
-    DataStreamState &streamState = dataStreams.back();
     streamState.set_stream_context(new StreamContext(moqtObject_, *this));
     streamState.streamContext_->construct_deserializer(streamState, false);
 
@@ -153,43 +336,79 @@ StreamState &ConnectionState::establish_control_stream() {
 }
 
 QUIC_STATUS ConnectionState::send_object(
+    TrackAlias trackAlias, SubGroupId subgroupId,
     const ObjectIdentifier &objectIdentifier, QUIC_BUFFER *objectPayload,
     std::optional<std::chrono::milliseconds> timeoutDuration) {
-  auto sendObjectLambda =
-      [&](const StableContainer<DataStreamState> &dataStreams) {
-        auto iter = std::find_if(
-            dataStreams.begin(), dataStreams.end(),
-            [&objectIdentifier](const DataStreamState &streamState) {
-              return streamState.can_send_object(objectIdentifier);
-            });
-
-        // We return this to indicate that we have not found a stream to send
-        // the object This is not an error, we just need to create a new stream
-        // to send the object We never expect StreamSend to return
-        // `QUIC_STATUS_ALPN_NEG_FAILURE`, hence if it was returned, the intent
-        // is clear
-        if (iter == dataStreams.end())
-          return QUIC_STATUS_ALPN_NEG_FAILURE;
-
-        StreamSendContext *streamSendContext =
-            new StreamSendContext(objectPayload, 1, iter->streamContext_);
-
-        return moqtObject_.get_tbl()->StreamSend(
-            iter->stream.get(), objectPayload, 1, QUIC_SEND_FLAG_PRIORITY_WORK,
-            streamSendContext);
-        return QUIC_STATUS_SUCCESS;
-      };
+  return send_objects(trackAlias, subgroupId, objectIdentifier,
+                      std::span(&objectPayload, 1), timeoutDuration);
+}
+
+QUIC_STATUS ConnectionState::send_objects(
+    TrackAlias trackAlias, SubGroupId subgroupId,
+    const ObjectIdentifier &objectIdentifier,
+    std::span<QUIC_BUFFER *const> objectPayloads,
+    std::optional<std::chrono::milliseconds> timeoutDuration, bool delaySend) {
+  const DataStreamKey dataStreamKey{trackAlias, objectIdentifier.groupId_,
+                                    subgroupId};
+
+  auto sendObjectLambda = [&](const DataStreams &dataStreams) {
+    const DataStreamState *dataStreamState = dataStreams.find(dataStreamKey);
+
+    // We return this to indicate that we have not found a stream to send
+    // the object This is not an error, we just need to create a new stream
+    // to send the object We never expect StreamSend to return
+    // `QUIC_STATUS_ALPN_NEG_FAILURE`, hence if it was returned, the intent
+    // is clear
+    if (dataStreamState == nullptr)
+      return QUIC_STATUS_ALPN_NEG_FAILURE;
+
+    std::uint32_t bufferCount = objectPayloads.size();
+    QUIC_BUFFER *sendBuffers = objectPayloads[0];
+    StreamSendContext *streamSendContext;
+
+    if (bufferCount == 1)
+      streamSendContext = new StreamSendContext(
+          sendBuffers, 1, dataStreamState->streamContext_);
+    else {
+      // cached objects are not contiguous in memory but StreamSend expects
+      // an array of QUIC_BUFFER, we only copy the descriptors, payloads
+      // are still sent without copying
+      sendBuffers = new QUIC_BUFFER[bufferCount];
+      for (std::uint32_t i = 0; i < bufferCount; ++i)
+        sendBuffers[i] = *objectPayloads[i];
+
+      streamSendContext = new StreamSendContext(
+          sendBuffers, bufferCount, dataStreamState->streamContext_,
+          [](StreamSendContext *streamSendContext) {
+            delete[] streamSendContext->buffer;
+          });
+    }
+
+    on_data_send(*streamSendContext);
+    QUIC_STATUS status = send_data(dataStreamState->stream.get(), sendBuffers,
+                                   bufferCount, streamSendContext, delaySend);
+
+    // SEND_COMPLETE is not delivered for a failed send
+    if (QUIC_FAILED(status)) {
+      on_data_send_complete(*streamSendContext);
+      streamSendContext->send_complete_cb();
+      delete streamSendContext;
+      if (dataStreamState->streamContext_->sendShutdown_.load(
+              std::memory_order_acquire))
+        return StreamShutdownStatus;
+    }
+
+    return status;
+  };
 
   QUIC_STATUS trySendStatus = dataStreams.read(sendObjectLambda);
 
   if (trySendStatus == QUIC_STATUS_ALPN_NEG_FAILURE) {
     // header message
     StreamHeaderSubgroupMessage objectHeader;
-    // TODO: add error handling to this
-    objectHeader.trackAlias_ = identifier_to_alias(objectIdentifier).value();
-    objectHeader.groupId_ = objectIdentifier.groupId_;
-    // TOOD: get subgroupId
-    objectHeader.subgroupId_ = SubGroupId(0);
+    objectHeader.trackAlias_ = dataStreamKey.trackAlias_;
+    objectHeader.groupId_ = dataStreamKey.groupId_;
+    objectHeader.subgroupId_ = dataStreamKey.subgroupId_;
 
     // Get publisher priority from group
     MOQTServer &moqtServer = static_cast<MOQTServer &>(moqtObject_);
@@ -200,78 +419,568 @@ QUIC_STATUS ConnectionState::send_object(
     QUIC_BUFFER *objectHeaderQuicBuffer =
         serialization::serialize(objectHeader);
 
-    // Create a new stream and send the object
-    StreamContext *streamContext = new StreamContext(moqtObject_, *this);
-
-    // TODO: do error handling here
-    auto stream = rvn::unique_stream(
-        moqtObject_.get_tbl(),
-        {connection_.get(), QUIC_STREAM_OPEN_FLAG_UNIDIRECTIONAL,
-         moqtObject_.data_stream_cb_wrapper, streamContext},
-        {QUIC_STREAM_START_FLAG_IMMEDIATE});
-
+    std::optional<TimePoint> deadlineTimer;
     QUIC_STATUS status = dataStreams.write(
-        [&, streamIn = std::move(stream),
-         this](StableContainer<DataStreamState> &dataStreams) mutable {
-          dataStreams.emplace_back(std::move(streamIn), *this);
-          DataStreamState &streamState = dataStreams.back();
-          streamState.set_header(objectHeader);
+        [&, this](DataStreams &dataStreams) {
+          // taken under the lock, see on_data_stream_shutdown
+          auto [stream, streamContext] = open_data_stream();
+          DataStreamState &streamState =
+              dataStreams.emplace_back(std::move(stream), *this);
+          dataStreams.set_header(streamState, objectHeader);
           streamState.set_stream_context(streamContext);
 
           // no need deserializer because we don't expect to receive any
           // messages on this stream
 
-          StreamSendContext *streamSendContext = new StreamSendContext(
-              objectHeaderQuicBuffer, 1, streamState.streamContext_);
+          QUIC_STATUS status = send_data_stream_header(
+              streamState, objectHeaderQuicBuffer,
+              objectHeader.publisherPriority_);
+
+          /*
+              Draft specifies that timeout should start from when it receives
+              the object, but we set it from when we start sending the object
 
-          // Set priority of stream to indicate the priority of the group
-          // MsQuic uses uint16_t stream priority, unlike moqt which uses 8 bit
-          std::uint16_t streamPriority = objectHeader.publisherPriority_;
-          moqtObject_.get_tbl()->SetParam(
-              streamState.stream.get(), QUIC_PARAM_STREAM_PRIORITY,
-              sizeof(std::uint16_t), &streamPriority);
+              TODO: check if we can set it from when the object is received
+              (Talk to Alan)
+          */
+          if (timeoutDuration)
+            if (dataStreams.set_deadline(streamState,
+                                         Clock::now() + *timeoutDuration))
+              deadlineTimer = streamState.deadline_;
 
-          return moqtObject_.get_tbl()->StreamSend(
-              streamState.stream.get(), objectHeaderQuicBuffer, 1,
-              QUIC_SEND_FLAG_DELAY_SEND, streamSendContext);
+          return status;
         });
 
-    /*
-        Draft specifies that timeout should start from when it receives the
-       object, but we set it from when we start sending the object
-
-        TODO: check if we can set it from when the object is received (Talk to
-       Alan)
-    */
-    if (timeoutDuration)
-      TimerHandle()->add_timer(
-          *timeoutDuration,
-          [objectIdentifier, connState = this->weak_from_this()](auto...) {
-            if (auto connStateSharedPtr = connState.lock())
-              connStateSharedPtr->abort_if_sending(objectIdentifier);
-          });
+    // timer is added without holding the dataStreams lock, timer callbacks
+    // take it
+    if (deadlineTimer)
+      add_deadline_timer(*deadlineTimer);
 
     if (QUIC_FAILED(status))
       return status;
 
-    return send_object(objectIdentifier, objectPayload, timeoutDuration);
+    return send_objects(trackAlias, subgroupId, objectIdentifier,
+                        objectPayloads, timeoutDuration, delaySend);
   }
 
   return trySendStatus;
 }
 
-void ConnectionState::abort_if_sending(const ObjectIdentifier &oid) {
-  dataStreams.write([&](StableContainer<DataStreamState> &dataStreams) {
-    auto iter = std::find_if(dataStreams.begin(), dataStreams.end(),
-                             [&](DataStreamState &streamState) {
-                               return streamState.can_send_object(oid);
+QUIC_STATUS ConnectionState::send_track_objects(
+    TrackAlias trackAlias, const ObjectIdentifier &objectIdentifier,
+    std::span<QUIC_BUFFER *const> objectPayloads, bool delaySend) {
+  auto sendObjectLambda = [&](const DataStreams &dataStreams) {
+    const DataStreamState *dataStreamState = dataStreams.find(trackAlias);
+
+    // same as in send_objects, the stream has to be created first
+    if (dataStreamState == nullptr)
+      return QUIC_STATUS_ALPN_NEG_FAILURE;
+
+    // cached objects start with the object id, on a track stream every
+    // object is preceded by its group id, all objects share the group so a
+    // single header (StreamSendContext::objectHeader) is referenced by every
+    // other buffer
+    std::uint32_t bufferCount = 2 * objectPayloads.size();
+    QUIC_BUFFER *sendBuffers = new QUIC_BUFFER[bufferCount];
+
+    StreamSendContext *streamSendContext = new StreamSendContext(
+        sendBuffers, bufferCount, dataStreamState->streamContext_,
+        [](StreamSendContext *streamSendContext) {
+          delete[] streamSendContext->buffer;
+        });
+
+    static thread_local ds::chunk groupIdChunk(sizeof(std::uint64_t));
+    groupIdChunk.clear();
+    serialization::detail::serialize<ds::quic_var_int>(
+        groupIdChunk, objectIdentifier.groupId_.get());
+    QUIC_BUFFER groupIdHeader = streamSendContext->set_object_header(
+        {groupIdChunk.data(), groupIdChunk.size()});
+
+    for (std::uint32_t i = 0; i < objectPayloads.size(); ++i) {
+      sendBuffers[2 * i] = groupIdHeader;
+      sendBuffers[2 * i + 1] = *objectPayloads[i];
+    }
+
+    on_data_send(*streamSendContext);
+    QUIC_STATUS status = send_data(dataStreamState->stream.get(), sendBuffers,
+                                   bufferCount, streamSendContext, delaySend);
+
+    if (QUIC_FAILED(status)) {
+      on_data_send_complete(*streamSendContext);
+      streamSendContext->send_complete_cb();
+      delete streamSendContext;
+      if (dataStreamState->streamContext_->sendShutdown_.load(
+              std::memory_order_acquire))
+        return StreamShutdownStatus;
+    }
+
+    return status;
+  };
+
+  QUIC_STATUS trySendStatus = dataStreams.read(sendObjectLambda);
+  if (trySendStatus != QUIC_STATUS_ALPN_NEG_FAILURE)
+    return trySendStatus;
+
+  // the stream has the priority of the group which opened it
+  MOQTServer &moqtServer = static_cast<MOQTServer &>(moqtObject_);
+  StreamHeaderTrackMessage trackHeader{
+      trackAlias,
+      moqtServer.dataManager_->get_publisher_priority(objectIdentifier)
+          .value()};
+
+  QUIC_BUFFER *trackHeaderQuicBuffer = serialization::serialize(trackHeader);
+
+  QUIC_STATUS status = dataStreams.write(
+      [&, this](DataStreams &dataStreams) {
+        // taken under the lock, see on_data_stream_shutdown
+        auto [stream, streamContext] = open_data_stream();
+        DataStreamState &streamState =
+            dataStreams.emplace_back(std::move(stream), *this);
+        dataStreams.set_header(streamState, trackHeader);
+        streamState.set_stream_context(streamContext);
+
+        return send_data_stream_header(streamState, trackHeaderQuicBuffer,
+                                       trackHeader.publisherPriority_);
+      });
+
+  if (QUIC_FAILED(status))
+    return status;
+
+  return send_track_objects(trackAlias, objectIdentifier, objectPayloads,
+                            delaySend);
+}
+
+QUIC_STATUS ConnectionState::send_fetch_objects(
+    std::uint64_t subscribeId, GroupId groupId, SubGroupId subgroupId,
+    PublisherPriority publisherPriority,
+    std::span<QUIC_BUFFER *const> objectPayloads, bool fin, bool delaySend) {
+  auto sendObjectLambda = [&](const DataStreams &dataStreams) {
+    const DataStreamState *dataStreamState =
+        dataStreams.find_fetch(subscribeId);
+
+    // same as in send_objects, the stream has to be created first
+    if (dataStreamState == nullptr)
+      return QUIC_STATUS_ALPN_NEG_FAILURE;
+
+    // cached objects start with the object id, on a fetch stream every object
+    // is preceded by its group id, subgroup id and publisher priority, which
+    // all objects of the batch share, so a single header
+    // (StreamSendContext::objectHeader) is referenced by every other buffer
+    // a send which only ends the stream has a single empty buffer
+    std::uint32_t bufferCount =
+        std::max<std::uint32_t>(2 * objectPayloads.size(), 1);
+    QUIC_BUFFER *sendBuffers = new QUIC_BUFFER[bufferCount];
+    sendBuffers[0] = {0, nullptr};
+
+    StreamSendContext *streamSendContext = new StreamSendContext(
+        sendBuffers, bufferCount, dataStreamState->streamContext_,
+        [](StreamSendContext *streamSendContext) {
+          delete[] streamSendContext->buffer;
+        });
+
+    static thread_local ds::chunk headerChunk(
+        StreamSendContext::maxObjectHeaderSize);
+    headerChunk.clear();
+    serialization::detail::serialize<ds::quic_var_int>(headerChunk,
+                                                       groupId.get());
+    serialization::detail::serialize<ds::quic_var_int>(headerChunk,
+                                                       subgroupId.get());
+    serialization::detail::serialize<std::uint8_t>(headerChunk,
+                                                   publisherPriority);
+    QUIC_BUFFER objectHeader = streamSendContext->set_object_header(
+        {headerChunk.data(), headerChunk.size()});
+
+    for (std::uint32_t i = 0; i < objectPayloads.size(); ++i) {
+      sendBuffers[2 * i] = objectHeader;
+      sendBuffers[2 * i + 1] = *objectPayloads[i];
+    }
+
+    on_data_send(*streamSendContext);
+    QUIC_STATUS status =
+        send_data(dataStreamState->stream.get(), sendBuffers, bufferCount,
+                  streamSendContext, delaySend, fin);
+
+    if (QUIC_FAILED(status)) {
+      on_data_send_complete(*streamSendContext);
+      streamSendContext->send_complete_cb();
+      delete streamSendContext;
+      if (dataStreamState->streamContext_->sendShutdown_.load(
+              std::memory_order_acquire))
+        return StreamShutdownStatus;
+    }
+
+    return status;
+  };
+
+  QUIC_STATUS trySendStatus = dataStreams.read(sendObjectLambda);
+  if (trySendStatus != QUIC_STATUS_ALPN_NEG_FAILURE) {
+    // no more objects for this FETCH, the stream itself is erased on its
+    // SHUTDOWN_COMPLETE (on_data_stream_shutdown)
+    if (fin && QUIC_SUCCEEDED(trySendStatus))
+      dataStreams.write([subscribeId](DataStreams &dataStreams) {
+        dataStreams.finish_fetch(subscribeId);
+      });
+    return trySendStatus;
+  }
+
+  // the stream has the priority of the group which opened it
+  FetchHeaderMessage fetchHeader{subscribeId};
+  QUIC_BUFFER *fetchHeaderQuicBuffer = serialization::serialize(fetchHeader);
+
+  QUIC_STATUS status = dataStreams.write(
+      [&, this](DataStreams &dataStreams) {
+        // taken under the lock, see on_data_stream_shutdown
+        auto [stream, streamContext] = open_data_stream();
+        DataStreamState &streamState =
+            dataStreams.emplace_back(std::move(stream), *this);
+        dataStreams.set_header(streamState, fetchHeader);
+        streamState.set_stream_context(streamContext);
+
+        return send_data_stream_header(streamState, fetchHeaderQuicBuffer,
+                                       publisherPriority);
+      });
+
+  if (QUIC_FAILED(status))
+    return status;
+
+  return send_fetch_objects(subscribeId, groupId, subgroupId,
+                            publisherPriority, objectPayloads, fin, delaySend);
+}
+
+QUIC_STATUS ConnectionState::send_data(HQUIC streamHandle,
+                                       QUIC_BUFFER *buffers,
+                                       std::uint32_t bufferCount,
+                                       StreamSendContext *streamSendContext,
+                                       bool delaySend, bool fin) {
+  QUIC_SEND_FLAGS flags = QUIC_SEND_FLAG_PRIORITY_WORK;
+  if (fin)
+    flags |= QUIC_SEND_FLAG_FIN;
+
+  if (!delaySend)
+    return moqtObject_.get_tbl()->StreamSend(streamHandle, buffers,
+                                             bufferCount, flags,
+                                             streamSendContext);
+
+  QUIC_STATUS status = moqtObject_.get_tbl()->StreamSend(
+      streamHandle, buffers, bufferCount, flags | QUIC_SEND_FLAG_DELAY_SEND,
+      streamSendContext);
+  if (QUIC_FAILED(status))
+    return status;
+
+  // recorded only once the data is queued, a flush which takes the list
+  // between the two would find nothing to flush for this stream. The caller
+  // calls set_flush_pending after this returns, so a flush which misses the
+  // stream has already reset flushPending_ and the caller flushes it itself
+  {
+    std::lock_guard lock(delayedStreamsMtx_);
+    delayedStreams_.push_back(streamHandle);
+  }
+  return status;
+}
+
+bool ConnectionState::set_flush_pending() {
+  return !flushPending_.exchange(true, std::memory_order_acq_rel);
+}
+
+void ConnectionState::flush_delayed_sends() {
+  // reset before taking the streams, streams delayed after this are flushed
+  // by whoever sets flushPending_ next
+  flushPending_.store(false, std::memory_order_release);
+
+  static thread_local std::vector<HQUIC> streamHandles;
+  streamHandles.clear();
+  {
+    std::lock_guard lock(delayedStreamsMtx_);
+    std::swap(streamHandles, delayedStreams_);
+  }
+
+  std::sort(streamHandles.begin(), streamHandles.end());
+  streamHandles.erase(std::unique(streamHandles.begin(), streamHandles.end()),
+                      streamHandles.end());
+
+  // a send without QUIC_SEND_FLAG_DELAY_SEND flushes the data queued before
+  // it, an empty send does that without sending anything itself
+  static QUIC_BUFFER flushBuffer{0, nullptr};
+
+  dataStreams.read([&](const DataStreams &dataStreams) {
+    for (HQUIC streamHandle : streamHandles) {
+      // aborted streams have nothing to flush
+      const DataStreamState *dataStreamState = dataStreams.find(streamHandle);
+      if (dataStreamState == nullptr)
+        continue;
+
+      StreamSendContext *streamSendContext = new StreamSendContext(
+          &flushBuffer, 1, dataStreamState->streamContext_);
+      QUIC_STATUS status = moqtObject_.get_tbl()->StreamSend(
+          streamHandle, &flushBuffer, 1, QUIC_SEND_FLAG_PRIORITY_WORK,
+          streamSendContext);
+      if (QUIC_FAILED(status))
+        delete streamSendContext;
+    }
+  });
+}
+
+void ConnectionState::refill_data_stream_pool() {
+  if (dataStreamPoolRefillPending_.exchange(true, std::memory_order_acq_rel))
+    return;
+
+  TimerHandle()->add_timer(std::chrono::milliseconds(0),
+                           [connState = this->weak_from_this()](auto...) {
+                             if (auto connStateSharedPtr = connState.lock())
+                               connStateSharedPtr->fill_data_stream_pool();
+                           });
+}
+
+void ConnectionState::fill_data_stream_pool() {
+  dataStreamPoolRefillPending_.store(false, std::memory_order_release);
+
+  while (true) {
+    {
+      std::lock_guard lock(dataStreamPoolMtx_);
+      if (dataStreamPool_.size() >= dataStreamPoolSize)
+        return;
+    }
+
+    // streams are opened without holding the lock so that taking a stream
+    // from the pool does not wait for it
+    std::tuple<rvn::unique_stream, StreamContext *> dataStream;
+    try {
+      dataStream = create_data_stream();
+    } catch (const std::exception &) {
+      // connection is being shut down, streams are opened inline from now
+      return;
+    }
+
+    std::lock_guard lock(dataStreamPoolMtx_);
+    dataStreamPool_.push_back(std::move(dataStream));
+  }
+}
+
+void ConnectionState::discard_pooled_data_stream(HQUIC streamHandle) {
+  std::tuple<rvn::unique_stream, StreamContext *> dataStream;
+  {
+    std::lock_guard lock(dataStreamPoolMtx_);
+    auto iter = std::find_if(dataStreamPool_.begin(), dataStreamPool_.end(),
+                             [streamHandle](const auto &pooledStream) {
+                               return std::get<0>(pooledStream).get() ==
+                                      streamHandle;
                              });
+    if (iter == dataStreamPool_.end())
+      return;
+    dataStream = std::move(*iter);
+    dataStreamPool_.erase(iter);
+  }
+  // the stream is let go of without holding the pool lock
+}
+
+std::tuple<rvn::unique_stream, StreamContext *>
+ConnectionState::open_data_stream() {
+  std::tuple<rvn::unique_stream, StreamContext *> dataStream;
+  bool fromPool = false;
+  {
+    std::lock_guard lock(dataStreamPoolMtx_);
+    if (!dataStreamPool_.empty()) {
+      dataStream = std::move(dataStreamPool_.back());
+      dataStreamPool_.pop_back();
+      fromPool = true;
+    }
+  }
+
+  refill_data_stream_pool();
+
+  if (fromPool)
+    return dataStream;
+
+  return create_data_stream();
+}
 
-    if (iter != dataStreams.end())
-      dataStreams.erase(iter);
+std::tuple<rvn::unique_stream, StreamContext *>
+ConnectionState::create_data_stream() {
+  StreamContext *streamContext = new StreamContext(moqtObject_, *this);
+
+  try {
+    auto stream = rvn::unique_stream(
+        moqtObject_.get_tbl(),
+        {connection_.get(), QUIC_STREAM_OPEN_FLAG_UNIDIRECTIONAL,
+         moqtObject_.data_stream_cb_wrapper, streamContext},
+        {QUIC_STREAM_START_FLAG_IMMEDIATE});
+
+    return {std::move(stream), streamContext};
+  } catch (...) {
+    // SHUTDOWN_COMPLETE, which deletes the context, is not delivered for a
+    // stream which failed to open or start
+    delete streamContext;
+    throw;
+  }
+}
+
+QUIC_STATUS
+ConnectionState::send_data_stream_header(DataStreamState &streamState,
+                                         QUIC_BUFFER *header,
+                                         PublisherPriority publisherPriority) {
+  StreamSendContext *streamSendContext =
+      new StreamSendContext(header, 1, streamState.streamContext_);
+
+  // Set priority of stream to indicate the priority of the group
+  // MsQuic uses uint16_t stream priority, unlike moqt which uses 8 bit
+  std::uint16_t streamPriority = publisherPriority;
+  moqtObject_.get_tbl()->SetParam(streamState.stream.get(),
+                                  QUIC_PARAM_STREAM_PRIORITY,
+                                  sizeof(std::uint16_t), &streamPriority);
+
+  on_data_send(*streamSendContext);
+  QUIC_STATUS status = moqtObject_.get_tbl()->StreamSend(
+      streamState.stream.get(), header, 1, QUIC_SEND_FLAG_DELAY_SEND,
+      streamSendContext);
+  if (QUIC_FAILED(status)) {
+    on_data_send_complete(*streamSendContext);
+    delete streamSendContext;
+  }
+
+  return status;
+}
+
+void ConnectionState::on_data_send(StreamSendContext &streamSendContext) {
+  std::uint64_t numBytes = 0;
+  for (std::uint32_t i = 0; i < streamSendContext.bufferCount; ++i)
+    numBytes += streamSendContext.buffer[i].Length;
+
+  streamSendContext.accountedBytes = numBytes;
+  streamSendContext.streamContext->outstandingBytes_.fetch_add(
+      numBytes, std::memory_order_relaxed);
+  add_outstanding_bytes(numBytes);
+}
+
+void ConnectionState::on_data_send_complete(
+    StreamSendContext &streamSendContext) {
+  std::uint64_t numBytes = std::exchange(streamSendContext.accountedBytes, 0);
+  if (numBytes == 0)
+    return;
+
+  streamSendContext.streamContext->outstandingBytes_.fetch_sub(
+      numBytes, std::memory_order_relaxed);
+  remove_outstanding_bytes(numBytes);
+}
+
+void ConnectionState::add_outstanding_bytes(std::uint64_t numBytes) {
+  std::uint64_t outstandingBytes =
+      outstandingBytes_.fetch_add(numBytes, std::memory_order_relaxed) +
+      numBytes;
+  /*
+      If a SEND_COMPLETE races with us and reopens the window before we close
+      it, the bytes we just added are still outstanding, so their SEND_COMPLETE
+      will reopen the window again
+  */
+  if (outstandingBytes > sendWatermarks_.highWaterMark_)
+    sendWindowSignal_->store(ObjectWaitStatus::Wait, std::memory_order_relaxed);
+}
+
+void ConnectionState::remove_outstanding_bytes(std::uint64_t numBytes) {
+  std::uint64_t outstandingBytes =
+      outstandingBytes_.fetch_sub(numBytes, std::memory_order_relaxed) -
+      numBytes;
+  if (outstandingBytes <= sendWatermarks_.lowWaterMark_)
+    sendWindowSignal_->store(ObjectWaitStatus::Ready,
+                             std::memory_order_release);
+}
+
+void ConnectionState::on_datagram_state_changed(bool sendEnabled,
+                                                std::uint16_t maxSendLength) {
+  maxDatagramSendLength_.store(sendEnabled ? maxSendLength : 0,
+                               std::memory_order_relaxed);
+}
+
+QUIC_STATUS ConnectionState::send_datagram(TrackAlias trackAlias,
+                                           GroupId groupId,
+                                           PublisherPriority publisherPriority,
+                                           QUIC_BUFFER *object) {
+  // the cached object starts with its object id, which goes in the header,
+  // payload length and payload are sent as they are
+  std::uint64_t objectId;
+  ds::BufferSpan objectSpan(object->Buffer, object->Length);
+  std::uint64_t objectIdLength =
+      serialization::detail::deserialize<ds::quic_var_int>(objectId,
+                                                           objectSpan);
+
+  // reused across calls to avoid allocating on every datagram
+  static thread_local ds::chunk headerChunk(DatagramSendContext::maxHeaderSize);
+  headerChunk.clear();
+  serialization::detail::serialize_header(
+      headerChunk, ObjectDatagramMessage{trackAlias, groupId,
+                                         ObjectId(objectId), publisherPriority,
+                                         {}});
+
+  std::uint64_t datagramLength =
+      headerChunk.size() + object->Length - objectIdLength;
+  if (datagramLength > maxDatagramSendLength_.load(std::memory_order_relaxed))
+    return QUIC_STATUS_BUFFER_TOO_SMALL;
+
+  DatagramSendContext *datagramSendContext = new DatagramSendContext(*this);
+  std::memcpy(datagramSendContext->header_, headerChunk.data(),
+              headerChunk.size());
+  datagramSendContext->buffers_[0] = {
+      static_cast<std::uint32_t>(headerChunk.size()),
+      datagramSendContext->header_};
+  datagramSendContext->buffers_[1] = {
+      static_cast<std::uint32_t>(object->Length - objectIdLength),
+      object->Buffer + objectIdLength};
+  datagramSendContext->accountedBytes_ = datagramLength;
+
+  // should be accounted before sending, the send state can change before
+  // DatagramSend returns
+  add_outstanding_bytes(datagramLength);
+  QUIC_STATUS status = moqtObject_.get_tbl()->DatagramSend(
+      connection_.get(), datagramSendContext->buffers_, 2,
+      QUIC_SEND_FLAG_DGRAM_PRIORITY, datagramSendContext);
+
+  // no send state change is delivered for a failed send
+  if (QUIC_FAILED(status)) {
+    on_datagram_send_complete(*datagramSendContext);
+    delete datagramSendContext;
+  }
+
+  return status;
+}
+
+void ConnectionState::on_datagram_send_complete(
+    DatagramSendContext &datagramSendContext) {
+  std::uint64_t numBytes =
+      std::exchange(datagramSendContext.accountedBytes_, 0);
+  if (numBytes != 0)
+    remove_outstanding_bytes(numBytes);
+}
+
+void ConnectionState::abort_if_sending(TrackAlias trackAlias,
+                                       SubGroupId subgroupId,
+                                       const ObjectIdentifier &oid) {
+  dataStreams.write([&](DataStreams &dataStreams) {
+    dataStreams.erase(DataStreamKey{trackAlias, oid.groupId_, subgroupId});
   });
 }
 
+void ConnectionState::add_deadline_timer(TimePoint deadline) {
+  auto duration = std::chrono::ceil<std::chrono::milliseconds>(
+      deadline - Clock::now());
+  if (duration.count() < 0)
+    duration = std::chrono::milliseconds(0);
+
+  TimerHandle()->add_timer(
+      duration, [connState = this->weak_from_this()](auto...) {
+        if (auto connStateSharedPtr = connState.lock())
+          connStateSharedPtr->process_deadlines();
+      });
+}
+
+void ConnectionState::process_deadlines() {
+  std::optional<TimePoint> nextDeadline =
+      dataStreams.write([](DataStreams &dataStreams) {
+        return dataStreams.expire_deadlines(Clock::now());
+      });
+
+  if (nextDeadline)
+    add_deadline_timer(*nextDeadline);
+}
+
 std::optional<GroupId>
 ConnectionState::get_current_group(const TrackIdentifier &trackIdentifier) {
   // reader lock
@@ -338,6 +1047,11 @@ void StreamContext::construct_deserializer(StreamState &streamState,
   } else
     streamState.streamContext_->deserializer_.emplace(
         isControlStream, MessageHandler(streamState, nullptr));
+
+  // only objects have payloads
+  if (!isControlStream)
+    streamState.streamContext_->deserializer_->set_payload_views(
+        moqtObject_.payloadViews);
   return;
 }
 } // namespace rvn
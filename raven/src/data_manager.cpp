@@ -1,6 +1,7 @@
 #include "serialization/messages.hpp"
 #include "serialization/serialization.hpp"
 #include "strong_types.hpp"
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <data_manager.hpp>
@@ -164,10 +165,18 @@ std::optional<SubgroupHandle> SubgroupHandle::cap_and_next() {
   groupHandleSharedPtr->objectIds_.insert(beginObjectId);
   groupHandleSharedPtr->objectIds_.insert(
       std::numeric_limits<std::uint64_t>::max());
+  groupHandleSharedPtr->subgroupBeginObjectIds_.push_back(beginObjectId);
+  groupHandleSharedPtr->subgroupLayerTypes_.push_back(layerType_);
+  groupHandleSharedPtr->numSubgroups_.store(
+      groupHandleSharedPtr->subgroupBeginObjectIds_.size(),
+      std::memory_order_release);
+
+  groupHandleSharedPtr->bump_track_group_sequence();
 
   return SubgroupHandle(groupHandleSharedPtr, dataManager_,
                         ObjectId(beginObjectId),
-                        ObjectId(std::numeric_limits<std::uint64_t>::max()));
+                        ObjectId(std::numeric_limits<std::uint64_t>::max()),
+                        layerType_);
 }
 
 TrackIdentifier::TrackIdentifier(std::vector<std::string> trackNamespace,
@@ -190,32 +199,34 @@ ObjectIdentifier::ObjectIdentifier(GroupIdentifier groupIdentifier,
     : GroupIdentifier(groupIdentifier), objectId_(objectId) {}
 
 SubGroupId ObjectIdentifier::get_subgroup_id(DataManager &dataManager) const {
-  if (subgroupId_.has_value())
-    return *subgroupId_;
+  if (subgroupId_.has_value() && subgroupId_->groupId_ == groupId_ &&
+      subgroupId_->objectId_ == objectId_)
+    return subgroupId_->subgroupId_;
 
   auto groupHandle = dataManager.get_group_handle(*this).lock();
 
   if (groupHandle == nullptr)
     throw std::invalid_argument("GroupHandle is null");
 
-  subgroupId_ = groupHandle->get_subgroup_id(objectId_);
+  subgroupId_ = {groupId_, objectId_, groupHandle->get_subgroup_id(objectId_)};
 
-  return *subgroupId_;
+  return subgroupId_->subgroupId_;
 }
 
 GroupHandle::GroupHandle(
     GroupIdentifier groupIdentifier, PublisherPriority publisherPriority,
     std::optional<std::chrono::milliseconds> deliveryTimeout,
-    DataManager &dataManagerHandle)
+    DataManager &dataManagerHandle, LayerType layerType)
     : groupIdentifier_(std::move(groupIdentifier)),
       publisherPriority_(publisherPriority), deliveryTimeout_(deliveryTimeout),
-      dataManager_(dataManagerHandle) {
+      layerType_(layerType), dataManager_(dataManagerHandle) {
   // create directory if it does not exist
   std::string pathString = dataManager_.get_path_string(groupIdentifier_);
   std::filesystem::create_directories(pathString);
 }
 
-SubgroupHandle GroupHandle::add_subgroup(std::uint64_t numElements) {
+SubgroupHandle GroupHandle::add_subgroup(std::uint64_t numElements,
+                                         std::optional<LayerType> layerType) {
   // writer lock
   std::unique_lock<std::shared_mutex> l(objectIdsMtx_);
 
@@ -223,12 +234,19 @@ SubgroupHandle GroupHandle::add_subgroup(std::uint64_t numElements) {
   beginObjectId &= (~(1ULL << 63)); // mask of last bit
   objectIds_.insert(beginObjectId);
   objectIds_.insert((beginObjectId + numElements) | (1ULL << 63));
+  subgroupBeginObjectIds_.push_back(beginObjectId);
+  subgroupLayerTypes_.push_back(layerType.value_or(layerType_));
+  numSubgroups_.store(subgroupBeginObjectIds_.size(),
+                      std::memory_order_release);
+  bump_track_group_sequence();
 
   return SubgroupHandle(weak_from_this(), dataManager_, ObjectId(beginObjectId),
-                        ObjectId(beginObjectId + numElements));
+                        ObjectId(beginObjectId + numElements),
+                        subgroupLayerTypes_.back());
 };
 
-SubgroupHandle GroupHandle::add_open_ended_subgroup() {
+SubgroupHandle
+GroupHandle::add_open_ended_subgroup(std::optional<LayerType> layerType) {
   // writer lock
   std::unique_lock<std::shared_mutex> l(objectIdsMtx_);
 
@@ -236,9 +254,95 @@ SubgroupHandle GroupHandle::add_open_ended_subgroup() {
   beginObjectId &= (~(1ULL << 63)); // mask of last bit
   objectIds_.insert(beginObjectId);
   objectIds_.insert(std::numeric_limits<std::uint64_t>::max());
+  subgroupBeginObjectIds_.push_back(beginObjectId);
+  subgroupLayerTypes_.push_back(layerType.value_or(layerType_));
+  numSubgroups_.store(subgroupBeginObjectIds_.size(),
+                      std::memory_order_release);
+  bump_track_group_sequence();
 
   return SubgroupHandle(weak_from_this(), dataManager_, ObjectId(beginObjectId),
-                        ObjectId(std::numeric_limits<std::uint64_t>::max()));
+                        ObjectId(std::numeric_limits<std::uint64_t>::max()),
+                        subgroupLayerTypes_.back());
+}
+
+std::optional<std::size_t>
+GroupHandle::get_subgroup_index(ObjectId objectId) const {
+  /*
+      subgroups are contiguous, [b0     b1) [b1     b2) [b2     b3) ...
+      so the subgroup of x is the last subgroup which begins at or before x
+  */
+  auto iter = std::upper_bound(subgroupBeginObjectIds_.begin(),
+                               subgroupBeginObjectIds_.end(), objectId.get());
+  if (iter == subgroupBeginObjectIds_.begin())
+    return std::nullopt;
+
+  return std::distance(subgroupBeginObjectIds_.begin(), iter) - 1;
+}
+
+SubGroupId GroupHandle::get_subgroup_id(ObjectId objectId) const {
+  // reader lock
+  std::shared_lock<std::shared_mutex> l(objectIdsMtx_);
+
+  std::optional<std::size_t> subgroupIdx = get_subgroup_index(objectId);
+  if (!subgroupIdx.has_value())
+    throw std::invalid_argument("ObjectId not found in GroupHandle");
+
+  return SubGroupId(*subgroupIdx);
+}
+
+GroupHandle::SubgroupRange
+GroupHandle::get_subgroup_range(ObjectId objectId) const {
+  // reader lock
+  std::shared_lock<std::shared_mutex> l(objectIdsMtx_);
+
+  std::optional<std::size_t> subgroupIdx = get_subgroup_index(objectId);
+  if (!subgroupIdx.has_value())
+    throw std::invalid_argument("ObjectId not found in GroupHandle");
+
+  SubgroupRange range{SubGroupId(*subgroupIdx), std::nullopt,
+                      subgroupBeginObjectIds_.size()};
+  if (*subgroupIdx + 1 < subgroupBeginObjectIds_.size()) {
+    range.end_ = ObjectId(subgroupBeginObjectIds_[*subgroupIdx + 1]);
+    return range;
+  }
+
+  // last subgroup, its end marker follows its begin
+  auto iter = objectIds_.find(subgroupBeginObjectIds_[*subgroupIdx]);
+  if (iter != objectIds_.end() && ++iter != objectIds_.end() &&
+      *iter != std::numeric_limits<std::uint64_t>::max())
+    range.end_ = ObjectId(*iter & (~(1ULL << 63)));
+
+  return range;
+}
+
+bool GroupHandle::in_subgroup_range(const SubgroupRange &range,
+                                    ObjectId objectId) const noexcept {
+  if (range.end_.has_value())
+    return objectId < *range.end_;
+
+  // the open ended subgroup is capped by cap_and_next which adds the next
+  // subgroup, we end the run there even if objectId is before the cap
+  return numSubgroups_.load(std::memory_order_acquire) == range.numSubgroups_;
+}
+
+LayerType GroupHandle::get_layer_type(ObjectId objectId) {
+  // reader lock
+  std::shared_lock<std::shared_mutex> l(objectIdsMtx_);
+
+  std::optional<std::size_t> subgroupIdx = get_subgroup_index(objectId);
+  if (!subgroupIdx.has_value())
+    return layerType_;
+
+  return subgroupLayerTypes_[*subgroupIdx];
+}
+
+void GroupHandle::bump_track_group_sequence() {
+  // called with objectIdsMtx_ held after the subgroup is inserted, so a
+  // subscription which sees the bump also sees the subgroup. The track lock
+  // is not held, see SubscriptionState::discover_new_groups
+  // group might not belong to a track yet (while it is being emplaced)
+  if (trackGroupSequence_)
+    trackGroupSequence_->fetch_add(1, std::memory_order_release);
 }
 
 bool GroupHandle::has_object_id(ObjectId objectId) {
@@ -282,7 +386,8 @@ std::uint64_t GroupHandle::num_objects_in_range(ObjectId left, ObjectId right) {
 TrackHandle::TrackHandle(DataManager &dataManagerHandle,
                          TrackIdentifier trackIdentifier)
     : dataManager_(dataManagerHandle),
-      trackIdentifier_(std::move(trackIdentifier)) {
+      trackIdentifier_(std::move(trackIdentifier)),
+      groupSequence_(std::make_shared<std::atomic<std::uint64_t>>(0)) {
   // create directory if it does not exist
   std::string pathString = dataManager_.get_path_string(trackIdentifier_);
   std::filesystem::create_directories(pathString);
@@ -397,6 +502,25 @@ DataManager::get_first_group(const TrackIdentifier &trackIdentifier) {
   return trackHandleSharedPtr->groupHandles_.begin()->first;
 }
 
+std::optional<GroupId>
+DataManager::get_next_group(const GroupIdentifier &groupIdentifier) {
+  std::shared_lock l(objectHierarchyMtx_);
+
+  auto iter = objectHierarchy_.find(groupIdentifier);
+  if (iter == objectHierarchy_.end())
+    return std::nullopt;
+
+  std::shared_ptr<TrackHandle> trackHandleSharedPtr = iter->second;
+  l = std::shared_lock(trackHandleSharedPtr->groupHandlesMtx_);
+
+  auto groupHandleIter =
+      trackHandleSharedPtr->groupHandles_.upper_bound(groupIdentifier.groupId_);
+  if (groupHandleIter == trackHandleSharedPtr->groupHandles_.end())
+    return std::nullopt;
+
+  return groupHandleIter->first;
+}
+
 std::optional<ObjectId> DataManager::get_latest_registered_object(
     const GroupIdentifier &groupIdentifier) {
   std::shared_lock l(objectHierarchyMtx_);
@@ -470,8 +594,17 @@ DataManager::get_publisher_priority(const GroupIdentifier &groupIdentifier) {
   return groupHandleIter->second->publisherPriority_;
 }
 
-ObjectOrStatus
-DataManager::get_object(const ObjectIdentifier &objectIdentifier) {
+std::optional<LayerType>
+DataManager::get_layer_type(const ObjectIdentifier &objectIdentifier) {
+  auto groupHandleSharedPtr = get_group_handle(objectIdentifier).lock();
+  if (!groupHandleSharedPtr)
+    return std::nullopt;
+
+  return groupHandleSharedPtr->get_layer_type(objectIdentifier.objectId_);
+}
+
+std::variant<DataManager::CacheLookup, DoesNotExist>
+DataManager::lookup_cached_object(const ObjectIdentifier &objectIdentifier) {
   // we have reader lock at each step in hierarchy
   // so can be sure that nothing will be deleted (needs writer lock)
   std::shared_lock l(objectHierarchyMtx_);
@@ -495,30 +628,37 @@ DataManager::get_object(const ObjectIdentifier &objectIdentifier) {
   if (!groupHandleSharedPtr->has_object_id(objectIdentifier.objectId_))
     return DoesNotExist{"Object does not exist"};
 
-  QUIC_BUFFER *quicBuffer = groupHandleSharedPtr->groupCache_.read(
-      [&objectIdentifier](const auto &groupCache) -> QUIC_BUFFER * {
-        auto iter = groupCache.find(objectIdentifier.objectId_);
-        if (iter != groupCache.end())
-          return iter->second;
-        return nullptr;
-      });
-
-  if (quicBuffer != nullptr)
-    return std::make_tuple(quicBuffer, groupHandleSharedPtr->deliveryTimeout_);
+  std::optional<QUIC_BUFFER *> cacheEntry =
+      groupHandleSharedPtr->groupCache_.read(
+          [&objectIdentifier](
+              const auto &groupCache) -> std::optional<QUIC_BUFFER *> {
+            auto iter = groupCache.find(objectIdentifier.objectId_);
+            if (iter != groupCache.end())
+              return iter->second;
+            return std::nullopt;
+          });
+
+  return CacheLookup{std::move(groupHandleSharedPtr), cacheEntry};
+}
 
+ObjectOrStatus
+DataManager::get_object(const ObjectIdentifier &objectIdentifier) {
+  auto lookup = lookup_cached_object(objectIdentifier);
+  if (auto *doesNotExist = std::get_if<DoesNotExist>(&lookup))
+    return *doesNotExist;
+
+  auto &[groupHandleSharedPtr, cacheEntry] = std::get<CacheLookup>(lookup);
+  if (!cacheEntry.has_value())
+    return wait_for_object(*groupHandleSharedPtr, objectIdentifier.objectId_);
+  if (*cacheEntry != nullptr)
+    return std::make_tuple(*cacheEntry,
+                           groupHandleSharedPtr->deliveryTimeout_);
+
+  // stored but not cached
   std::string pathString = get_path_string(objectIdentifier);
   std::ifstream file(pathString);
-  if (!file.is_open()) {
-    return groupHandleSharedPtr->objectWaitSignals_.write(
-        [&objectIdentifier](auto &waitSignals) {
-          auto [iter, success] = waitSignals.try_emplace(
-              objectIdentifier.objectId_,
-              std::make_shared<std::atomic<ObjectWaitStatus>>(
-                  ObjectWaitStatus::Wait));
-
-          return iter->second;
-        });
-  }
+  if (!file.is_open())
+    return DoesNotExist{"Object could not be read"};
 
   std::string object(std::istreambuf_iterator<char>(file), {});
 
@@ -526,16 +666,67 @@ DataManager::get_object(const ObjectIdentifier &objectIdentifier) {
   subgroupObject.objectId_ = objectIdentifier.objectId_;
   subgroupObject.payload_ = std::move(object);
 
-  quicBuffer = serialization::serialize(subgroupObject);
+  QUIC_BUFFER *quicBuffer = serialization::serialize(subgroupObject);
 
   groupHandleSharedPtr->groupCache_.write(
       [quicBuffer, &objectIdentifier](auto &cache) {
-        cache.emplace(objectIdentifier.objectId_, quicBuffer);
+        // another reader might have read it back in the meantime
+        QUIC_BUFFER *&cachedBuffer = cache[objectIdentifier.objectId_];
+        if (cachedBuffer == nullptr)
+          cachedBuffer = quicBuffer;
       });
 
   return std::make_tuple(quicBuffer, groupHandleSharedPtr->deliveryTimeout_);
 }
 
+std::optional<ObjectOrStatus>
+DataManager::get_cached_object(const ObjectIdentifier &objectIdentifier) {
+  auto lookup = lookup_cached_object(objectIdentifier);
+  if (auto *doesNotExist = std::get_if<DoesNotExist>(&lookup))
+    return *doesNotExist;
+
+  auto &[groupHandleSharedPtr, cacheEntry] = std::get<CacheLookup>(lookup);
+  if (!cacheEntry.has_value())
+    return wait_for_object(*groupHandleSharedPtr, objectIdentifier.objectId_);
+  // stored but not cached, has to be read from disk
+  if (*cacheEntry == nullptr)
+    return std::nullopt;
+
+  return std::make_tuple(*cacheEntry, groupHandleSharedPtr->deliveryTimeout_);
+}
+
+ObjectOrStatus DataManager::wait_for_object(GroupHandle &groupHandle,
+                                            ObjectId objectId) {
+  ObjectWaitSignal objectWaitSignal =
+      groupHandle.objectWaitSignals_.write([objectId](auto &waitSignals) {
+        auto [iter, success] = waitSignals.try_emplace(
+            objectId, std::make_shared<std::atomic<ObjectWaitStatus>>(
+                          ObjectWaitStatus::Wait));
+
+        return iter->second;
+      });
+
+  // object might have been stored (and waiters signalled) after we looked
+  // at the cache but before we registered the wait signal, the signal would
+  // then never be set
+  std::optional<QUIC_BUFFER *> cacheEntry = groupHandle.groupCache_.read(
+      [objectId](const auto &groupCache) -> std::optional<QUIC_BUFFER *> {
+        auto iter = groupCache.find(objectId);
+        if (iter != groupCache.end())
+          return iter->second;
+        return std::nullopt;
+      });
+  if (!cacheEntry.has_value())
+    return objectWaitSignal;
+  if (*cacheEntry != nullptr)
+    return std::make_tuple(*cacheEntry, groupHandle.deliveryTimeout_);
+
+  // stored and no longer cached, the reader looks it up again and reads it
+  // from disk
+  objectWaitSignal->store(ObjectWaitStatus::Ready, std::memory_order_release);
+  return objectWaitSignal;
+}
+
 bool DataManager::next(ObjectIdentifier &objectIdentifier,
                        std::uint64_t advanceBy) {
   // we have reader lock at each step in hierarchy
@@ -34,6 +34,8 @@ void MessageHandler::operator()(SubscribeMessage subscribeMessage) {
                                   subscribeMessage.trackName_);
   streamState_.connectionState_.add_track_alias(std::move(trackIdentifier),
                                                 subscribeMessage.trackAlias_);
+  // objects of the subscription will need data streams
+  streamState_.connectionState_.refill_data_stream_pool();
 
   subscriptionManager_->add_subscription(
       streamState_.connectionState_.weak_from_this(),
@@ -43,6 +45,7 @@ void MessageHandler::operator()(SubscribeMessage subscribeMessage) {
 void MessageHandler::operator()(BatchSubscribeMessage batchSubscribeMessage) {
   utils::LOG_EVENT(std::cout, "Batch Subscribe Message received: \n",
                    batchSubscribeMessage);
+  streamState_.connectionState_.refill_data_stream_pool();
   for (auto &subscribeMessage : batchSubscribeMessage.subscriptions_) {
     std::vector<std::string> trackNamespace =
         batchSubscribeMessage.trackNamespacePrefix_;
@@ -69,9 +72,8 @@ void MessageHandler::operator()(
   DataStreamState &dataStreamState =
       static_cast<DataStreamState &>(streamState_);
 
-  moqtClient.receivedObjects_.enqueue(
-      {dataStreamState.streamHeaderSubgroupMessage_,
-       std::move(streamHeaderSubgroupObject)});
+  moqtClient.deliver_objects(dataStreamState.streamHeaderSubgroupMessage_,
+                             {&streamHeaderSubgroupObject, 1});
 }
 
 void MessageHandler::operator()(
@@ -92,4 +94,128 @@ void MessageHandler::operator()(
        dataStreamState.objectQueue_});
 }
 
+// objects of a track stream are delivered with a subgroup header, a new one is
+// made when the group changes because the previous one is shared with
+// delivered objects
+static const std::shared_ptr<StreamHeaderSubgroupMessage> &
+track_object_header(DataStreamState &dataStreamState, GroupId groupId) {
+  const auto &trackHeader = *dataStreamState.streamHeaderTrackMessage_;
+  auto &header = dataStreamState.streamHeaderSubgroupMessage_;
+  if (!header || header->groupId_ != groupId)
+    header = std::make_shared<StreamHeaderSubgroupMessage>(
+        trackHeader.trackAlias_, groupId, SubGroupId(0),
+        trackHeader.publisherPriority_);
+  return header;
+}
+
+void MessageHandler::operator()(
+    TrackStreamObjectMessage trackStreamObjectMessage) {
+  MOQTClient &moqtClient =
+      static_cast<MOQTClient &>(streamState_.connectionState_.moqtObject_);
+
+  DataStreamState &dataStreamState =
+      static_cast<DataStreamState &>(streamState_);
+
+  const auto &header =
+      track_object_header(dataStreamState, trackStreamObjectMessage.groupId_);
+  StreamHeaderSubgroupObject object{
+      trackStreamObjectMessage.objectId_,
+      std::move(trackStreamObjectMessage.payload_),
+      std::move(trackStreamObjectMessage.payloadView_)};
+  moqtClient.deliver_objects(header, {&object, 1});
+}
+
+void MessageHandler::handle_object_batch(
+    std::span<StreamHeaderSubgroupObject> batch) {
+  MOQTClient &moqtClient =
+      static_cast<MOQTClient &>(streamState_.connectionState_.moqtObject_);
+
+  DataStreamState &dataStreamState =
+      static_cast<DataStreamState &>(streamState_);
+  moqtClient.deliver_objects(dataStreamState.streamHeaderSubgroupMessage_,
+                             batch);
+}
+
+void MessageHandler::handle_object_batch(
+    std::span<TrackStreamObjectMessage> batch) {
+  MOQTClient &moqtClient =
+      static_cast<MOQTClient &>(streamState_.connectionState_.moqtObject_);
+
+  DataStreamState &dataStreamState =
+      static_cast<DataStreamState &>(streamState_);
+
+  std::vector<StreamHeaderSubgroupObject> objects;
+  objects.reserve(batch.size());
+  for (auto &object : batch)
+    objects.push_back({object.objectId_, std::move(object.payload_),
+                       std::move(object.payloadView_)});
+
+  // objects of a group share a header and are delivered together
+  std::size_t groupBegin = 0;
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    if (i + 1 != batch.size() && batch[i + 1].groupId_ == batch[i].groupId_)
+      continue;
+
+    const auto &header =
+        track_object_header(dataStreamState, batch[i].groupId_);
+    moqtClient.deliver_objects(
+        header, std::span(objects).subspan(groupBegin, i + 1 - groupBegin));
+    groupBegin = i + 1;
+  }
+}
+
+void MessageHandler::operator()(
+    StreamHeaderTrackMessage streamHeaderTrackMessage) {
+  // objects of a track stream are only delivered through
+  // MOQTClient::deliver_objects, the stream does not map to a single subgroup
+  // handle
+  DataStreamState &dataStreamState =
+      static_cast<DataStreamState &>(streamState_);
+  dataStreamState.set_header(std::move(streamHeaderTrackMessage));
+}
+
+void MessageHandler::operator()(FetchMessage fetchMessage) {
+  utils::LOG_EVENT(std::cout, "Fetch Message received: \n", fetchMessage);
+  // objects of the fetch go on a data stream of their own
+  streamState_.connectionState_.refill_data_stream_pool();
+
+  subscriptionManager_->add_fetch(
+      streamState_.connectionState_.weak_from_this(), std::move(fetchMessage));
+}
+
+void MessageHandler::operator()(FetchHeaderMessage fetchHeaderMessage) {
+  DataStreamState &dataStreamState =
+      static_cast<DataStreamState &>(streamState_);
+
+  MOQTClient &moqtClient =
+      static_cast<MOQTClient &>(streamState_.connectionState_.moqtObject_);
+
+  // objects of a fetch the client does not know about are dropped
+  dataStreamState.fetchStream_ =
+      moqtClient.take_fetch_stream(fetchHeaderMessage.subscribeId_);
+  dataStreamState.set_header(std::move(fetchHeaderMessage));
+}
+
+void MessageHandler::operator()(FetchObjectMessage fetchObjectMessage) {
+  handle_object_batch({&fetchObjectMessage, 1});
+}
+
+void MessageHandler::handle_object_batch(std::span<FetchObjectMessage> batch) {
+  DataStreamState &dataStreamState =
+      static_cast<DataStreamState &>(streamState_);
+
+  if (dataStreamState.fetchStream_)
+    dataStreamState.fetchStream_->push(batch);
+}
+
+void MessageHandler::operator()(GoAwayMessage goAwayMessage) {
+  utils::LOG_EVENT(std::cout, "GoAway Message received: \n", goAwayMessage);
+  MOQT &moqtObject = streamState_.streamContext_->moqtObject_;
+  utils::ASSERT_LOG_THROW(moqtObject.hostType_ == HostType::CLIENT,
+                          "GOAWAY is only sent by servers");
+
+  MOQTClient &moqtClient = static_cast<MOQTClient &>(moqtObject);
+  moqtClient.on_go_away(std::move(goAwayMessage));
+}
+
 } // namespace rvn
@@ -65,6 +65,32 @@ MOQT &MOQT::set_dataStreamCb(stream_cb_lamda_t dataStreamCb_) {
   return *this;
 }
 
+MOQT &MOQT::set_zeroCopyReceive(bool zeroCopyReceive_) {
+  // without multi receive MsQuic does not deliver more data till pending
+  // receives are completed, a partially received message would never finish
+  bool settingsSet =
+      secondaryCounter & sec_index_to_val(SecondaryIndices::Settings);
+  utils::ASSERT_LOG_THROW(!zeroCopyReceive_ ||
+                              (settingsSet &&
+                               Settings->IsSet.StreamMultiReceiveEnabled &&
+                               Settings->StreamMultiReceiveEnabled),
+                          "Zero copy receive requires multi receive");
+  zeroCopyReceive = zeroCopyReceive_;
+  return *this;
+}
+
+MOQT &MOQT::set_payloadViews(bool payloadViews_) {
+  payloadViews = payloadViews_;
+  return *this;
+}
+
+MOQT &MOQT::set_receiveHandoff(bool receiveHandoff_) {
+  utils::ASSERT_LOG_THROW(!receiveHandoff_ || hostType_ == HostType::CLIENT,
+                          "Receive handoff is only supported on the client");
+  receiveHandoff = receiveHandoff_;
+  return *this;
+}
+
 MOQT::MOQT(HostType hostType)
     : hostType_(hostType), tbl(rvn::make_unique_quic_table()) {
   secondaryCounter = 0;
@@ -83,10 +109,7 @@ ConnectionState *MOQT::get_connectionState(HQUIC connectionHandle) {
     return thisClient->connectionState.get();
   } else {
     MOQTServer *thisServer = static_cast<MOQTServer *>(this);
-    auto iter = thisServer->connectionStateMap.find(connectionHandle);
-    if (iter == thisServer->connectionStateMap.end())
-      return nullptr;
-    return iter->second.get();
+    return thisServer->connections_.find(connectionHandle).get();
   }
 }
 } // namespace rvn
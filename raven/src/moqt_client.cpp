@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <atomic>
 #include <contexts.hpp>
 #include <moqt.hpp>
 #include <msquic.h>
+#include <serialization/chunk.hpp>
+#include <serialization/deserialization_impl.hpp>
 #include <serialization/messages.hpp>
 #include <stdexcept>
 #include <utilities.hpp>
@@ -55,4 +58,153 @@ ClientSetupMessage MOQTClient::get_clientSetupMessage() {
   return clientSetupMessage;
 }
 
+void MOQTClient::accept_datagram(const QUIC_BUFFER &datagram) {
+  ObjectDatagramMessage objectDatagramMessage;
+  ds::BufferSpan span(datagram.Buffer, datagram.Length);
+  serialization::detail::deserialize(objectDatagramMessage, span);
+
+  // datagrams do not belong to a subgroup, they are delivered with a subgroup
+  // header of subgroup 0 so that users see a single kind of object
+  auto header = std::make_shared<StreamHeaderSubgroupMessage>(
+      objectDatagramMessage.trackAlias_, objectDatagramMessage.groupId_,
+      SubGroupId(0), objectDatagramMessage.publisherPriority_);
+
+  StreamHeaderSubgroupObject object{objectDatagramMessage.objectId_,
+                                    std::move(objectDatagramMessage.payload_)};
+  deliver_objects(header, {&object, 1});
+}
+
+void MOQTClient::deliver_objects(
+    const std::shared_ptr<StreamHeaderSubgroupMessage> &header,
+    std::span<StreamHeaderSubgroupObject> objects) {
+  if (objects.empty())
+    return;
+
+  // progress is the largest object id, one update for all objects
+  std::uint64_t maxObjectId = 0;
+  for (const auto &object : objects)
+    maxObjectId = std::max(maxObjectId, object.objectId_);
+  ObjectSink objectSink = on_object_received(*header, ObjectId(maxObjectId));
+
+  if (auto *objectRing =
+          std::get_if<std::shared_ptr<TrackObjectRing>>(&objectSink)) {
+    for (auto &object : objects)
+      (*objectRing)->push({header, std::move(object)});
+    return;
+  }
+
+  if (auto *jitterBuffer =
+          std::get_if<std::shared_ptr<TrackJitterBuffer>>(&objectSink)) {
+    TimePoint arrival = Clock::now();
+    for (auto &object : objects)
+      (*jitterBuffer)->push({header, std::move(object)}, arrival);
+    return;
+  }
+
+  if (objectCallback_) {
+    for (auto &object : objects)
+      objectCallback_(*header, std::move(object));
+    return;
+  }
+
+  if (objects.size() == 1) {
+    receivedObjects_.enqueue({header, std::move(objects.front())});
+    return;
+  }
+
+  std::vector<EnrichedObjectMessage> enrichedObjects;
+  enrichedObjects.reserve(objects.size());
+  for (auto &object : objects)
+    enrichedObjects.push_back({header, std::move(object)});
+  receivedObjects_.enqueue_bulk(
+      std::make_move_iterator(enrichedObjects.begin()), enrichedObjects.size());
+}
+
+void MOQTClient::on_go_away(GoAwayMessage goAwayMessage) {
+  goAwayMessage_ = std::move(goAwayMessage);
+  goAwayFlag_.store(true, std::memory_order_release);
+}
+
+void MOQTClient::add_subscription_progress(
+    const SubscribeMessage &subscribeMessage, ObjectSink objectSink) {
+  std::lock_guard lock(subscriptionProgressMtx_);
+  subscriptionProgress_[subscribeMessage.trackAlias_.get()] = {
+      subscribeMessage, std::nullopt, std::move(objectSink)};
+}
+
+MOQTClient::ObjectSink
+MOQTClient::on_object_received(const StreamHeaderSubgroupMessage &header,
+                               ObjectId objectId) {
+  std::lock_guard lock(subscriptionProgressMtx_);
+  auto iter = subscriptionProgress_.find(header.trackAlias_.get());
+  if (iter == subscriptionProgress_.end())
+    return {};
+
+  // objects of different groups (and subgroups) are received out of order
+  auto &lastReceived = iter->second.lastReceived_;
+  if (!lastReceived || header.groupId_ > lastReceived->group_ ||
+      (header.groupId_ == lastReceived->group_ &&
+       objectId > lastReceived->object_))
+    lastReceived = GroupObjectPair{header.groupId_, objectId};
+  return iter->second.objectSink_;
+}
+
+std::vector<SubscribeMessage> MOQTClient::get_resume_subscriptions() {
+  std::lock_guard lock(subscriptionProgressMtx_);
+
+  std::vector<SubscribeMessage> subscribeMessages;
+  subscribeMessages.reserve(subscriptionProgress_.size());
+  for (const auto &[trackAlias, progress] : subscriptionProgress_) {
+    SubscribeMessage subscribeMessage = progress.subscribeMessage_;
+    switch (subscribeMessage.filterType_) {
+    case SubscribeFilterType::LatestGroup:
+    case SubscribeFilterType::LatestObject:
+    case SubscribeFilterType::AbsoluteStart:
+    case SubscribeFilterType::AbsoluteRange:
+      if (progress.lastReceived_) {
+        // range keeps its end
+        if (subscribeMessage.filterType_ != SubscribeFilterType::AbsoluteRange)
+          subscribeMessage.filterType_ = SubscribeFilterType::AbsoluteStart;
+        subscribeMessage.start_ = progress.lastReceived_;
+      }
+      break;
+    // only the latest objects are wanted, there is nothing to resume from
+    case SubscribeFilterType::LatestPerGroupInTrack:
+      break;
+    }
+    subscribeMessages.push_back(std::move(subscribeMessage));
+  }
+  return subscribeMessages;
+}
+
+std::shared_ptr<FetchStream>
+MOQTClient::take_fetch_stream(std::uint64_t subscribeId) {
+  std::lock_guard lock(pendingFetchesMtx_);
+  auto iter = pendingFetches_.find(subscribeId);
+  if (iter == pendingFetches_.end())
+    return nullptr;
+
+  std::shared_ptr<FetchStream> fetchStream = std::move(iter->second);
+  pendingFetches_.erase(iter);
+  return fetchStream;
+}
+
+void MOQTClient::finish_pending_fetches() {
+  std::unordered_map<std::uint64_t, std::shared_ptr<FetchStream>>
+      pendingFetches;
+  {
+    std::lock_guard lock(pendingFetchesMtx_);
+    pendingFetchesClosed_ = true;
+    std::swap(pendingFetches, pendingFetches_);
+  }
+
+  for (auto &[subscribeId, fetchStream] : pendingFetches)
+    fetchStream->finish();
+}
+
+void MOQTClient::close_connection() {
+  tbl->ConnectionShutdown(connectionState->connection_.get(),
+                          QUIC_CONNECTION_SHUTDOWN_FLAG_NONE, 0);
+}
+
 } // namespace rvn
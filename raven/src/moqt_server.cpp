@@ -1,6 +1,8 @@
 #include "subscription_manager.hpp"
+#include <chrono>
 #include <contexts.hpp>
 #include <moqt.hpp>
+#include <thread>
 #include <utilities.hpp>
 #include <wrappers.hpp>
 
@@ -8,10 +10,12 @@ namespace rvn {
 
 MOQTServer::MOQTServer(
     std::shared_ptr<DataManager> dataManager,
-    std::tuple<QUIC_EXECUTION_CONFIG *, std::uint64_t> execConfigTuple)
+    std::tuple<QUIC_EXECUTION_CONFIG *, std::uint64_t> execConfigTuple,
+    SendBudget sendBudget, SendWatermarks sendWatermarks)
     : MOQT(HostType::SERVER), dataManager_(dataManager),
-      subscriptionManager_(
-          std::make_shared<SubscriptionManager>(*dataManager_)) {
+      subscriptionManager_(std::make_shared<SubscriptionManager>(
+          *dataManager_, 1, sendBudget)),
+      sendWatermarks_(sendWatermarks) {
   auto [execConfig, execConfigLen] = execConfigTuple;
   QUIC_STATUS status = tbl->SetParam(
       nullptr, QUIC_PARAM_GLOBAL_EXECUTION_CONFIG, execConfigLen, execConfig);
@@ -19,6 +23,56 @@ MOQTServer::MOQTServer(
     throw std::runtime_error("Could not set execution config");
 };
 
+MOQTServer::~MOQTServer() {
+  // stop accepting before closing the connections
+  listener = rvn::unique_listener();
+
+  // states are released (and their connections closed) after the registry
+  // locks are dropped
+  for (auto &connectionState : connections_.clear())
+    if (connectionLifecycleHooks_.onConnectionClosed_)
+      connectionLifecycleHooks_.onConnectionClosed_(*connectionState);
+}
+
+void MOQTServer::cleanup_connection(HQUIC connection) {
+  std::shared_ptr<ConnectionState> connectionState =
+      connections_.erase(connection);
+  if (!connectionState)
+    return;
+
+  if (connectionLifecycleHooks_.onConnectionClosed_)
+    connectionLifecycleHooks_.onConnectionClosed_(*connectionState);
+}
+
+void MOQTServer::drain(std::string newSessionURI,
+                       std::chrono::milliseconds gracePeriod) {
+  auto deadline = std::chrono::steady_clock::now() + gracePeriod;
+
+  // returns once the listener is stopped, no connection is accepted after
+  listener = rvn::unique_listener();
+
+  GoAwayMessage goAwayMessage(std::move(newSessionURI));
+  connections_.for_each([&](ConnectionState &connectionState) {
+    // connections which have not set up their control stream have nothing to
+    // move, they are shut down after the grace period
+    if (connectionState.get_control_stream().has_value())
+      connectionState.send_control_buffer(
+          serialization::serialize(goAwayMessage));
+  });
+
+  // connections are removed from the registry on SHUTDOWN_COMPLETE
+  while (connections_.size() != 0 &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  // msquic queues the shutdown, SHUTDOWN_COMPLETE does not run inline so
+  // the registry lock is not taken twice
+  connections_.for_each([this](ConnectionState &connectionState) {
+    get_tbl()->ConnectionShutdown(connectionState.connection_.get(),
+                                  QUIC_CONNECTION_SHUTDOWN_FLAG_NONE, 0);
+  });
+}
+
 void MOQTServer::start_listener(QUIC_ADDR *LocalAddress) {
   rvn::utils::ASSERT_LOG_THROW(
       secondaryCounter == full_sec_counter_value(), "secondaryCounter ",
@@ -1,6 +1,8 @@
 #include "serialization/chunk.hpp"
 #include "serialization/messages.hpp"
 #include "serialization/quic_var_int.hpp"
+#include <array>
+#include <serialization/quic_var_int_batch.hpp>
 #include <serialization/serialization_impl.hpp>
 #include <utilities.hpp>
 
@@ -21,6 +23,19 @@ mock_serialize(const rvn::DeliveryTimeoutParameter &parameter) {
   return parameterTotalLen;
 }
 
+[[nodiscard]] serialize_return_t
+mock_serialize(const rvn::DeliveryModeParameter &parameter) {
+  std::uint64_t parameterTotalLen = 0;
+  parameterTotalLen += mock_serialize<ds::quic_var_int>(
+      utils::to_underlying(ParameterType::DeliveryMode));
+  std::uint64_t parameterLength =
+      ds::quic_var_int(utils::to_underlying(parameter.mode_)).size();
+  parameterTotalLen += mock_serialize<ds::quic_var_int>(parameterLength);
+  parameterTotalLen +=
+      mock_serialize<ds::quic_var_int>(utils::to_underlying(parameter.mode_));
+  return parameterTotalLen;
+}
+
 [[nodiscard]] serialize_return_t
 mock_serialize(const rvn::Parameter &parameter) {
   return std::visit([](const auto &param) { return mock_serialize(param); },
@@ -39,6 +54,18 @@ serialize_return_t serialize(ds::chunk &c,
       serialize<ds::quic_var_int>(c, parameter.timeout_.count());
   return parameterTotalLen;
 }
+serialize_return_t serialize(ds::chunk &c,
+                             const rvn::DeliveryModeParameter &parameter) {
+  std::uint64_t parameterTotalLen = 0;
+  parameterTotalLen += serialize<ds::quic_var_int>(
+      c, utils::to_underlying(ParameterType::DeliveryMode));
+  std::uint64_t parameterLength =
+      ds::quic_var_int(utils::to_underlying(parameter.mode_)).size();
+  parameterTotalLen += serialize<ds::quic_var_int>(c, parameterLength);
+  parameterTotalLen +=
+      serialize<ds::quic_var_int>(c, utils::to_underlying(parameter.mode_));
+  return parameterTotalLen;
+}
 serialize_return_t serialize(ds::chunk &c, const rvn::Parameter &parameter) {
   return std::visit([&c](const auto &param) { return serialize(c, param); },
                     parameter.parameter_);
@@ -107,6 +134,25 @@ serialize(ds::chunk &c, const rvn::ServerSetupMessage &serverSetupMessage) {
   return headerLen + msgLen;
 }
 
+serialize_return_t serialize(ds::chunk &c,
+                             const rvn::GoAwayMessage &goAwayMessage) {
+  std::uint64_t msgLen = 0;
+  msgLen +=
+      mock_serialize<ds::quic_var_int>(goAwayMessage.newSessionURI_.size());
+  msgLen += goAwayMessage.newSessionURI_.size();
+
+  std::uint64_t headerLen = 0;
+  headerLen += serialize<ds::quic_var_int>(
+      c, utils::to_underlying(MoQtMessageType::GOAWAY));
+  headerLen += serialize<ds::quic_var_int>(c, msgLen);
+
+  serialize<ds::quic_var_int>(c, goAwayMessage.newSessionURI_.size());
+  c.append(goAwayMessage.newSessionURI_.data(),
+           goAwayMessage.newSessionURI_.size());
+
+  return headerLen + msgLen;
+}
+
 static serialize_return_t
 mock_serialize(const rvn::SubscribeMessage &subscribeMessage) {
   std::uint64_t msgLen = 0;
@@ -203,17 +249,94 @@ serialize_return_t serialize(ds::chunk &c,
   return headerLen + msgLen;
 }
 
-serialize_return_t serialize(ds::chunk &c,
-                             const StreamHeaderSubgroupMessage &msg) {
+static serialize_return_t
+mock_serialize(const rvn::FetchMessage &fetchMessage) {
   std::uint64_t msgLen = 0;
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.subscribeId_);
+
+  msgLen +=
+      mock_serialize<ds::quic_var_int>(fetchMessage.trackNamespace_.size());
+  for (const auto &ns : fetchMessage.trackNamespace_) {
+    msgLen += mock_serialize<ds::quic_var_int>(ns.size());
+    msgLen += ns.size();
+  }
+
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.trackName_.size());
+  msgLen += fetchMessage.trackName_.size();
+
+  msgLen += mock_serialize<std::uint8_t>(fetchMessage.subscriberPriority_);
+  msgLen += mock_serialize<std::uint8_t>(fetchMessage.groupOrder_);
+
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.start_.group_.get());
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.start_.object_.get());
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.end_.group_.get());
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.end_.object_.get());
+
+  msgLen += mock_serialize<ds::quic_var_int>(fetchMessage.parameters_.size());
+  for (const auto &parameter : fetchMessage.parameters_)
+    msgLen += mock_serialize(parameter);
+
+  return msgLen;
+}
+
+serialize_return_t serialize(ds::chunk &c,
+                             const rvn::FetchMessage &fetchMessage) {
+  std::uint64_t msgLen = mock_serialize(fetchMessage);
 
   // header
-  msgLen += serialize<ds::quic_var_int>(c, utils::to_underlying(msg.id_));
+  std::uint64_t headerLen = 0;
+  headerLen += serialize<ds::quic_var_int>(
+      c, utils::to_underlying(MoQtMessageType::FETCH));
+  headerLen += serialize<ds::quic_var_int>(c, msgLen);
 
   // body
-  msgLen += serialize<ds::quic_var_int>(c, msg.trackAlias_.get());
-  msgLen += serialize<ds::quic_var_int>(c, msg.groupId_.get());
-  msgLen += serialize<ds::quic_var_int>(c, msg.subgroupId_.get());
+  serialize<ds::quic_var_int>(c, fetchMessage.subscribeId_);
+
+  serialize<ds::quic_var_int>(c, fetchMessage.trackNamespace_.size());
+  for (const auto &ns : fetchMessage.trackNamespace_) {
+    serialize<ds::quic_var_int>(c, ns.size());
+    c.append(ns.data(), ns.size());
+  }
+
+  serialize<ds::quic_var_int>(c, fetchMessage.trackName_.size());
+  c.append(fetchMessage.trackName_.data(), fetchMessage.trackName_.size());
+
+  serialize<std::uint8_t>(c, fetchMessage.subscriberPriority_);
+  serialize<std::uint8_t>(c, fetchMessage.groupOrder_);
+
+  serialize<ds::quic_var_int>(c, fetchMessage.start_.group_.get());
+  serialize<ds::quic_var_int>(c, fetchMessage.start_.object_.get());
+  serialize<ds::quic_var_int>(c, fetchMessage.end_.group_.get());
+  serialize<ds::quic_var_int>(c, fetchMessage.end_.object_.get());
+
+  serialize<ds::quic_var_int>(c, fetchMessage.parameters_.size());
+  for (const auto &parameter : fetchMessage.parameters_)
+    serialize(c, parameter);
+
+  return headerLen + msgLen;
+}
+
+// consecutive varints of data stream messages are encoded together with the
+// batch codec and appended with one copy
+template <std::size_t N>
+static serialize_return_t
+serialize_quic_var_ints(ds::chunk &c,
+                        const std::array<std::uint64_t, N> &values) {
+  std::array<std::uint8_t, max_encoded_size(N)> encoded;
+  std::uint64_t numBytes =
+      encode_quic_var_ints(encoded.data(), values).numBytes_;
+  c.append(encoded.data(), numBytes);
+  return numBytes;
+}
+
+serialize_return_t serialize(ds::chunk &c,
+                             const StreamHeaderSubgroupMessage &msg) {
+  std::uint64_t msgLen = 0;
+
+  // header and body
+  msgLen += serialize_quic_var_ints<4>(
+      c, {utils::to_underlying(msg.id_), msg.trackAlias_.get(),
+          msg.groupId_.get(), msg.subgroupId_.get()});
   msgLen += serialize<std::uint8_t>(c, msg.publisherPriority_);
 
   return msgLen;
@@ -232,9 +355,86 @@ serialize_return_t serialize(ds::chunk &c,
   // no header for object messages
 
   // body
-  serialize<ds::quic_var_int>(c, msg.objectId_);
-  serialize<ds::quic_var_int>(c, msg.payload_.size());
+  serialize_quic_var_ints<2>(c, {msg.objectId_, msg.payload_.size()});
+  c.append(msg.payload_.data(), msg.payload_.size());
+
+  return msgLen;
+}
+
+serialize_return_t serialize(ds::chunk &c,
+                             const StreamHeaderTrackMessage &msg) {
+  std::uint64_t msgLen = 0;
+
+  // header
+  msgLen += serialize<ds::quic_var_int>(c, utils::to_underlying(msg.id_));
+
+  // body
+  msgLen += serialize<ds::quic_var_int>(c, msg.trackAlias_.get());
+  msgLen += serialize<std::uint8_t>(c, msg.publisherPriority_);
+
+  return msgLen;
+}
+
+serialize_return_t serialize(ds::chunk &c,
+                             const TrackStreamObjectMessage &msg) {
+  std::uint64_t msgLen = 0;
+
+  // no header for object messages
+
+  // body
+  msgLen += serialize_quic_var_ints<3>(
+      c, {msg.groupId_.get(), msg.objectId_.get(), msg.payload_.size()});
+  c.append(msg.payload_.data(), msg.payload_.size());
+  msgLen += msg.payload_.size();
+
+  return msgLen;
+}
+
+serialize_return_t serialize(ds::chunk &c, const FetchHeaderMessage &msg) {
+  // header and body
+  return serialize_quic_var_ints<2>(
+      c, {utils::to_underlying(msg.id_), msg.subscribeId_});
+}
+
+serialize_return_t serialize(ds::chunk &c, const FetchObjectMessage &msg) {
+  std::uint64_t msgLen = 0;
+
+  // no header for object messages
+
+  // body
+  msgLen += serialize_quic_var_ints<2>(
+      c, {msg.groupId_.get(), msg.subgroupId_.get()});
+  msgLen += serialize<std::uint8_t>(c, msg.publisherPriority_);
+  msgLen += serialize_quic_var_ints<2>(
+      c, {msg.objectId_.get(), msg.payload_.size()});
+  c.append(msg.payload_.data(), msg.payload_.size());
+  msgLen += msg.payload_.size();
+
+  return msgLen;
+}
+
+serialize_return_t serialize_header(ds::chunk &c,
+                                    const ObjectDatagramMessage &msg) {
+  std::uint64_t msgLen = 0;
+
+  // header
+  msgLen += serialize<ds::quic_var_int>(c, utils::to_underlying(msg.id_));
+
+  // body till the payload
+  msgLen += serialize<ds::quic_var_int>(c, msg.trackAlias_.get());
+  msgLen += serialize<ds::quic_var_int>(c, msg.groupId_.get());
+  msgLen += serialize<ds::quic_var_int>(c, msg.objectId_.get());
+  msgLen += serialize<std::uint8_t>(c, msg.publisherPriority_);
+
+  return msgLen;
+}
+
+serialize_return_t serialize(ds::chunk &c, const ObjectDatagramMessage &msg) {
+  std::uint64_t msgLen = serialize_header(c, msg);
+
+  msgLen += serialize<ds::quic_var_int>(c, msg.payload_.size());
   c.append(msg.payload_.data(), msg.payload_.size());
+  msgLen += msg.payload_.size();
 
   return msgLen;
 }
@@ -1,8 +1,11 @@
 /////////////////////////////////////////////
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 #include <unistd.h>
 #include <variant>
 /////////////////////////////////////////////
@@ -18,57 +21,96 @@
 
 namespace rvn {
 
-MinorSubscriptionState::MinorSubscriptionState(
-    SubscriptionState &subscriptionState, ObjectIdentifier objectToSend,
-    std::optional<ObjectIdentifier> lastObjectToBeSent, bool mustBeSent,
-    std::optional<std::chrono::milliseconds> deliveryTimeout)
-    : subscriptionState_(std::addressof(subscriptionState)),
-      objectToSend_(std::move(objectToSend)),
-      lastObjectToBeSent_(std::move(lastObjectToBeSent)),
-      mustBeSent_(mustBeSent), subscribeDeliveryTimeout(deliveryTimeout) {}
-
-bool MinorSubscriptionState::is_waiting_for_object() {
-  if (!objectWaitSignal_.has_value())
-    // not waiting on object to be ready
-    return true;
-
-  // we wait on the flag, only is flag is ready, we do acquire operation
-  // might have performance benefits on weaker memory models (ARM, POWERPC...)
-  return (*objectWaitSignal_)->load(std::memory_order_relaxed) ==
-         ObjectWaitStatus::Ready;
-
-  // We only return that it is true, we have to reset the flag in the
-  // fulfill_some_minor function and also have an acquire load on the flag
+void MinorSubscriptionTable::add_row(SubscriptionState &subscriptionState,
+                                     SubscriptionTask task) {
+  // coroutine starts suspended, it runs in the next pass
+  waitFlags_.push_back(nullptr);
+  tasks_.push_back(std::move(task));
+  subscriptionStates_.push_back(std::addressof(subscriptionState));
 }
 
-// returns true if fulfilling is done
-FulfillSomeReturn MinorSubscriptionState::fulfill_some_minor() {
-  if (objectWaitSignal_.has_value()) {
-    // we have to reset the flag
-    (*objectWaitSignal_)->load(std::memory_order_acquire);
-    objectWaitSignal_.reset();
-  }
+void MinorSubscriptionTable::remove_row(std::size_t row) {
+  auto removeFromColumn = [row](auto &column) {
+    if (row + 1 != column.size())
+      column[row] = std::move(column.back());
+    column.pop_back();
+  };
+
+  removeFromColumn(waitFlags_);
+  // destroys the coroutine frame
+  removeFromColumn(tasks_);
+  removeFromColumn(subscriptionStates_);
+}
 
-  auto connectionStateSharedPtr =
-      subscriptionState_->connectionStateWeakPtr_.lock();
-  if (!connectionStateSharedPtr)
-    return SubscriptionStateErr::ConnectionExpired{};
+void MinorSubscriptionTable::remove_rows(
+    const SubscriptionState &subscriptionState) {
+  // traverse backwards, rows moved in place of removed rows have already been
+  // looked at
+  for (std::size_t row = size(); row-- > 0;)
+    if (subscriptionStates_[row] == std::addressof(subscriptionState))
+      remove_row(row);
+}
 
-  auto objectOrStatus =
-      subscriptionState_->dataManager_->get_object(objectToSend_);
+std::optional<FulfillSomeReturn>
+MinorSubscriptionTable::resume(std::size_t row) {
+  SubscriptionTask::Handle handle = tasks_[row].handle();
+
+  handle.promise().waitFlag_ = nullptr;
+  handle.resume();
+
+  if (handle.done())
+    return std::move(handle.promise().result_);
+
+  waitFlags_[row] = handle.promise().waitFlag_;
+  return std::nullopt;
+}
+
+SubscriptionTask SubscriptionState::fulfill_minor_subscription(
+    ObjectIdentifier objectToSend,
+    std::optional<ObjectIdentifier> lastObjectToBeSent, bool mustBeSent,
+    std::optional<std::chrono::milliseconds> subscribeDeliveryTimeout) {
+  DataManager &dataManager = *dataManager_;
+  const SendBudget &sendBudget = subscriptionManager_->get_send_budget();
+  // only the latest object matters if objects need not be sent, so there is
+  // no point in batching them
+  const std::size_t maxObjects = mustBeSent ? sendBudget.maxObjects_ : 1;
+  const TrackAlias trackAlias = subscriptionMessage_.trackAlias_;
+
+  std::optional<ObjectIdentifier> previouslySentObject;
+
+  while (true) {
+    std::optional<ObjectOrStatus> cachedObjectOrStatus =
+        dataManager.get_cached_object(objectToSend);
+
+    // objects which are not published yet get their wait signal registered
+    // by get_cached_object, only stored objects whose buffer is not cached go
+    // to the disk thread
+    ObjectOrStatus objectOrStatus =
+        cachedObjectOrStatus.has_value()
+            ? std::move(*cachedObjectOrStatus)
+            : co_await DiskRead(subscriptionManager_->get_disk_read_queue(),
+                                dataManager, objectToSend);
+
+    if (std::holds_alternative<DoesNotExist>(objectOrStatus))
+      co_return SubscriptionStateErr::ObjectDoesNotExist{};
+    else if (std::holds_alternative<ObjectWaitSignal>(objectOrStatus)) {
+      co_await ObjectReady(
+          std::move(std::get<ObjectWaitSignal>(objectOrStatus)));
+      continue;
+    }
+
+    ObjectWaitSignal sendWindowSignal;
+    if (auto connectionStateSharedPtr = connectionStateWeakPtr_.lock())
+      sendWindowSignal = connectionStateSharedPtr->get_send_window_signal();
+    else
+      co_return SubscriptionStateErr::ConnectionExpired{};
+
+    // we must not hold on to the connection while suspended
+    co_await SendWindow(std::move(sendWindowSignal));
 
-  if (std::holds_alternative<DoesNotExist>(objectOrStatus))
-    return SubscriptionStateErr::ObjectDoesNotExist{};
-  else if (std::holds_alternative<ObjectWaitSignal>(objectOrStatus)) {
-    objectWaitSignal_ = std::move(std::get<ObjectWaitSignal>(objectOrStatus));
-    return false;
-  } else {
     auto [quicBuffer, objectDeliveryTimeout] =
         std::get<ObjectType>(objectOrStatus);
 
-    if ((!mustBeSent_) && previouslySentObject_.has_value())
-      connectionStateSharedPtr->abort_if_sending(*previouslySentObject_);
-
     if (!objectDeliveryTimeout)
       // now both have value, or neither has value
       objectDeliveryTimeout = subscribeDeliveryTimeout;
@@ -80,57 +122,366 @@ FulfillSomeReturn MinorSubscriptionState::fulfill_some_minor() {
       if (*objectDeliveryTimeout > *subscribeDeliveryTimeout)
         *objectDeliveryTimeout = *subscribeDeliveryTimeout;
 
-    QUIC_STATUS status = connectionStateSharedPtr->send_object(
-        objectToSend_, quicBuffer, objectDeliveryTimeout);
-    if (QUIC_FAILED(status))
-      return SubscriptionStateErr::ConnectionExpired{};
+    bool fulfilled = false;
+    // next object is not published yet
+    std::optional<ObjectWaitSignal> nextObjectWaitSignal;
+
+    {
+      auto connectionStateSharedPtr = connectionStateWeakPtr_.lock();
+      if (!connectionStateSharedPtr)
+        co_return SubscriptionStateErr::ConnectionExpired{};
+
+      // only enhancement layers are dropped, base layers are needed to decode
+      // the layers which depend on them
+      // a track stream carries all later objects too, so it is never aborted
+      if ((!mustBeSent) && deliveryMode_ != DeliveryMode::Track &&
+          previouslySentObject.has_value() &&
+          dataManager.get_layer_type(*previouslySentObject) != LayerType::Base)
+        connectionStateSharedPtr->abort_if_sending(
+            trackAlias, previouslySentObject->get_subgroup_id(dataManager),
+            *previouslySentObject);
+
+      // reused across calls to avoid allocating on every iteration, we do not
+      // suspend while the batch is being built
+      static thread_local std::vector<QUIC_BUFFER *> sendBatch;
+      sendBatch.clear();
+      std::size_t sendBatchBytes = 0;
+
+      // all objects in a batch have to go on the same stream, that is belong
+      // to the same subgroup. The subgroup is looked up once, later objects
+      // are checked against its range without going through the hierarchy
+      GroupId batchGroupId = objectToSend.groupId_;
+      auto batchGroupHandle = dataManager.get_group_handle(objectToSend).lock();
+      if (!batchGroupHandle)
+        throw std::invalid_argument("GroupHandle is null");
+      GroupHandle::SubgroupRange batchSubgroup =
+          batchGroupHandle->get_subgroup_range(objectToSend.objectId_);
+      SubGroupId batchSubgroupId = batchSubgroup.subgroupId_;
+
+      while (true) {
+        sendBatch.push_back(quicBuffer);
+        sendBatchBytes += quicBuffer->Length;
+
+        if (previouslySentObject.has_value()) {
+          // we do not want to copy because copying track identifier is rather
+          // expensive operation (seq cst atomic add of shared_ptr)
+          previouslySentObject->groupId_ = objectToSend.groupId_;
+          previouslySentObject->objectId_ = objectToSend.objectId_;
+        } else
+          previouslySentObject = objectToSend;
+
+        bool canAdavance = dataManager.next(objectToSend);
+
+        if (!canAdavance || (lastObjectToBeSent.has_value() &&
+                             objectToSend == *lastObjectToBeSent)) {
+          fulfilled = true;
+          break;
+        }
+
+        if (objectToSend.groupId_ != batchGroupId ||
+            sendBatch.size() >= maxObjects)
+          break;
+
+        auto nextObjectOrStatus = dataManager.get_cached_object(objectToSend);
+
+        // not cached objects and DoesNotExist are dealt with in the next
+        // iteration, we still want to send what we have batched till now
+        if (!nextObjectOrStatus.has_value())
+          break;
+        if (std::holds_alternative<ObjectWaitSignal>(*nextObjectOrStatus)) {
+          nextObjectWaitSignal =
+              std::move(std::get<ObjectWaitSignal>(*nextObjectOrStatus));
+          break;
+        } else if (!std::holds_alternative<ObjectType>(*nextObjectOrStatus))
+          break;
+
+        // checked once the object is cached, so an open ended subgroup which
+        // was followed by another one before the object was published is
+        // seen as ended
+        if (!batchGroupHandle->in_subgroup_range(batchSubgroup,
+                                                 objectToSend.objectId_))
+          break;
+
+        quicBuffer = std::get<0>(std::get<ObjectType>(*nextObjectOrStatus));
+        if (sendBatchBytes + quicBuffer->Length > sendBudget.maxBytes_)
+          break;
+      }
 
-    if (previouslySentObject_.has_value()) {
-      // we do not want to copy because copying track identifier is rather
-      // expensive operation (seq cst atomic add of shared_ptr)
-      previouslySentObject_->groupId_ = objectToSend_.groupId_;
-      previouslySentObject_->objectId_ = objectToSend_.objectId_;
-    } else
-      previouslySentObject_ = objectToSend_;
+      if (deliveryMode_ == DeliveryMode::Datagram) {
+        PublisherPriority publisherPriority =
+            dataManager.get_publisher_priority(*previouslySentObject).value();
+
+        // objects which do not fit in a datagram stay in the batch and are
+        // sent on the stream of their subgroup
+        std::size_t numStreamObjects = 0;
+        for (QUIC_BUFFER *object : sendBatch) {
+          QUIC_STATUS status = connectionStateSharedPtr->send_datagram(
+              trackAlias, batchGroupId, publisherPriority, object);
+          if (status == QUIC_STATUS_BUFFER_TOO_SMALL)
+            sendBatch[numStreamObjects++] = object;
+          else if (QUIC_FAILED(status))
+            co_return SubscriptionStateErr::ConnectionExpired{};
+        }
+        sendBatch.resize(numStreamObjects);
+      }
+
+      // previouslySentObject is the last object in the batch, it is in the
+      // same subgroup as the rest of the batch
+      if (!sendBatch.empty()) {
+        QUIC_STATUS status =
+            deliveryMode_ == DeliveryMode::Track
+                ? connectionStateSharedPtr->send_track_objects(
+                      trackAlias, *previouslySentObject, sendBatch, true)
+                : connectionStateSharedPtr->send_objects(
+                      trackAlias, batchSubgroupId, *previouslySentObject,
+                      sendBatch, objectDeliveryTimeout, true);
+        // the peer does not want the objects of this stream (STOP_SENDING),
+        // only this minor subscription ends
+        if (status == ConnectionState::StreamShutdownStatus)
+          co_return true;
+        if (QUIC_FAILED(status))
+          co_return SubscriptionStateErr::ConnectionExpired{};
+
+        // flushed at the end of the pass
+        if (connectionStateSharedPtr->set_flush_pending())
+          connectionsToFlush_->push_back(connectionStateWeakPtr_);
+      }
+    }
 
-    bool canAdavance = subscriptionState_->dataManager_->next(objectToSend_);
+    if (fulfilled)
+      co_return true;
 
-    if (!canAdavance)
-      return true;
-    return (lastObjectToBeSent_.has_value() &&
-            objectToSend_ == *lastObjectToBeSent_);
+    if (nextObjectWaitSignal.has_value())
+      co_await ObjectReady(std::move(*nextObjectWaitSignal));
+    else
+      // give other minor subscriptions a turn
+      co_await Yield{};
   }
 }
 
-// returns true if fulfilling is done
-FulfillSomeReturn SubscriptionState::fulfill_some() {
-  bool allFulfilled = true;
-  auto beginIter = minorSubscriptionStates_.begin();
-  auto endIter = minorSubscriptionStates_.end();
+// exclusive end of the objects of the group which are part of the fetch,
+// nullopt if the group has no objects
+static std::optional<ObjectId>
+fetch_group_end(DataManager &dataManager,
+                const GroupIdentifier &groupIdentifier,
+                const GroupObjectPair &end) {
+  std::optional<ObjectId> groupEnd =
+      dataManager.get_latest_registered_object(groupIdentifier);
+  // end object 0 is the whole end group
+  if (groupEnd.has_value() && groupIdentifier.groupId_ == end.group_ &&
+      end.object_ != ObjectId(0))
+    groupEnd = std::min(*groupEnd, end.object_);
+  return groupEnd;
+}
 
-  for (auto traversalIter = beginIter; traversalIter != endIter;
-       ++traversalIter) {
-    // by default we assume that minor subscriptions is not fulfilled
-    FulfillSomeReturn fulfillReturn = false;
+// moves objectToSend to the first object of the next group of the fetch which
+// has objects, returns the end of that group, nullopt once the range is done
+static std::optional<ObjectId>
+next_fetch_group(DataManager &dataManager, ObjectIdentifier &objectToSend,
+                 const GroupObjectPair &end) {
+  while (true) {
+    std::optional<GroupId> nextGroupId =
+        dataManager.get_next_group(objectToSend);
+    if (!nextGroupId.has_value() || *nextGroupId > end.group_)
+      return std::nullopt;
+    objectToSend.groupId_ = *nextGroupId;
+
+    std::optional<ObjectId> firstObjectId =
+        dataManager.get_first_object(objectToSend);
+    std::optional<ObjectId> groupEnd =
+        fetch_group_end(dataManager, objectToSend, end);
+    if (firstObjectId.has_value() && groupEnd.has_value() &&
+        *firstObjectId < *groupEnd) {
+      objectToSend.objectId_ = *firstObjectId;
+      return groupEnd;
+    }
+  }
+}
 
-    // not waiting on object to be ready or waiting on it and it is ready
-    // basically the mathematical logical statement: (waiting -> ready)
-    if (traversalIter->is_waiting_for_object())
-      fulfillReturn = traversalIter->fulfill_some_minor();
+SubscriptionTask SubscriptionState::fulfill_fetch(std::uint64_t subscribeId,
+                                                  ObjectIdentifier objectToSend,
+                                                  ObjectId groupEnd,
+                                                  GroupObjectPair end) {
+  DataManager &dataManager = *dataManager_;
+  const SendBudget &sendBudget = subscriptionManager_->get_send_budget();
 
-    if (std::holds_alternative<bool>(fulfillReturn)) {
-      if (std::get<bool>(fulfillReturn) == false) {
-        if (beginIter != traversalIter)
-          *beginIter = std::move(*traversalIter);
-        ++beginIter;
-        allFulfilled = false;
+  while (true) {
+    std::optional<ObjectOrStatus> cachedObjectOrStatus =
+        dataManager.get_cached_object(objectToSend);
+
+    // objects which are not published yet get their wait signal registered
+    // by get_cached_object, only stored objects whose buffer is not cached go
+    // to the disk thread
+    ObjectOrStatus objectOrStatus =
+        cachedObjectOrStatus.has_value()
+            ? std::move(*cachedObjectOrStatus)
+            : co_await DiskRead(subscriptionManager_->get_disk_read_queue(),
+                                dataManager, objectToSend);
+
+    if (std::holds_alternative<DoesNotExist>(objectOrStatus)) {
+      // the stream is ended so that the client is not left waiting on the
+      // rest of the range
+      if (auto connectionStateSharedPtr = connectionStateWeakPtr_.lock())
+        connectionStateSharedPtr->send_fetch_objects(
+            subscribeId, objectToSend.groupId_, SubGroupId(0),
+            PublisherPriority(0), {}, true);
+      co_return SubscriptionStateErr::ObjectDoesNotExist{};
+    } else if (std::holds_alternative<ObjectWaitSignal>(objectOrStatus)) {
+      // registered but not published yet
+      co_await ObjectReady(
+          std::move(std::get<ObjectWaitSignal>(objectOrStatus)));
+      continue;
+    }
+
+    ObjectWaitSignal sendWindowSignal;
+    if (auto connectionStateSharedPtr = connectionStateWeakPtr_.lock())
+      sendWindowSignal = connectionStateSharedPtr->get_send_window_signal();
+    else
+      co_return SubscriptionStateErr::ConnectionExpired{};
+
+    // we must not hold on to the connection while suspended
+    co_await SendWindow(std::move(sendWindowSignal));
+
+    QUIC_BUFFER *quicBuffer = std::get<0>(std::get<ObjectType>(objectOrStatus));
+
+    bool fulfilled = false;
+    // next object is not published yet
+    std::optional<ObjectWaitSignal> nextObjectWaitSignal;
+
+    {
+      auto connectionStateSharedPtr = connectionStateWeakPtr_.lock();
+      if (!connectionStateSharedPtr)
+        co_return SubscriptionStateErr::ConnectionExpired{};
+
+      // reused across calls to avoid allocating on every iteration, we do not
+      // suspend while the batch is being built
+      static thread_local std::vector<QUIC_BUFFER *> sendBatch;
+      sendBatch.clear();
+      std::size_t sendBatchBytes = 0;
+
+      // objects of a batch share the group id, subgroup id and publisher
+      // priority which precede them on the stream, the subgroup is looked up
+      // once and later objects are checked against its range
+      GroupId batchGroupId = objectToSend.groupId_;
+      auto batchGroupHandle = dataManager.get_group_handle(objectToSend).lock();
+      if (!batchGroupHandle)
+        throw std::invalid_argument("GroupHandle is null");
+      GroupHandle::SubgroupRange batchSubgroup =
+          batchGroupHandle->get_subgroup_range(objectToSend.objectId_);
+      SubGroupId batchSubgroupId = batchSubgroup.subgroupId_;
+      PublisherPriority batchPublisherPriority =
+          dataManager.get_publisher_priority(objectToSend).value();
+
+      while (true) {
+        sendBatch.push_back(quicBuffer);
+        sendBatchBytes += quicBuffer->Length;
+
+        objectToSend.objectId_ = objectToSend.objectId_ + ObjectId(1);
+        if (objectToSend.objectId_ == groupEnd) {
+          std::optional<ObjectId> nextGroupEnd =
+              next_fetch_group(dataManager, objectToSend, end);
+          if (!nextGroupEnd.has_value()) {
+            fulfilled = true;
+            break;
+          }
+          groupEnd = *nextGroupEnd;
+        }
+
+        if (objectToSend.groupId_ != batchGroupId ||
+            sendBatch.size() >= sendBudget.maxObjects_)
+          break;
+
+        auto nextObjectOrStatus = dataManager.get_cached_object(objectToSend);
+
+        // not cached objects and DoesNotExist are dealt with in the next
+        // iteration, we still want to send what we have batched till now
+        if (!nextObjectOrStatus.has_value())
+          break;
+        if (std::holds_alternative<ObjectWaitSignal>(*nextObjectOrStatus)) {
+          nextObjectWaitSignal =
+              std::move(std::get<ObjectWaitSignal>(*nextObjectOrStatus));
+          break;
+        } else if (!std::holds_alternative<ObjectType>(*nextObjectOrStatus))
+          break;
+
+        // checked once the object is cached, so an open ended subgroup which
+        // was followed by another one before the object was published is
+        // seen as ended
+        if (!batchGroupHandle->in_subgroup_range(batchSubgroup,
+                                                 objectToSend.objectId_))
+          break;
+
+        quicBuffer = std::get<0>(std::get<ObjectType>(*nextObjectOrStatus));
+        if (sendBatchBytes + quicBuffer->Length > sendBudget.maxBytes_)
+          break;
       }
-    } else
-      return fulfillReturn;
+
+      QUIC_STATUS status = connectionStateSharedPtr->send_fetch_objects(
+          subscribeId, batchGroupId, batchSubgroupId, batchPublisherPriority,
+          sendBatch, fulfilled, true);
+      // the client stopped the fetch stream, there is nobody to send the rest
+      // of the range to
+      if (status == ConnectionState::StreamShutdownStatus)
+        co_return true;
+      if (QUIC_FAILED(status))
+        co_return SubscriptionStateErr::ConnectionExpired{};
+
+      // flushed at the end of the pass
+      if (connectionStateSharedPtr->set_flush_pending())
+        connectionsToFlush_->push_back(connectionStateWeakPtr_);
+    }
+
+    if (fulfilled)
+      co_return true;
+
+    if (nextObjectWaitSignal.has_value())
+      co_await ObjectReady(std::move(*nextObjectWaitSignal));
+    else
+      // give other minor subscriptions a turn
+      co_await Yield{};
   }
+}
 
-  minorSubscriptionStates_.erase(beginIter, endIter);
-  return allFulfilled;
+void SubscriptionState::discover_new_groups() {
+  auto &discoveryState = *groupDiscoveryState_;
+
+  // cheap check, we only look at the group map if something has changed
+  std::uint64_t groupSequence =
+      discoveryState.groupSequence_->load(std::memory_order_acquire);
+  if (groupSequence == discoveryState.lastSeenGroupSequence_)
+    return;
+  // recorded before looking at the groups, a bump while we look makes the
+  // next call look again
+  discoveryState.lastSeenGroupSequence_ = groupSequence;
+
+  auto trackHandleSharedPtr = discoveryState.trackHandle_.lock();
+  if (!trackHandleSharedPtr)
+    return;
+
+  std::shared_lock l(trackHandleSharedPtr->groupHandlesMtx_);
+  auto &groupHandles = trackHandleSharedPtr->groupHandles_;
+
+  // groups which were empty might have subgroups now
+  std::erase_if(discoveryState.emptyGroups_,
+                [&](const GroupDiscoveryState::EmptyGroup &emptyGroup) {
+                  auto groupHandleIter = groupHandles.find(emptyGroup.groupId_);
+                  if (groupHandleIter == groupHandles.end())
+                    return true;
+
+                  return std::holds_alternative<bool>(add_group_subscription(
+                      *groupHandleIter->second, true,
+                      emptyGroup.deliveryTimeout_, emptyGroup.beginObjectId_));
+                });
+
+  for (auto groupHandleIter =
+           groupHandles.upper_bound(discoveryState.lastDiscoveredGroupId_);
+       groupHandleIter != groupHandles.end(); ++groupHandleIter) {
+    if (!std::holds_alternative<bool>(
+            add_group_subscription(*groupHandleIter->second, true)))
+      discoveryState.emptyGroups_.push_back({groupHandleIter->first, {}, {}});
+
+    discoveryState.lastDiscoveredGroupId_ = groupHandleIter->first;
+  }
 }
 
 FulfillSomeReturn SubscriptionState::add_group_subscription(
@@ -150,10 +501,12 @@ FulfillSomeReturn SubscriptionState::add_group_subscription(
   if (endObjectId == std::nullopt)
     return SubscriptionStateErr::ObjectDoesNotExist{};
 
-  minorSubscriptionStates_.emplace_back(
-      *this, ObjectIdentifier(groupHandle.groupIdentifier_, *beginObjectId),
-      ObjectIdentifier(groupHandle.groupIdentifier_, *endObjectId), mustBeSent,
-      deliveryTimeout);
+  minorSubscriptionTable_->add_row(
+      *this, fulfill_minor_subscription(
+                 ObjectIdentifier(groupHandle.groupIdentifier_, *beginObjectId),
+                 ObjectIdentifier(groupHandle.groupIdentifier_, *endObjectId),
+                 mustBeSent, deliveryTimeout));
+  ++numMinorSubscriptions_;
 
   return false;
 }
@@ -161,11 +514,21 @@ FulfillSomeReturn SubscriptionState::add_group_subscription(
 SubscriptionState::SubscriptionState(
     std::weak_ptr<ConnectionState> &&connectionState, DataManager &dataManager,
     SubscriptionManager &subscriptionManager,
+    MinorSubscriptionTable &minorSubscriptionTable,
+    std::vector<std::weak_ptr<ConnectionState>> &connectionsToFlush,
     SubscribeMessage subscriptionMessage)
     : connectionStateWeakPtr_(std::move(connectionState)),
       dataManager_(std::addressof(dataManager)),
       subscriptionManager_(std::addressof(subscriptionManager)),
-      subscriptionMessage_(std::move(subscriptionMessage)), cleanup_(false) {
+      minorSubscriptionTable_(std::addressof(minorSubscriptionTable)),
+      numMinorSubscriptions_(0),
+      connectionsToFlush_(std::addressof(connectionsToFlush)),
+      subscriptionMessage_(std::move(subscriptionMessage)),
+      deliveryMode_(
+          subscriptionMessage_.get_parameter<DeliveryModeParameter>()
+              .value_or(DeliveryModeParameter{DeliveryMode::Subgroup})
+              .mode_),
+      cleanup_(false) {
   auto filterType = subscriptionMessage_.filterType_;
   auto connectionStateSharedPtr = connectionStateWeakPtr_.lock();
 
@@ -256,12 +619,34 @@ SubscriptionState::SubscriptionState(
         return;
       }
 
-      add_group_subscription(*groupHandleIter->second, true, deliveryTimeoutOpt,
-                             subscriptionMessage_.start_->object_);
+      /*
+          groups are added under the writer lock, so every group counted in
+          the sequence is seen below. Subgroups are added under the lock of
+          their group only, so the sequence can move on while we look at the
+          groups. That only makes the next discover_new_groups look again, a
+          subgroup is inserted before its bump is released, so a group we
+          see as empty is retried once its subgroup is counted
+      */
+      groupDiscoveryState_.emplace(GroupDiscoveryState{
+          trackHandle, trackHandleSharedPtr->groupSequence_,
+          trackHandleSharedPtr->groupSequence_->load(
+              std::memory_order_acquire),
+          trackHandleSharedPtr->groupHandles_.rbegin()->first,
+          {}});
+
+      if (!std::holds_alternative<bool>(add_group_subscription(
+              *groupHandleIter->second, true, deliveryTimeoutOpt,
+              subscriptionMessage_.start_->object_)))
+        groupDiscoveryState_->emptyGroups_.push_back(
+            {groupHandleIter->first, subscriptionMessage_.start_->object_,
+             deliveryTimeoutOpt});
       ++groupHandleIter;
       for (; groupHandleIter != trackHandleSharedPtr->groupHandles_.end();
            ++groupHandleIter)
-        add_group_subscription(*groupHandleIter->second, true);
+        if (!std::holds_alternative<bool>(
+                add_group_subscription(*groupHandleIter->second, true)))
+          groupDiscoveryState_->emptyGroups_.push_back(
+              {groupHandleIter->first, {}, {}});
     } else {
       subscriptionManager_->notify_subscription_error(*this);
       return;
@@ -317,7 +702,7 @@ SubscriptionState::SubscriptionState(
     if (auto trackHandleSharedPtr = trackHandle.lock()) {
       std::shared_lock l(trackHandleSharedPtr->groupHandlesMtx_);
       for (auto &groupHandleIter : trackHandleSharedPtr->groupHandles_)
-        // TODO: update it such that mustBeSent is true for base layers
+        // base layers are never aborted, see LayerType
         add_group_subscription(*groupHandleIter.second, false,
                                deliveryTimeoutOpt,
                                dataManager_->get_latest_concrete_object(
@@ -335,6 +720,176 @@ SubscriptionState::SubscriptionState(
   }
 }
 
+SubscriptionState::SubscriptionState(
+    std::weak_ptr<ConnectionState> &&connectionState, DataManager &dataManager,
+    SubscriptionManager &subscriptionManager,
+    MinorSubscriptionTable &minorSubscriptionTable,
+    std::vector<std::weak_ptr<ConnectionState>> &connectionsToFlush,
+    FetchMessage fetchMessage)
+    : connectionStateWeakPtr_(std::move(connectionState)),
+      dataManager_(std::addressof(dataManager)),
+      subscriptionManager_(std::addressof(subscriptionManager)),
+      minorSubscriptionTable_(std::addressof(minorSubscriptionTable)),
+      numMinorSubscriptions_(0),
+      connectionsToFlush_(std::addressof(connectionsToFlush)),
+      deliveryMode_(DeliveryMode::Subgroup), cleanup_(false) {
+  auto connectionStateSharedPtr = connectionStateWeakPtr_.lock();
+
+  if (!connectionStateSharedPtr) {
+    subscriptionManager_->mark_subscription_cleanup(*this);
+    return;
+  }
+
+  const GroupObjectPair &start = fetchMessage.start_;
+  const GroupObjectPair &end = fetchMessage.end_;
+  ObjectIdentifier objectToSend(
+      TrackIdentifier(std::move(fetchMessage.trackNamespace_),
+                      std::move(fetchMessage.trackName_)),
+      start.group_, start.object_);
+
+  // the start group might not exist or have no objects from the start object
+  std::optional<ObjectId> groupEnd;
+  if (auto firstObjectId = dataManager_->get_first_object(objectToSend)) {
+    objectToSend.objectId_ = std::max(objectToSend.objectId_, *firstObjectId);
+    groupEnd = fetch_group_end(*dataManager_, objectToSend, end);
+  }
+  if (!groupEnd.has_value() || objectToSend.objectId_ >= *groupEnd)
+    groupEnd = next_fetch_group(*dataManager_, objectToSend, end);
+  if (start.group_ > end.group_)
+    groupEnd.reset();
+
+  // nothing to send (or an unknown track), the client still gets the stream
+  // and sees the range end
+  if (!groupEnd.has_value()) {
+    connectionStateSharedPtr->send_fetch_objects(
+        fetchMessage.subscribeId_, start.group_, SubGroupId(0),
+        PublisherPriority(0), {}, true);
+    return;
+  }
+
+  minorSubscriptionTable_->add_row(
+      *this, fulfill_fetch(fetchMessage.subscribeId_, std::move(objectToSend),
+                           *groupEnd, end));
+  ++numMinorSubscriptions_;
+}
+
+void ThreadLocalState::add_subscription(
+    std::weak_ptr<ConnectionState> &&connectionStateWeakPtr,
+    SubscribeMessage &&subscriptionMessage) {
+  SubscriptionState *subscriptionState = subscriptionStates_.emplace(
+      std::move(connectionStateWeakPtr), subscriptionManager_.dataManager_,
+      subscriptionManager_, minorSubscriptionTable_, connectionsToFlush_,
+      std::move(subscriptionMessage));
+
+  if (subscriptionState->cleanup_ ||
+      (subscriptionState->numMinorSubscriptions_ == 0 &&
+       !subscriptionState->is_open_ended())) {
+    remove_subscription(*subscriptionState);
+    return;
+  }
+
+  if (subscriptionState->is_open_ended())
+    openEndedSubscriptions_.push_back(subscriptionState);
+}
+
+void ThreadLocalState::add_fetch(
+    std::weak_ptr<ConnectionState> &&connectionStateWeakPtr,
+    FetchMessage &&fetchMessage) {
+  SubscriptionState *subscriptionState = subscriptionStates_.emplace(
+      std::move(connectionStateWeakPtr), subscriptionManager_.dataManager_,
+      subscriptionManager_, minorSubscriptionTable_, connectionsToFlush_,
+      std::move(fetchMessage));
+
+  // a fetch is never open ended
+  if (subscriptionState->cleanup_ ||
+      subscriptionState->numMinorSubscriptions_ == 0)
+    remove_subscription(*subscriptionState);
+}
+
+void ThreadLocalState::remove_subscription(
+    SubscriptionState &subscriptionState) {
+  if (subscriptionState.numMinorSubscriptions_ != 0)
+    minorSubscriptionTable_.remove_rows(subscriptionState);
+
+  if (subscriptionState.is_open_ended()) {
+    auto iter = std::find(openEndedSubscriptions_.begin(),
+                          openEndedSubscriptions_.end(),
+                          std::addressof(subscriptionState));
+    if (iter != openEndedSubscriptions_.end()) {
+      *iter = openEndedSubscriptions_.back();
+      openEndedSubscriptions_.pop_back();
+    }
+  }
+
+  subscriptionStates_.erase(std::addressof(subscriptionState));
+}
+
+void ThreadLocalState::fulfill_some() {
+  for (std::size_t i = 0; i < openEndedSubscriptions_.size();) {
+    SubscriptionState &subscriptionState = *openEndedSubscriptions_[i];
+
+    // minor subscriptions are the ones which notice that the connection has
+    // expired, an open ended subscription with nothing to send has to check it
+    // itself
+    if (subscriptionState.numMinorSubscriptions_ == 0 &&
+        subscriptionState.connectionStateWeakPtr_.expired()) {
+      // last subscription is moved in place of this one
+      remove_subscription(subscriptionState);
+      continue;
+    }
+
+    subscriptionState.discover_new_groups();
+    ++i;
+  }
+
+  MinorSubscriptionTable &table = minorSubscriptionTable_;
+
+  // removed rows are replaced by the last row, so we only advance if the row
+  // is kept
+  for (std::size_t row = 0; row < table.size();) {
+    if (!table.is_ready(row)) {
+      ++row;
+      continue;
+    }
+
+    auto fulfillReturnOpt = table.resume(row);
+    if (!fulfillReturnOpt.has_value()) {
+      // suspended again
+      ++row;
+      continue;
+    }
+
+    SubscriptionState &subscriptionState = table.get_subscription_state(row);
+    auto &fulfillReturn = *fulfillReturnOpt;
+
+    if (std::holds_alternative<bool>(fulfillReturn)) {
+      table.remove_row(row);
+      if (--subscriptionState.numMinorSubscriptions_ == 0 &&
+          !subscriptionState.is_open_ended())
+        remove_subscription(subscriptionState);
+    } else if (std::holds_alternative<SubscriptionStateErr::ConnectionExpired>(
+                   fulfillReturn))
+      // connection is gone, nobody to notify
+      remove_subscription(subscriptionState);
+    else if (std::holds_alternative<SubscriptionStateErr::ObjectDoesNotExist>(
+                 fulfillReturn)) {
+      subscriptionManager_.notify_subscription_error(subscriptionState);
+      remove_subscription(subscriptionState);
+    } else
+      assert(false);
+  }
+
+  flush_connections();
+}
+
+void ThreadLocalState::flush_connections() {
+  for (auto &connectionStateWeakPtr : connectionsToFlush_)
+    if (auto connectionStateSharedPtr = connectionStateWeakPtr.lock())
+      connectionStateSharedPtr->flush_delayed_sends();
+
+  connectionsToFlush_.clear();
+}
+
 void ThreadLocalState::operator()() {
   while (true) {
     // relaxed load and store works because there is no data dependencies
@@ -353,55 +908,44 @@ void ThreadLocalState::operator()() {
     if (subscriptionQueue_.size_approx() != 0) {
       std::tuple<std::weak_ptr<ConnectionState>, SubscribeMessage>
           subscriptionTuple;
-      while (subscriptionQueue_.try_dequeue(subscriptionTuple)) {
-        auto connectionStateWeakPtr = std::move(std::get<0>(subscriptionTuple));
-        auto subscriptionMessage = std::move(std::get<1>(subscriptionTuple));
-
-        subscriptionStates_.emplace_back(std::move(connectionStateWeakPtr),
-                                         subscriptionManager_.dataManager_,
-                                         subscriptionManager_,
-                                         std::move(subscriptionMessage));
-        if (subscriptionStates_.back().cleanup_)
-          subscriptionStates_.pop_back();
-      }
+      while (subscriptionQueue_.try_dequeue(subscriptionTuple))
+        add_subscription(std::move(std::get<0>(subscriptionTuple)),
+                         std::move(std::get<1>(subscriptionTuple)));
     }
 
-    auto beginIter = subscriptionStates_.begin();
-    auto endIter = subscriptionStates_.end();
-
-    for (auto traversalIter = beginIter; traversalIter != endIter;
-         ++traversalIter) {
-      auto fulfillReturn = traversalIter->fulfill_some();
-
-      if (std::holds_alternative<bool>(fulfillReturn))
-      // subscription is being fulfilled with no issues
-      {
-        if (std::get<bool>(fulfillReturn) == false)
-          // This unfortunately does not seem to be using move constructor
-          // though (according to perf report)
-          // TODO: debug the issue
-          *beginIter++ = std::move(*traversalIter);
-      } else if (std::holds_alternative<
-                     SubscriptionStateErr::ConnectionExpired>(fulfillReturn)) {
-        // Nothing to be done
-      } else if (std::holds_alternative<
-                     SubscriptionStateErr::ObjectDoesNotExist>(fulfillReturn))
-        subscriptionManager_.notify_subscription_error(*traversalIter);
-      else
-        assert(false);
+    auto &fetchQueue = subscriptionManager_.fetchQueue_;
+    if (fetchQueue.size_approx() != 0) {
+      std::tuple<std::weak_ptr<ConnectionState>, FetchMessage> fetchTuple;
+      while (fetchQueue.try_dequeue(fetchTuple))
+        add_fetch(std::move(std::get<0>(fetchTuple)),
+                  std::move(std::get<1>(fetchTuple)));
     }
 
-    subscriptionStates_.erase(beginIter, endIter);
+    fulfill_some();
   }
 }
 
 SubscriptionManager::SubscriptionManager(DataManager &dataManager,
-                                         std::size_t numThreads)
-    : dataManager_(dataManager), cleanup_(false) {
+                                         std::size_t numThreads,
+                                         SendBudget sendBudget)
+    : dataManager_(dataManager), cleanup_(false), sendBudget_(sendBudget) {
+  diskReadThread_ = std::jthread([this]() {
+    while (true) {
+      std::shared_ptr<DiskReadRequest> diskReadRequest =
+          diskReadQueue_.wait_dequeue_ret();
+      // nullptr is enqueued by the destructor to wake us up
+      if (!diskReadRequest)
+        break;
+      (*diskReadRequest)();
+    }
+  });
+
   threadLocalStates_.reserve(numThreads);
   for (std::size_t i = 0; i < numThreads; i++) {
     threadLocalStates_.emplace_back(*this);
-    threadPool_.emplace_back(threadLocalStates_.back());
+    // threads run on the thread local states owned by the manager (reserved,
+    // so they do not move)
+    threadPool_.emplace_back(std::ref(threadLocalStates_.back()));
   }
 }
 
@@ -411,6 +955,7 @@ SubscriptionManager::~SubscriptionManager() {
   // cleanup_ it is just a single flag to be set, this might change if we are
   // doing more complex things before setting cleanup
   cleanup_.store(true, std::memory_order_relaxed);
+  diskReadQueue_.enqueue(nullptr);
 }
 
 void SubscriptionManager::add_subscription(
@@ -420,6 +965,13 @@ void SubscriptionManager::add_subscription(
                                              std::move(subscribeMessage)));
 }
 
+void SubscriptionManager::add_fetch(
+    std::weak_ptr<ConnectionState> connectionStateWeakPtr,
+    FetchMessage fetchMessage) {
+  fetchQueue_.enqueue(std::make_tuple(std::move(connectionStateWeakPtr),
+                                      std::move(fetchMessage)));
+}
+
 void SubscriptionManager::mark_subscription_cleanup(
     SubscriptionState &subscriptionState) {
   utils::LOG_EVENT(std::cout, "Marking subscription for cleanup",
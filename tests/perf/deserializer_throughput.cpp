@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <deserializer.hpp>
+#include <serialization/chunk.hpp>
+#include <serialization/messages.hpp>
+#include <serialization/serialization_impl.hpp>
+#include <wrappers.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+using namespace rvn::serialization;
+
+using SteadyClock = std::chrono::steady_clock;
+
+constexpr std::uint64_t numObjects = 20'000;
+constexpr std::size_t objectSize = 100;
+
+template <class... Ts> struct overloads : Ts... {
+  using Ts::operator()...;
+};
+
+static UniqueQuicBuffer make_quic_buffer(const std::uint8_t *data,
+                                         std::uint64_t length) {
+  QUIC_BUFFER *quicBuffer =
+      static_cast<QUIC_BUFFER *>(malloc(sizeof(QUIC_BUFFER) + length));
+  quicBuffer->Length = length;
+  quicBuffer->Buffer =
+      reinterpret_cast<uint8_t *>(quicBuffer) + sizeof(QUIC_BUFFER);
+  std::memcpy(quicBuffer->Buffer, data, length);
+  return UniqueQuicBuffer(quicBuffer, QUIC_BUFFERDeleter(nullptr, nullptr));
+}
+
+/*
+    Measures deserializing a subgroup stream which is received in buffers of
+    bufferSize bytes, small buffers are the worst case for the deserializer
+    (every varint and payload spans buffers)
+    Buffers are made before the clock starts, only appending them to the
+    deserializer is measured
+*/
+void benchmark(const ds::chunk &stream, std::size_t bufferSize) {
+  std::vector<UniqueQuicBuffer> quicBuffers;
+  for (std::size_t i = 0; i < stream.size(); i += bufferSize)
+    quicBuffers.push_back(make_quic_buffer(
+        stream.data() + i, std::min(bufferSize, stream.size() - i)));
+
+  std::uint64_t numReceivedObjects = 0;
+  const auto visitor =
+      overloads{[](...) { std::cout << "Unexpected Message\n"; },
+                [](const StreamHeaderSubgroupMessage &) {},
+                [&](const StreamHeaderSubgroupObject &) {
+                  ++numReceivedObjects;
+                }};
+
+  Deserializer deserializer(false, visitor);
+
+  auto beginTime = SteadyClock::now();
+  for (auto &quicBuffer : quicBuffers)
+    deserializer.append_buffer(std::move(quicBuffer));
+  auto endTime = SteadyClock::now();
+
+  if (numReceivedObjects != numObjects) {
+    std::cerr << "Received " << numReceivedObjects << " objects" << std::endl;
+    exit(1);
+  }
+
+  double elapsedSeconds =
+      std::chrono::duration<double>(endTime - beginTime).count();
+  std::cout << "Buffer size: " << bufferSize
+            << " MB/s: " << stream.size() / elapsedSeconds / 1e6
+            << " ns/object: " << elapsedSeconds * 1e9 / numObjects
+            << std::endl;
+}
+
+int main() {
+  ds::chunk stream;
+  serialization::detail::serialize(
+      stream, StreamHeaderSubgroupMessage(TrackAlias(1), GroupId(1),
+                                          SubGroupId(1), PublisherPriority(1)));
+  for (std::uint64_t i = 0; i < numObjects; i++)
+    serialization::detail::serialize(
+        stream, StreamHeaderSubgroupObject{i, std::string(objectSize, 'x')});
+
+  benchmark(stream, 1);
+  benchmark(stream, 7);
+  benchmark(stream, 64);
+  benchmark(stream, 1200);
+  return 0;
+}
@@ -0,0 +1,184 @@
+/////////////////////////////////////////////////////////
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <utility>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    Objects per second and MB/s of historical ranges retrieved with FETCH by a
+    client on loopback
+    The track is published before the client connects, every round fetches a
+    range of it with a new client:
+    - catch up: from the middle of the track to its end, what a subscriber
+      joining late fetches before its subscription takes over
+    - VOD: the whole track
+    The rate is measured from the FETCH being sent to the end of the range
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr std::uint64_t numGroups = 200;
+static constexpr std::uint64_t objectsPerGroup = 1000;
+static constexpr std::size_t objectSize = 1024;
+
+struct Round {
+  const char *name_;
+  GroupObjectPair start_;
+};
+
+static const std::array<Round, 2> rounds = {
+    Round{"catch up", {GroupId(numGroups / 2), ObjectId(objectsPerGroup / 2)}},
+    Round{"VOD", {GroupId(0), ObjectId(0)}}};
+
+static FetchMessage fetch_message(std::uint64_t subscribeId,
+                                  GroupObjectPair start) {
+  FetchMessage fetchMessage;
+  fetchMessage.subscribeId_ = subscribeId;
+  fetchMessage.trackNamespace_ = {};
+  fetchMessage.trackName_ = "track";
+  fetchMessage.subscriberPriority_ = 0;
+  fetchMessage.groupOrder_ = 0;
+  fetchMessage.start_ = start;
+  // whole of the last group
+  fetchMessage.end_ = {GroupId(numGroups - 1), ObjectId(0)};
+  fetchMessage.parameters_ = {};
+  return fetchMessage;
+}
+
+static void fetch_range(MOQTClient &moqtClient, const Round &round,
+                        std::uint64_t subscribeId) {
+  using Clock = std::chrono::steady_clock;
+  std::uint64_t expected =
+      (numGroups - round.start_.group_.get()) * objectsPerGroup -
+      round.start_.object_.get();
+
+  Clock::time_point start = Clock::now();
+  auto fetchStream =
+      moqtClient.fetch(fetch_message(subscribeId, round.start_));
+
+  std::uint64_t numReceived = 0;
+  std::uint64_t numBytes = 0;
+  std::uint64_t numOutOfOrder = 0;
+  std::pair<std::uint64_t, std::uint64_t> last{};
+  for (FetchObjectMessage &object : *fetchStream) {
+    std::pair<std::uint64_t, std::uint64_t> current{object.groupId_.get(),
+                                                    object.objectId_.get()};
+    numOutOfOrder += numReceived != 0 && !(last < current);
+    last = current;
+    ++numReceived;
+    numBytes += object.payload_.size() + object.payloadView_.size();
+  }
+
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << round.name_ << ": " << numReceived << " of " << expected
+            << " objects, " << static_cast<std::uint64_t>(numReceived / seconds)
+            << " objects/s, "
+            << static_cast<std::uint64_t>(numBytes / seconds / 1e6) << " MB/s";
+  if (numOutOfOrder != 0)
+    std::cout << ", " << numOutOfOrder << " out of order";
+  std::cout << std::endl;
+}
+
+int main() {
+  std::string sharedMemoryName = "fetch_throughput_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> moqtServer = server_setup();
+    auto dm = moqtServer->dataManager_;
+
+    // the whole track is history by the time it is fetched
+    auto trackHandle = dm->add_track_identifier({}, "track");
+    std::string object(objectSize, '.');
+    for (std::uint64_t groupId = 0; groupId < numGroups; ++groupId) {
+      auto subgroupHandle =
+          trackHandle.lock()
+              ->add_group(GroupId(groupId), PublisherPriority(0), {})
+              .lock()
+              ->add_subgroup(objectsPerGroup);
+      for (std::uint64_t objectId = 0; objectId < objectsPerGroup; ++objectId)
+        subgroupHandle.add_object(object);
+    }
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    wait(NULL);
+    exit(0);
+  } else
+  // child process
+  {
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    // clients are destroyed at the end, a round does not pay for the teardown
+    // of the previous one
+    std::vector<std::unique_ptr<MOQTClient>> moqtClients;
+    for (std::size_t round = 0; round < rounds.size(); ++round) {
+      moqtClients.push_back(client_setup());
+      fetch_range(*moqtClients.back(), rounds[round], round);
+      moqtClients.back()->close_connection();
+    }
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
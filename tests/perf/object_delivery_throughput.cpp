@@ -0,0 +1,234 @@
+/////////////////////////////////////////////////////////
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <subscription_builder.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    Objects per second received by a client on loopback with each of the
+    object delivery APIs of MOQTClient: receivedObjects_ (MPMC queue), the
+    inline object callback and a per track ring
+    Every round publishes the same small objects on a track of its own to a
+    new client, the rate is measured from the first to the last object
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  // number of rounds the client has subscribed for
+  std::uint64_t numSubscribed;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr std::uint64_t numObjects = 200'000;
+static constexpr std::uint64_t objectsPerGroup = 1000;
+static constexpr std::size_t objectSize = 64;
+
+enum class Delivery { QUEUE, CALLBACK, RING };
+static constexpr std::array deliveries = {Delivery::QUEUE, Delivery::CALLBACK,
+                                          Delivery::RING};
+
+static const char *delivery_name(Delivery delivery) {
+  switch (delivery) {
+  case Delivery::QUEUE:
+    return "receivedObjects_";
+  case Delivery::CALLBACK:
+    return "object callback";
+  case Delivery::RING:
+    return "object ring";
+  }
+  return "";
+}
+
+static std::string track_name(std::size_t round) {
+  return "track_" + std::to_string(round);
+}
+
+static SubscribeMessage subscribe_message(std::size_t round) {
+  SubscriptionBuilder subscriptionBuilder;
+  subscriptionBuilder.set_track_alias(TrackAlias(round));
+  subscriptionBuilder.set_track_namespace({});
+  subscriptionBuilder.set_track_name(track_name(round));
+  subscriptionBuilder.set_data_range(
+      SubscriptionBuilder::Filter::absoluteStart, {GroupId(0), ObjectId(0)});
+  subscriptionBuilder.set_subscriber_priority(0);
+  subscriptionBuilder.set_group_order(0);
+  return subscriptionBuilder.build();
+}
+
+// time from the first to the last object, subscribed is called once the
+// subscription has been sent
+static void receive_objects(MOQTClient &moqtClient, Delivery delivery,
+                            std::size_t round, const auto &subscribed) {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point firstObject;
+  std::uint64_t numReceived = 0;
+
+  switch (delivery) {
+  case Delivery::QUEUE: {
+    moqtClient.subscribe(subscribe_message(round));
+    subscribed();
+    while (numReceived < numObjects) {
+      moqtClient.receivedObjects_.wait_dequeue_ret();
+      if (numReceived++ == 0)
+        firstObject = Clock::now();
+    }
+    break;
+  }
+  case Delivery::CALLBACK: {
+    std::atomic<std::uint64_t> numCalled{};
+    std::atomic<Clock::rep> firstCall{};
+    moqtClient.set_object_callback(
+        [&](const StreamHeaderSubgroupMessage &, StreamHeaderSubgroupObject) {
+          if (numCalled.fetch_add(1, std::memory_order_release) == 0)
+            firstCall.store(Clock::now().time_since_epoch().count(),
+                            std::memory_order_relaxed);
+        });
+    moqtClient.subscribe(subscribe_message(round));
+    subscribed();
+    while ((numReceived = numCalled.load(std::memory_order_acquire)) <
+           numObjects)
+      std::this_thread::yield();
+    firstObject = Clock::time_point(Clock::duration(firstCall.load()));
+    break;
+  }
+  case Delivery::RING: {
+    // nothing is dropped, the rate is the one the consumer keeps up with
+    auto objectRing = moqtClient.subscribe(
+        subscribe_message(round), {4096, OverflowPolicy::BLOCK});
+    subscribed();
+    while (numReceived < numObjects) {
+      if (!objectRing->try_pop().has_value()) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (numReceived++ == 0)
+        firstObject = Clock::now();
+    }
+    break;
+  }
+  }
+
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - firstObject).count();
+  std::cout << delivery_name(delivery) << ": " << numReceived << " objects, "
+            << static_cast<std::uint64_t>(numReceived / seconds)
+            << " objects/s" << std::endl;
+}
+
+int main() {
+  std::string sharedMemoryName = "object_delivery_throughput_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->numSubscribed = 0;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> moqtServer = server_setup();
+    auto dm = moqtServer->dataManager_;
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    std::string object(objectSize, '.');
+    for (std::size_t round = 0; round < deliveries.size(); ++round) {
+      auto trackHandle = dm->add_track_identifier({}, track_name(round));
+
+      for (;;) {
+        std::unique_lock lock(dataParent->mutex);
+        if (dataParent->numSubscribed > round)
+          break;
+      }
+
+      for (std::uint64_t groupId = 0; groupId < numObjects / objectsPerGroup;
+           ++groupId) {
+        auto subgroupHandle =
+            trackHandle.lock()
+                ->add_group(GroupId(groupId), PublisherPriority(0), {})
+                .lock()
+                ->add_subgroup(objectsPerGroup);
+        for (std::uint64_t objectId = 0; objectId < objectsPerGroup;
+             ++objectId)
+          subgroupHandle.add_object(object);
+      }
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    wait(NULL);
+    exit(0);
+  } else
+  // child process
+  {
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    // clients are destroyed at the end, a round does not pay for the teardown
+    // of the previous one
+    std::vector<std::unique_ptr<MOQTClient>> moqtClients;
+    for (std::size_t round = 0; round < deliveries.size(); ++round) {
+      moqtClients.push_back(client_setup());
+      receive_objects(*moqtClients.back(), deliveries[round], round,
+                      [dataChild, round] {
+                        std::unique_lock lock(dataChild->mutex);
+                        dataChild->numSubscribed = round + 1;
+                      });
+      moqtClients.back()->close_connection();
+    }
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
@@ -100,9 +100,14 @@ public:
               get_size_of_object(bitRate, msBetweenObjects);
           rvn::PublisherPriority priority(layerIdx);
 
+          // every other layer builds on top of layer 0
+          rvn::LayerType layerType = layerIdx == 0
+                                         ? rvn::LayerType::Base
+                                         : rvn::LayerType::Enhancement;
+
           auto groupHandle = trackHandle
                                  ->add_group(rvn::GroupId(layerIdx), priority,
-                                             msBetweenObjects)
+                                             msBetweenObjects, layerType)
                                  .lock();
 
           std::optional<rvn::SubgroupHandle> subGroupHandleOpt =
@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <iostream>
+#include <memory>
+/////////////////////////////////////////////////////////
+#include <contexts.hpp>
+#include <data_manager.hpp>
+#include <subscription_manager.hpp>
+/////////////////////////////////////////////////////////
+
+using namespace rvn;
+
+using SteadyClock = std::chrono::steady_clock;
+
+constexpr auto benchmarkDuration = std::chrono::seconds(1);
+
+SubscriptionTask wait_forever(ObjectWaitSignal objectWaitSignal) {
+  while (true)
+    co_await ObjectReady(objectWaitSignal);
+  co_return true;
+}
+
+// ready on every pass, as a row with objects to send is
+SubscriptionTask yield_forever() {
+  while (true)
+    co_await Yield{};
+  co_return true;
+}
+
+/*
+    Measures how many passes over all the minor subscriptions a subscription
+    thread can do per second
+    Rows wait on objects which are never published, so for them this is the
+    cost of scanning the wait flag column of the table (which is what the
+    subscription thread does most of the time). One in readyEvery rows is
+    ready on every pass, those also resume their coroutine frame
+    Every waiting row has its own signal, as rows of different tracks would
+*/
+void benchmark(std::size_t numSubscriptions, std::size_t readyEvery) {
+  DataManager dataManager;
+  // no threads, we drive the thread local state ourselves
+  SubscriptionManager subscriptionManager(dataManager, 0);
+  ThreadLocalState threadLocalState(subscriptionManager);
+
+  SubscribeMessage subscribeMessage;
+  subscribeMessage.filterType_ = SubscribeFilterType::LatestObject;
+
+  // connection is expired, so the subscription does not resolve anything, we
+  // only use it as owner of the rows
+  SubscriptionState *subscriptionState =
+      threadLocalState.subscriptionStates_.emplace(
+          std::weak_ptr<ConnectionState>(), dataManager, subscriptionManager,
+          threadLocalState.minorSubscriptionTable_,
+          threadLocalState.connectionsToFlush_, std::move(subscribeMessage));
+
+  MinorSubscriptionTable &table = threadLocalState.minorSubscriptionTable_;
+  for (std::size_t i = 0; i < numSubscriptions; i++)
+    table.add_row(*subscriptionState,
+                  i % readyEvery == 0
+                      ? yield_forever()
+                      : wait_forever(
+                            std::make_shared<std::atomic<ObjectWaitStatus>>(
+                                ObjectWaitStatus::Wait)));
+
+  // first pass starts the coroutines, they suspend on the flag
+  threadLocalState.fulfill_some();
+
+  std::uint64_t numIterations = 0;
+  auto beginTime = SteadyClock::now();
+  auto endTime = beginTime;
+  while (endTime - beginTime < benchmarkDuration) {
+    threadLocalState.fulfill_some();
+    ++numIterations;
+    endTime = SteadyClock::now();
+  }
+
+  double elapsedSeconds =
+      std::chrono::duration<double>(endTime - beginTime).count();
+  double iterationsPerSecond = numIterations / elapsedSeconds;
+
+  std::cout << "Subscriptions: " << numSubscriptions
+            << " Ready: " << numSubscriptions / readyEvery
+            << " Iterations/s: " << iterationsPerSecond << " ns/subscription: "
+            << 1e9 / (iterationsPerSecond * numSubscriptions) << std::endl;
+}
+
+int main() {
+  // only waiting rows (the first row is always ready)
+  benchmark(10'000, 10'000);
+  benchmark(100'000, 100'000);
+  // 1% of the rows have something to send
+  benchmark(10'000, 100);
+  benchmark(100'000, 100);
+  return 0;
+}
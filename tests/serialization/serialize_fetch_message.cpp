@@ -0,0 +1,103 @@
+#include "strong_types.hpp"
+#include "test_serialization_utils.hpp"
+#include "utilities.hpp"
+#include <serialization/chunk.hpp>
+#include <serialization/deserialization_impl.hpp>
+#include <serialization/messages.hpp>
+#include <serialization/serialization_impl.hpp>
+
+using namespace rvn;
+using namespace rvn::serialization;
+
+void test1() {
+  FetchMessage msg;
+  msg.subscribeId_ = 1;
+  msg.trackNamespace_ = {"a"};
+  msg.trackName_ = "b";
+  msg.subscriberPriority_ = 2;
+  msg.groupOrder_ = 1;
+  msg.start_ = GroupObjectPair{GroupId(3), ObjectId(4)};
+  msg.end_ = GroupObjectPair{GroupId(5), ObjectId(0)};
+  msg.parameters_ = {};
+
+  ds::chunk c;
+  serialization::detail::serialize(c, msg);
+  // clang-format off
+    /*   [ 00010110 ]     [ 00001101 ]      [ 00000001 ]     [ 00000001 ]       [ 00000001 ] [ 01100001 ]   [ 00000001 ] [ 01100010 ]
+     * (msg_type: 0x16)   (len: 13)      (subscribeId_: 1)  (namespace tuple)    (ns len: 1)     "a"       (name len: 1)     "b"
+     *
+     *        [ 00000010 ]          [ 00000001 ]       [ 00000011 ]      [ 00000100 ]     [ 00000101 ]    [ 00000000 ]      [ 00000000 ]
+     * (subscriberPriority_)   ( groupOrder_ )   (start_.group_)  (start_.object_)  (end_.group_)  (end_.object_)  (parameters_.size)
+     */
+    std::string expectedSerializationString = "00010110 00001101 00000001 00000001 00000001 01100001 00000001 01100010 00000010 00000001 00000011 00000100 00000101 00000000 00000000";
+  // clang-format on
+
+  auto expectedSerialization =
+      binary_string_to_vector(expectedSerializationString);
+  utils::ASSERT_LOG_THROW(c.size() == expectedSerialization.size(),
+                          "Size mismatch\n",
+                          "Expected size: ", expectedSerialization.size(), "\n",
+                          "Actual size: ", c.size(), "\n");
+  for (std::size_t i = 0; i < c.size(); i++)
+    utils::ASSERT_LOG_THROW(
+        c[i] == expectedSerialization[i], "Mismatch at index: ", i, "\n",
+        "Expected: ", expectedSerialization[i], "\n", "Actual: ", c[i], "\n");
+
+  ds::ChunkSpan span(c);
+
+  ControlMessageHeader header;
+  serialization::detail::deserialize(header, span);
+
+  utils::ASSERT_LOG_THROW(
+      header.messageType_ == MoQtMessageType::FETCH, "Message type mismatch\n",
+      "Expected: ", utils::to_underlying(MoQtMessageType::FETCH), "\n",
+      "Actual: ", utils::to_underlying(header.messageType_), "\n");
+
+  FetchMessage deserializedMsg;
+  serialization::detail::deserialize(deserializedMsg, span);
+
+  utils::ASSERT_LOG_THROW(msg == deserializedMsg, "Deserialization failed\n",
+                          "Expected: ", msg, "\n", "Actual: ", deserializedMsg,
+                          "\n");
+}
+
+// fetch stream header and object
+void test2() {
+  ds::chunk c;
+  serialization::detail::serialize(c, FetchHeaderMessage{1});
+  serialization::detail::serialize(
+      c, FetchObjectMessage{GroupId(3), SubGroupId(0), PublisherPriority(2),
+                            ObjectId(4), "ab"});
+  // clang-format off
+    /*   [ 00000101 ]          [ 00000001 ]       [ 00000011 ]   [ 00000000 ]   [ 00000010 ]   [ 00000100 ]   [ 00000010 ]   [ 01100001 01100010 ]
+     * (FETCH_HEADER: 0x5)  (subscribeId_: 1)    (groupId_)   (subgroupId_)   (priority)    (objectId_)   (payload len)          "ab"
+     */
+    std::string expectedSerializationString = "00000101 00000001 00000011 00000000 00000010 00000100 00000010 01100001 01100010";
+  // clang-format on
+
+  auto expectedSerialization =
+      binary_string_to_vector(expectedSerializationString);
+  utils::ASSERT_LOG_THROW(c.size() == expectedSerialization.size(),
+                          "Size mismatch\n",
+                          "Expected size: ", expectedSerialization.size(), "\n",
+                          "Actual size: ", c.size(), "\n");
+  for (std::size_t i = 0; i < c.size(); i++)
+    utils::ASSERT_LOG_THROW(
+        c[i] == expectedSerialization[i], "Mismatch at index: ", i, "\n",
+        "Expected: ", expectedSerialization[i], "\n", "Actual: ", c[i], "\n");
+}
+
+void tests() {
+  try {
+    test1();
+    test2();
+  } catch (const std::exception &e) {
+    std::cerr << "Test failed\n";
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+int main() {
+  tests();
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include "test_serialization_utils.hpp"
+#include "utilities.hpp"
+#include <serialization/chunk.hpp>
+#include <serialization/deserialization_impl.hpp>
+#include <serialization/messages.hpp>
+#include <serialization/serialization_impl.hpp>
+
+using namespace rvn;
+using namespace rvn::serialization;
+
+void test1() {
+  GoAwayMessage msg("moqt://a:1");
+
+  ds::chunk c;
+  serialization::detail::serialize(c, msg);
+  // clang-format off
+    // [ 00010000 ]             [ 00001011 ]   [ 00001010 ]          [ m o q t : / / a : 1 ]
+    // (quic_msg_type: 0x10)    (msglen = 11)  (uri length = 10)     (new session uri)
+    std::string expectedSerializationString = "[00010000][00001011][00001010][01101101 01101111 01110001 01110100 00111010 00101111 00101111 01100001 00111010 00110001]";
+  // clang-format on
+
+  auto expectedSerialization =
+      binary_string_to_vector(expectedSerializationString);
+  utils::ASSERT_LOG_THROW(c.size() == expectedSerialization.size(),
+                          "Size mismatch\n",
+                          "Expected size: ", expectedSerialization.size(), "\n",
+                          "Actual size: ", c.size(), "\n");
+  for (std::size_t i = 0; i < c.size(); i++)
+    utils::ASSERT_LOG_THROW(
+        c[i] == expectedSerialization[i], "Mismatch at index: ", i, "\n",
+        "Expected: ", expectedSerialization[i], "\n", "Actual: ", c[i], "\n");
+
+  ds::ChunkSpan span(c);
+
+  ControlMessageHeader header;
+  serialization::detail::deserialize(header, span);
+
+  utils::ASSERT_LOG_THROW(
+      header.messageType_ == MoQtMessageType::GOAWAY, "Message type mismatch\n",
+      "Expected: ", utils::to_underlying(MoQtMessageType::GOAWAY), "\n",
+      "Actual: ", utils::to_underlying(header.messageType_), "\n");
+
+  GoAwayMessage deserializedMsg;
+  serialization::detail::deserialize(deserializedMsg, span);
+
+  utils::ASSERT_LOG_THROW(msg == deserializedMsg, "Deserialization failed\n",
+                          "Expected: ", msg, "\n", "Actual: ", deserializedMsg,
+                          "\n");
+}
+
+// empty uri means reconnect to the same server
+void test2() {
+  GoAwayMessage msg;
+
+  ds::chunk c;
+  serialization::detail::serialize(c, msg);
+
+  ds::ChunkSpan span(c);
+  ControlMessageHeader header;
+  serialization::detail::deserialize(header, span);
+
+  utils::ASSERT_LOG_THROW(header.length_ == 1, "Length mismatch ",
+                          header.length_);
+
+  GoAwayMessage deserializedMsg("not empty");
+  serialization::detail::deserialize(deserializedMsg, span);
+
+  utils::ASSERT_LOG_THROW(msg == deserializedMsg, "Deserialization failed\n",
+                          "Expected: ", msg, "\n", "Actual: ", deserializedMsg,
+                          "\n");
+}
+
+void tests() {
+  try {
+    test1();
+    test2();
+  } catch (const std::exception &e) {
+    std::cerr << "Test failed\n";
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+int main() {
+  tests();
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include "test_serialization_utils.hpp"
+#include <cassert>
+#include <iostream>
+#include <serialization/chunk.hpp>
+#include <serialization/deserialization_impl.hpp>
+#include <serialization/messages.hpp>
+#include <serialization/serialization_impl.hpp>
+#include <utilities.hpp>
+
+using namespace rvn;
+using namespace rvn::serialization;
+
+void test_serialize_object_datagram() {
+  ObjectDatagramMessage msg{TrackAlias(1), GroupId(2), ObjectId(3),
+                            PublisherPriority(4), "abcd"};
+  ds::chunk c;
+
+  serialization::detail::serialize(c, msg);
+
+  // clang-format off
+    /*
+        00000001           00000001         00000010       00000011
+        [type 0x1]      [trackAlias 1]    [groupId 2]    [objectId 3]
+
+        00000100                   00000100
+        [publisherPriority 4]      [payload length 4]
+
+        01100001 01100010 01100011 01100100
+        [ payload = "abcd" ]
+    */
+    std::string expectedSerializationString = "00000001 00000001 00000010 00000011 00000100 00000100 01100001 01100010 01100011 01100100";
+  // clang-format on
+  auto expectedSerialization =
+      binary_string_to_vector(expectedSerializationString);
+
+  utils::ASSERT_LOG_THROW(c.size() == expectedSerialization.size(),
+                          "Size mismatch\n",
+                          "Expected size: ", expectedSerialization.size(), "\n",
+                          "Actual size: ", c.size(), "\n");
+  for (std::size_t i = 0; i < c.size(); i++)
+    utils::ASSERT_LOG_THROW(c[i] == expectedSerialization[i],
+                            "Mismatch at index: ", i, "\n",
+                            "Expected: ", int(expectedSerialization[i]), "\n",
+                            "Actual: ", int(c[i]), "\n");
+
+  // datagrams are received as a single buffer
+  ds::BufferSpan span(c.data(), c.size());
+
+  ObjectDatagramMessage deserializedMsg;
+  serialization::detail::deserialize(deserializedMsg, span);
+
+  utils::ASSERT_LOG_THROW(msg == deserializedMsg, "Deserialization failed\n",
+                          "Expected: ", msg, "\n", "Actual: ", deserializedMsg,
+                          "\n");
+  utils::ASSERT_LOG_THROW(span.size() == 0, "Bytes left after deserializing",
+                          span.size());
+}
+
+// server sends the datagram header followed by the cached object without its
+// object id, that should be the same as serializing the whole datagram
+void test_object_datagram_from_cached_object() {
+  ObjectDatagramMessage msg{TrackAlias(1000), GroupId(20), ObjectId(300),
+                            PublisherPriority(4), std::string(100, 'x')};
+
+  ds::chunk expected;
+  serialization::detail::serialize(expected, msg);
+
+  ds::chunk cachedObject;
+  serialization::detail::serialize(
+      cachedObject, StreamHeaderSubgroupObject{msg.objectId_, msg.payload_});
+  std::uint64_t objectIdLength = ds::quic_var_int(msg.objectId_).size();
+
+  ds::chunk datagram;
+  serialization::detail::serialize_header(datagram, msg);
+  datagram.append(cachedObject.data() + objectIdLength,
+                  cachedObject.size() - objectIdLength);
+
+  utils::ASSERT_LOG_THROW(datagram == expected,
+                          "Datagram built from cached object mismatch");
+}
+
+void tests() {
+  try {
+    test_serialize_object_datagram();
+    test_object_datagram_from_cached_object();
+  } catch (const std::exception &e) {
+    std::cerr << "test failed\n";
+    std::cerr << e.what() << '\n';
+  }
+}
+int main() {
+  tests();
+  return 0;
+}
@@ -0,0 +1,168 @@
+#include "serialization/chunk.hpp"
+#include "serialization/quic_var_int.hpp"
+#include "utilities.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <serialization/deserialization_impl.hpp>
+#include <serialization/quic_var_int_batch.hpp>
+#include <serialization/serialization_impl.hpp>
+#include <vector>
+
+/*
+    Batch codec is checked against the one varint at a time codec (which is
+    tested in serialize_quic_var_int_tests) for every codec the cpu supports
+*/
+
+using namespace rvn;
+using namespace rvn::serialization;
+using Codec = serialization::detail::QuicVarIntCodec;
+
+static const char *codec_name(Codec codec) {
+  switch (codec) {
+  case Codec::SCALAR:
+    return "SCALAR";
+  case Codec::SSSE3:
+    return "SSSE3";
+  case Codec::AVX2:
+    return "AVX2";
+  }
+  return "";
+}
+
+// boundaries of every length and random values of a random length
+static std::vector<std::uint64_t> generate_values(std::mt19937_64 &rng,
+                                                  std::size_t numValues) {
+  static constexpr std::uint64_t maxValues[] = {
+      (1 << 6) - 1, (1 << 14) - 1, (1 << 30) - 1, (std::uint64_t(1) << 62) - 1};
+  static constexpr std::uint64_t boundaries[] = {
+      0, 1, maxValues[0], maxValues[0] + 1, maxValues[1], maxValues[1] + 1,
+      maxValues[2], maxValues[2] + 1, maxValues[3]};
+
+  std::vector<std::uint64_t> values(numValues);
+  for (auto &value : values) {
+    if (rng() % 4 == 0)
+      value = boundaries[rng() % std::size(boundaries)];
+    else
+      value = rng() & maxValues[rng() % std::size(maxValues)];
+  }
+  return values;
+}
+
+static ds::chunk
+serialize_one_by_one(const std::vector<std::uint64_t> &values) {
+  ds::chunk c(1);
+  for (std::uint64_t value : values)
+    serialization::detail::serialize<ds::quic_var_int>(c, value);
+  return c;
+}
+
+static void decode_test(Codec codec,
+                        const std::vector<std::uint64_t> &values) {
+  ds::chunk c = serialize_one_by_one(values);
+  std::span<const std::uint8_t> bytes(c.data(), c.size());
+
+  std::vector<std::uint64_t> decoded(values.size());
+  auto [numValues, numBytes] =
+      serialization::detail::decode_quic_var_ints(bytes, decoded, codec);
+  utils::ASSERT_LOG_THROW(numValues == values.size(), codec_name(codec),
+                          " decoded ", numValues, " of ", values.size());
+  utils::ASSERT_LOG_THROW(numBytes == c.size(), codec_name(codec),
+                          " consumed ", numBytes, " of ", c.size());
+  utils::ASSERT_LOG_THROW(decoded == values, codec_name(codec),
+                          " decoded wrong values");
+
+  // the one by one deserializer agrees on every value
+  if (c.size() != 0) {
+    ds::ChunkSpan span(c);
+    for (std::uint64_t value : values) {
+      std::uint64_t deserialized;
+      serialization::detail::deserialize<ds::quic_var_int>(deserialized,
+                                                           span);
+      utils::ASSERT_LOG_THROW(value == deserialized, "Deserialized ",
+                              deserialized, " expected ", value);
+    }
+  }
+}
+
+// bytes cut at every offset, decoding stops before the incomplete varint
+static void truncated_decode_test(Codec codec,
+                                  const std::vector<std::uint64_t> &values) {
+  ds::chunk c = serialize_one_by_one(values);
+
+  std::vector<std::uint64_t> decoded(values.size());
+  for (std::uint64_t cut = 0; cut <= c.size(); ++cut) {
+    std::size_t expectedValues = 0;
+    std::uint64_t expectedBytes = 0;
+    while (expectedValues < values.size() &&
+           expectedBytes + ds::quic_var_int(values[expectedValues]).size() <=
+               cut)
+      expectedBytes += ds::quic_var_int(values[expectedValues++]).size();
+
+    auto [numValues, numBytes] = serialization::detail::decode_quic_var_ints(
+        std::span<const std::uint8_t>(c.data(), cut), decoded, codec);
+    utils::ASSERT_LOG_THROW(numValues == expectedValues &&
+                                numBytes == expectedBytes,
+                            codec_name(codec), " cut at ", cut, " decoded ",
+                            numValues, " values ", numBytes, " bytes");
+    for (std::size_t i = 0; i < numValues; ++i)
+      utils::ASSERT_LOG_THROW(decoded[i] == values[i], codec_name(codec),
+                              " cut at ", cut, " wrong value at ", i);
+  }
+
+  // fewer values asked for than are available
+  std::size_t numAsked = values.size() / 2;
+  auto [numValues, numBytes] = serialization::detail::decode_quic_var_ints(
+      std::span<const std::uint8_t>(c.data(), c.size()),
+      std::span<std::uint64_t>(decoded.data(), numAsked), codec);
+  utils::ASSERT_LOG_THROW(numValues == numAsked, codec_name(codec),
+                          " decoded ", numValues, " asked for ", numAsked);
+}
+
+static void encode_test(Codec codec,
+                        const std::vector<std::uint64_t> &values) {
+  ds::chunk c = serialize_one_by_one(values);
+
+  std::vector<std::uint8_t> encoded(
+      serialization::detail::max_encoded_size(values.size()));
+  auto [numValues, numBytes] = serialization::detail::encode_quic_var_ints(
+      encoded.data(), values, codec);
+  utils::ASSERT_LOG_THROW(numValues == values.size(), codec_name(codec),
+                          " encoded ", numValues, " of ", values.size());
+  utils::ASSERT_LOG_THROW(numBytes == c.size(), codec_name(codec),
+                          " encoded ", numBytes, " bytes, expected ",
+                          c.size());
+  utils::ASSERT_LOG_THROW(
+      std::equal(c.data(), c.data() + c.size(), encoded.begin()),
+      codec_name(codec), " encoded wrong bytes");
+}
+
+int main() {
+  std::mt19937_64 rng(42);
+
+  Codec best = serialization::detail::best_quic_var_int_codec();
+  for (Codec codec : {Codec::SCALAR, Codec::SSSE3, Codec::AVX2}) {
+    if (codec > best) {
+      std::cout << "Skipping " << codec_name(codec) << ", not supported"
+                << std::endl;
+      continue;
+    }
+    std::cout << "Testing " << codec_name(codec) << std::endl;
+
+    for (std::size_t numValues = 0; numValues < 64; ++numValues) {
+      for (int iteration = 0; iteration < 100; ++iteration) {
+        auto values = generate_values(rng, numValues);
+        decode_test(codec, values);
+        encode_test(codec, values);
+      }
+      truncated_decode_test(codec, generate_values(rng, numValues));
+    }
+
+    auto values = generate_values(rng, 1 << 16);
+    decode_test(codec, values);
+    encode_test(codec, values);
+  }
+
+  return 0;
+}
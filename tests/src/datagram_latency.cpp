@@ -0,0 +1,255 @@
+/////////////////////////////////////////////////////////
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <subscription_builder.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    Same objects are published on three tracks, the client subscribes to them
+    in Subgroup (stream per group), Track (one stream) and Datagram mode and
+    compares the time from publishing to receiving
+    Every object is in its own group, so in Subgroup mode every object pays
+    for opening a stream
+    The last object does not fit in a datagram and has to fall back to a stream
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  bool clientSubscribed;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr std::uint64_t numObjects = 1000;
+static constexpr std::size_t objectSize = 200;
+// bigger than any datagram
+static constexpr std::size_t largeObjectSize = 4000;
+static constexpr auto publishInterval = std::chrono::microseconds(500);
+
+static constexpr TrackAlias streamTrackAlias = TrackAlias(0);
+static constexpr TrackAlias datagramTrackAlias = TrackAlias(1);
+static constexpr TrackAlias trackStreamTrackAlias = TrackAlias(2);
+
+static std::uint64_t now_ns() {
+  // steady clock is system wide, so timestamps can be compared across the
+  // server and client process
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::string make_object(std::size_t size) {
+  std::string object = std::to_string(now_ns());
+  object.resize(size, '.');
+  return object;
+}
+
+static void print_latencies(const char *name,
+                            std::vector<std::uint64_t> &latencies) {
+  if (latencies.empty()) {
+    std::cout << name << ": no objects received" << std::endl;
+    return;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  std::uint64_t sum =
+      std::accumulate(latencies.begin(), latencies.end(), std::uint64_t(0));
+
+  std::cout << name << ": received " << latencies.size() << " mean "
+            << sum / latencies.size() / 1000 << "us p50 "
+            << latencies[latencies.size() / 2] / 1000 << "us p99 "
+            << latencies[latencies.size() * 99 / 100] / 1000 << "us"
+            << std::endl;
+}
+
+static void subscribe(MOQTClient &moqtClient, TrackAlias trackAlias,
+                      std::string trackName, DeliveryMode deliveryMode) {
+  SubscriptionBuilder subscriptionBuilder;
+  subscriptionBuilder.set_track_alias(trackAlias);
+  subscriptionBuilder.set_track_namespace({});
+  subscriptionBuilder.set_track_name(std::move(trackName));
+  subscriptionBuilder.set_data_range(
+      SubscriptionBuilder::Filter::absoluteStart, {GroupId(0), ObjectId(0)});
+  subscriptionBuilder.set_subscriber_priority(0);
+  subscriptionBuilder.set_group_order(0);
+  subscriptionBuilder.set_delivery_mode(deliveryMode);
+
+  moqtClient.subscribe(subscriptionBuilder.build());
+}
+
+int main() {
+  std::string sharedMemoryName = "datagram_latency_test_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->clientSubscribed = false;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> moqtServer = server_setup();
+
+    auto dm = moqtServer->dataManager_;
+    auto streamTrackHandle = dm->add_track_identifier({}, "stream_track");
+    auto datagramTrackHandle = dm->add_track_identifier({}, "datagram_track");
+    auto trackStreamTrackHandle =
+        dm->add_track_identifier({}, "track_stream_track");
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientSubscribed)
+        break;
+    }
+
+    for (std::uint64_t idx = 0; idx < numObjects; ++idx) {
+      std::size_t size = idx + 1 == numObjects ? largeObjectSize : objectSize;
+
+      // rotate which track gets the object first
+      std::array trackHandles = {streamTrackHandle, datagramTrackHandle,
+                                 trackStreamTrackHandle};
+      std::rotate(trackHandles.begin(), trackHandles.begin() + idx % 3,
+                  trackHandles.end());
+
+      for (auto &trackHandle : trackHandles)
+        trackHandle.lock()
+            ->add_group(GroupId(idx), PublisherPriority(0), {})
+            .lock()
+            ->add_subgroup(1)
+            .add_object(make_object(size));
+
+      std::this_thread::sleep_for(publishInterval);
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    wait(NULL);
+    exit(0);
+  } else
+  // child process
+  {
+    // Open shared memory
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    std::unique_ptr<MOQTClient> moqtClient = client_setup();
+
+    subscribe(*moqtClient, streamTrackAlias, "stream_track",
+              DeliveryMode::Subgroup);
+    subscribe(*moqtClient, datagramTrackAlias, "datagram_track",
+              DeliveryMode::Datagram);
+    subscribe(*moqtClient, trackStreamTrackAlias, "track_stream_track",
+              DeliveryMode::Track);
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientSubscribed = true;
+    }
+
+    std::vector<std::uint64_t> streamLatencies;
+    std::vector<std::uint64_t> datagramLatencies;
+    std::vector<std::uint64_t> trackStreamLatencies;
+    std::uint64_t numStreamObjects = 0;
+    bool largeObjectReceived = false;
+
+    auto receive = [&](MOQTClient::EnrichedObjectMessage &&object) {
+      TrackAlias trackAlias = object.header_->trackAlias_;
+      numStreamObjects += trackAlias != datagramTrackAlias;
+
+      // the large object is not measured
+      if (object.object_.payload_.size() == largeObjectSize) {
+        largeObjectReceived |= trackAlias == datagramTrackAlias;
+        return;
+      }
+
+      std::uint64_t latency = now_ns() - std::stoull(object.object_.payload_);
+      if (trackAlias == streamTrackAlias)
+        streamLatencies.push_back(latency);
+      else if (trackAlias == datagramTrackAlias)
+        datagramLatencies.push_back(latency);
+      else
+        trackStreamLatencies.push_back(latency);
+    };
+
+    // streams are reliable, datagrams might be lost
+    while (numStreamObjects < 2 * numObjects)
+      receive(moqtClient->receivedObjects_.wait_dequeue_ret());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    MOQTClient::EnrichedObjectMessage object;
+    while (moqtClient->receivedObjects_.try_dequeue(object))
+      receive(std::move(object));
+
+    print_latencies("Subgroup", streamLatencies);
+    print_latencies("Datagram", datagramLatencies);
+    print_latencies("Track", trackStreamLatencies);
+
+    try {
+      utils::ASSERT_LOG_THROW(!datagramLatencies.empty(),
+                              "No objects received in datagrams");
+      utils::ASSERT_LOG_THROW(trackStreamLatencies.size() == numObjects - 1,
+                              "Objects lost on the track stream");
+      utils::ASSERT_LOG_THROW(largeObjectReceived,
+                              "Object larger than a datagram was not received");
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
@@ -0,0 +1,177 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <subscription_builder.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    Subscription threads send objects with QUIC_SEND_FLAG_DELAY_SEND and flush
+    the connection at the end of the pass with an empty StreamSend (see
+    ConnectionState::flush_delayed_sends)
+    Objects are published one at a time with a pause in between, so nothing
+    else is sent on the connection while an object waits in msquic. If the
+    empty send did not flush the delayed data, the object would never leave
+    the server
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  bool clientSubscribed;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr std::uint64_t numObjects = 20;
+static constexpr auto publishInterval = std::chrono::milliseconds(50);
+// far above loopback latency, far below how long the object would wait for
+// an unrelated send
+static constexpr auto maxLatency = std::chrono::milliseconds(200);
+
+static std::uint64_t now_ns() {
+  // steady clock is system wide, so timestamps can be compared across the
+  // server and client process
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int main() {
+  std::string sharedMemoryName = "delayed_send_flush_test_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->clientSubscribed = false;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> moqtServer = server_setup();
+
+    auto dm = moqtServer->dataManager_;
+    auto trackHandle = dm->add_track_identifier({}, "track");
+    // all objects go on the same stream, only the first one opens it
+    auto subgroupHandle = trackHandle.lock()
+                              ->add_group(GroupId(0), PublisherPriority(0), {})
+                              .lock()
+                              ->add_subgroup(numObjects);
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientSubscribed)
+        break;
+    }
+
+    for (std::uint64_t idx = 0; idx < numObjects; ++idx) {
+      std::this_thread::sleep_for(publishInterval);
+      subgroupHandle.add_object(std::to_string(now_ns()));
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    wait(NULL);
+    exit(0);
+  } else
+  // child process
+  {
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    std::unique_ptr<MOQTClient> moqtClient = client_setup();
+
+    SubscriptionBuilder subscriptionBuilder;
+    subscriptionBuilder.set_track_alias(TrackAlias(0));
+    subscriptionBuilder.set_track_namespace({});
+    subscriptionBuilder.set_track_name("track");
+    subscriptionBuilder.set_data_range(
+        SubscriptionBuilder::Filter::absoluteStart, {GroupId(0), ObjectId(0)});
+    subscriptionBuilder.set_subscriber_priority(0);
+    subscriptionBuilder.set_group_order(0);
+    moqtClient->subscribe(subscriptionBuilder.build());
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientSubscribed = true;
+    }
+
+    try {
+      for (std::uint64_t idx = 0; idx < numObjects; ++idx) {
+        // the next object is published within publishInterval
+        auto deadline =
+            std::chrono::steady_clock::now() + publishInterval + maxLatency;
+        MOQTClient::EnrichedObjectMessage object;
+        while (!moqtClient->receivedObjects_.try_dequeue(object)) {
+          utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                                  "Object ", idx,
+                                  " was not flushed by the server");
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        auto latency = std::chrono::nanoseconds(
+            now_ns() - std::stoull(object.object_.payload_));
+        utils::ASSERT_LOG_THROW(
+            latency < maxLatency, "Object ", idx, " took ",
+            std::chrono::duration_cast<std::chrono::milliseconds>(latency)
+                .count(),
+            "ms");
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+
+    std::cout << "Received " << numObjects << " delayed sends" << std::endl;
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
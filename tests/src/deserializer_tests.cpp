@@ -2,9 +2,13 @@
 #include "strong_types.hpp"
 #include "wrappers.hpp"
 #include <deserializer.hpp>
+#include <fetch_stream.hpp>
 #include <initializer_list>
+#include <span>
 #include <serialization/messages.hpp>
 #include <serialization/serialization_impl.hpp>
+#include <spsc_queue.hpp>
+#include <thread>
 
 using namespace rvn;
 using namespace rvn::serialization;
@@ -130,8 +134,368 @@ void test2() {
   return;
 }
 
+// objects of several groups on one track stream, all messages are serialized
+// into one chunk so buffers are split across message boundaries
+void test3() {
+  ds::chunk chunk;
+
+  StreamHeaderTrackMessage streamHeaderTrackMessage{TrackAlias(1),
+                                                    PublisherPriority(1)};
+  serialization::detail::serialize(chunk, streamHeaderTrackMessage);
+
+  constexpr std::uint64_t NumGroups = 10;
+  constexpr std::uint64_t NumObjectsPerGroup = 100;
+
+  std::vector<TrackStreamObjectMessage> sentObjects;
+  for (std::uint64_t group = 0; group < NumGroups; group++)
+    for (std::uint64_t object = 0; object < NumObjectsPerGroup; object++) {
+      sentObjects.push_back(
+          {GroupId(group), ObjectId(object),
+           "Object Message: " + std::to_string(group * 1000 + object)});
+      serialization::detail::serialize(chunk, sentObjects.back());
+    }
+
+  auto quicBuffers = generate_quic_buffers({chunk});
+
+  std::vector<TrackStreamObjectMessage> receivedObjects;
+  std::uint64_t numHeaders = 0;
+  const auto visitor = overloads{
+      [](...) { std::cout << "Unexpected Message\n"; },
+      [&](const StreamHeaderTrackMessage &h) {
+        numHeaders++;
+        utils::ASSERT_LOG_THROW(h == streamHeaderTrackMessage,
+                                "Track header mismatch ", h);
+      },
+      [&](const TrackStreamObjectMessage &o) { receivedObjects.push_back(o); }};
+
+  Deserializer deserializer(false, visitor);
+  for (auto &&quicBuffer : quicBuffers)
+    deserializer.append_buffer(std::move(quicBuffer));
+
+  utils::ASSERT_LOG_THROW(numHeaders == 1, "Expected one track header, got ",
+                          numHeaders);
+  utils::ASSERT_LOG_THROW(receivedObjects == sentObjects,
+                          "Track objects mismatch, received ",
+                          receivedObjects.size(), " objects");
+  std::cout << "Received " << receivedObjects.size() << " Track Objects\n";
+}
+
+// zero copy receive, buffers reference the sender's memory and are completed
+// once the deserializer is done with them
+static std::uint64_t completedBytes = 0;
+static void QUIC_API receive_complete(HQUIC, std::uint64_t bufferLength) {
+  completedBytes += bufferLength;
+}
+
+void test4() {
+  ds::chunk chunk;
+
+  StreamHeaderSubgroupMessage streamHeaderSubgroupMessage(
+      TrackAlias(1), GroupId(1), SubGroupId(1), PublisherPriority(1));
+  serialization::detail::serialize(chunk, streamHeaderSubgroupMessage);
+
+  std::vector<StreamHeaderSubgroupObject> sentObjects;
+  for (std::uint64_t i = 0; i < 100; i++) {
+    // large object is received in many events and has to be copied
+    std::string payload = i == 50 ? std::string(200'000, 'x')
+                                  : "Object Message: " + std::to_string(i);
+    sentObjects.push_back({i, std::move(payload)});
+    serialization::detail::serialize(chunk, sentObjects.back());
+  }
+
+  std::vector<StreamHeaderSubgroupObject> receivedObjects;
+  const auto visitor = overloads{
+      [](...) { std::cout << "Unexpected Message\n"; },
+      [](const StreamHeaderSubgroupMessage &) {},
+      [&](const StreamHeaderSubgroupObject &o) {
+        receivedObjects.push_back(o);
+      }};
+
+  int stream;
+  HQUIC streamHandle = reinterpret_cast<HQUIC>(&stream);
+
+  Deserializer deserializer(false, visitor);
+  constexpr std::uint64_t eventSize = 1000;
+  for (std::uint64_t i = 0; i < chunk.size(); i += eventSize) {
+    QUIC_BUFFER buffer;
+    buffer.Length = std::min(eventSize, chunk.size() - i);
+    buffer.Buffer = chunk.data() + i;
+    deserializer.append_buffer(
+        borrow_received_buffer(buffer, streamHandle, receive_complete));
+    deserializer.limit_borrowed_bytes();
+
+    std::uint64_t borrowedBytes = i + buffer.Length - completedBytes;
+    utils::ASSERT_LOG_THROW(borrowedBytes <=
+                                decltype(deserializer)::maxBorrowedBytes,
+                            "Too many borrowed bytes ", borrowedBytes);
+  }
+
+  utils::ASSERT_LOG_THROW(receivedObjects == sentObjects,
+                          "Objects mismatch, received ",
+                          receivedObjects.size(), " objects");
+  utils::ASSERT_LOG_THROW(completedBytes == chunk.size(), "Completed ",
+                          completedBytes, " of ", chunk.size(), " bytes");
+  std::cout << "Received " << receivedObjects.size()
+            << " Objects without copying\n";
+}
+
+// objects with payload views, in small buffers (payload spans buffers) and in
+// one buffer (payload is used in place)
+void test5() {
+  ds::chunk chunk;
+
+  StreamHeaderSubgroupMessage streamHeaderSubgroupMessage(
+      TrackAlias(1), GroupId(1), SubGroupId(1), PublisherPriority(1));
+  serialization::detail::serialize(chunk, streamHeaderSubgroupMessage);
+
+  std::vector<StreamHeaderSubgroupObject> sentObjects;
+  for (std::uint64_t i = 0; i < 100; i++) {
+    sentObjects.push_back({i, "Object Message: " + std::to_string(i)});
+    serialization::detail::serialize(chunk, sentObjects.back());
+  }
+
+  std::vector<StreamHeaderSubgroupObject> receivedObjects;
+  const auto visitor = overloads{
+      [](...) { std::cout << "Unexpected Message\n"; },
+      [](const StreamHeaderSubgroupMessage &) {},
+      [&](const StreamHeaderSubgroupObject &o) {
+        utils::ASSERT_LOG_THROW(o.payload_.empty(), "Payload was copied");
+        receivedObjects.push_back(o);
+      }};
+
+  const auto check_objects = [&] {
+    utils::ASSERT_LOG_THROW(receivedObjects.size() == sentObjects.size(),
+                            "Received ", receivedObjects.size(), " objects");
+    for (std::size_t i = 0; i < sentObjects.size(); i++)
+      utils::ASSERT_LOG_THROW(
+          receivedObjects[i].payloadView_.string_view() ==
+              sentObjects[i].payload_,
+          "Payload mismatch ", receivedObjects[i]);
+  };
+
+  {
+    Deserializer deserializer(false, visitor);
+    deserializer.set_payload_views(true);
+    for (auto &&quicBuffer : generate_quic_buffers({chunk}))
+      deserializer.append_buffer(std::move(quicBuffer));
+    check_objects();
+  }
+
+  receivedObjects.clear();
+  {
+    UniqueQuicBuffer quicBuffer = construct_quic_buffer(chunk.size());
+    std::memcpy(quicBuffer->Buffer, chunk.data(), chunk.size());
+    const std::uint8_t *begin = quicBuffer->Buffer;
+    const std::uint8_t *end = begin + chunk.size();
+
+    Deserializer deserializer(false, visitor);
+    deserializer.set_payload_views(true);
+    deserializer.append_buffer(std::move(quicBuffer));
+
+    // buffer is kept alive by the views
+    for (auto &object : receivedObjects) {
+      utils::ASSERT_LOG_THROW(object.payloadView_.is_contiguous(),
+                              "Payload in one buffer should be contiguous");
+      const std::uint8_t *data = object.payloadView_.contiguous().data();
+      utils::ASSERT_LOG_THROW(begin <= data && data < end,
+                              "Payload in one buffer was copied");
+    }
+    check_objects();
+  }
+  std::cout << "Received " << receivedObjects.size()
+            << " Objects with payload views\n";
+}
+
+// handler which takes objects in batches
+struct BatchHandler {
+  std::vector<StreamHeaderSubgroupObject> &receivedObjects_;
+  std::uint64_t &numBatches_;
+
+  void operator()(const StreamHeaderSubgroupMessage &) {}
+  void operator()(...) { std::cout << "Unexpected Message\n"; }
+
+  void handle_object_batch(std::span<StreamHeaderSubgroupObject> batch) {
+    ++numBatches_;
+    for (auto &object : batch)
+      receivedObjects_.push_back(std::move(object));
+  }
+};
+
+// many small objects in one buffer are drained in one append (without
+// recursing per object) and delivered in batches
+void test6() {
+  ds::chunk chunk;
+
+  StreamHeaderSubgroupMessage streamHeaderSubgroupMessage(
+      TrackAlias(1), GroupId(1), SubGroupId(1), PublisherPriority(1));
+  serialization::detail::serialize(chunk, streamHeaderSubgroupMessage);
+
+  constexpr std::uint64_t numObjects = 200'000;
+  std::vector<StreamHeaderSubgroupObject> sentObjects;
+  for (std::uint64_t i = 0; i < numObjects; i++) {
+    sentObjects.push_back({i, std::to_string(i % 10)});
+    serialization::detail::serialize(chunk, sentObjects.back());
+  }
+
+  std::vector<StreamHeaderSubgroupObject> receivedObjects;
+  std::uint64_t numBatches = 0;
+  {
+    UniqueQuicBuffer quicBuffer = construct_quic_buffer(chunk.size());
+    std::memcpy(quicBuffer->Buffer, chunk.data(), chunk.size());
+
+    Deserializer deserializer(false, BatchHandler{receivedObjects, numBatches});
+    deserializer.append_buffer(std::move(quicBuffer));
+  }
+
+  utils::ASSERT_LOG_THROW(receivedObjects == sentObjects,
+                          "Objects mismatch, received ",
+                          receivedObjects.size(), " objects");
+  constexpr std::uint64_t maxObjectBatchSize =
+      Deserializer<BatchHandler>::maxObjectBatchSize;
+  utils::ASSERT_LOG_THROW(numBatches == (numObjects + maxObjectBatchSize - 1) /
+                                            maxObjectBatchSize,
+                          "Unexpected number of batches ", numBatches);
+
+  // same objects in small buffers, every append delivers what it completed
+  receivedObjects.clear();
+  numBatches = 0;
+  {
+    Deserializer deserializer(false, BatchHandler{receivedObjects, numBatches});
+    for (auto &&quicBuffer : generate_quic_buffers({chunk}))
+      deserializer.append_buffer(std::move(quicBuffer));
+  }
+  utils::ASSERT_LOG_THROW(receivedObjects == sentObjects,
+                          "Objects mismatch, received ",
+                          receivedObjects.size(), " objects");
+
+  std::cout << "Received " << numObjects << " Objects in batches\n";
+}
+
+// receive handoff, buffers are queued by one thread and parsed on another
+void test7() {
+  ds::chunk chunk;
+
+  StreamHeaderSubgroupMessage streamHeaderSubgroupMessage(
+      TrackAlias(1), GroupId(1), SubGroupId(1), PublisherPriority(1));
+  serialization::detail::serialize(chunk, streamHeaderSubgroupMessage);
+
+  constexpr std::uint64_t numObjects = 20'000;
+  std::vector<StreamHeaderSubgroupObject> sentObjects;
+  for (std::uint64_t i = 0; i < numObjects; i++) {
+    sentObjects.push_back({i, std::to_string(i)});
+    serialization::detail::serialize(chunk, sentObjects.back());
+  }
+
+  std::vector<StreamHeaderSubgroupObject> receivedObjects;
+  std::uint64_t numBatches = 0;
+  {
+    // small blocks so that the queue goes through many of them
+    SPSCQueue<UniqueQuicBuffer, 16> handoff;
+    std::vector<UniqueQuicBuffer> quicBuffers = generate_quic_buffers({chunk});
+    std::size_t numBuffers = quicBuffers.size();
+
+    std::jthread producer([&handoff, &quicBuffers] {
+      for (auto &&quicBuffer : quicBuffers)
+        handoff.push(std::move(quicBuffer));
+    });
+
+    Deserializer deserializer(false, BatchHandler{receivedObjects, numBatches});
+    for (std::size_t numPopped = 0; numPopped < numBuffers;) {
+      std::optional<UniqueQuicBuffer> quicBuffer = handoff.try_pop();
+      if (!quicBuffer.has_value()) {
+        std::this_thread::yield();
+        continue;
+      }
+      deserializer.append_buffer(std::move(*quicBuffer));
+      ++numPopped;
+    }
+    utils::ASSERT_LOG_THROW(!handoff.try_pop().has_value(),
+                            "Handoff queue should be empty");
+  }
+  utils::ASSERT_LOG_THROW(receivedObjects == sentObjects,
+                          "Objects mismatch, received ",
+                          receivedObjects.size(), " objects");
+
+  // items left in the queue are destroyed with it
+  {
+    SPSCQueue<UniqueQuicBuffer, 16> handoff;
+    for (auto &&quicBuffer : generate_quic_buffers({chunk}))
+      handoff.push(std::move(quicBuffer));
+    for (int i = 0; i < 100; ++i)
+      handoff.try_pop();
+  }
+
+  std::cout << "Received " << numObjects << " Objects through the handoff\n";
+}
+
+// handler which hands the objects of a fetch to a FetchStream
+struct FetchHandler {
+  std::uint64_t &subscribeId_;
+  FetchStream &fetchStream_;
+
+  void operator()(const FetchHeaderMessage &msg) {
+    subscribeId_ = msg.subscribeId_;
+  }
+  void operator()(...) { std::cout << "Unexpected Message\n"; }
+
+  void handle_object_batch(std::span<FetchObjectMessage> batch) {
+    fetchStream_.push(batch);
+  }
+};
+
+// fetch stream over several groups and subgroups, the objects are read in
+// order from the FetchStream on another thread
+void test8() {
+  ds::chunk chunk;
+
+  serialization::detail::serialize(chunk, FetchHeaderMessage{7});
+
+  std::vector<FetchObjectMessage> sentObjects;
+  for (std::uint64_t groupId = 3; groupId < 6; groupId++)
+    for (std::uint64_t objectId = 0; objectId < 100; objectId++) {
+      sentObjects.push_back(
+          {GroupId(groupId), SubGroupId(objectId / 50), PublisherPriority(2),
+           ObjectId(objectId), std::to_string(groupId * 1000 + objectId)});
+      serialization::detail::serialize(chunk, sentObjects.back());
+    }
+
+  std::uint64_t subscribeId = 0;
+  FetchStream fetchStream;
+  std::vector<FetchObjectMessage> receivedObjects;
+  {
+    std::jthread consumer([&fetchStream, &receivedObjects] {
+      for (FetchObjectMessage &object : fetchStream)
+        receivedObjects.push_back(std::move(object));
+    });
+
+    Deserializer deserializer(false, FetchHandler{subscribeId, fetchStream});
+    for (auto &&quicBuffer : generate_quic_buffers({chunk}))
+      deserializer.append_buffer(std::move(quicBuffer));
+    // stream FIN
+    fetchStream.finish();
+  }
+
+  utils::ASSERT_LOG_THROW(subscribeId == 7, "SubscribeId mismatch ",
+                          subscribeId);
+  utils::ASSERT_LOG_THROW(receivedObjects == sentObjects,
+                          "Objects mismatch, received ",
+                          receivedObjects.size(), " objects");
+  utils::ASSERT_LOG_THROW(fetchStream.finished() &&
+                              !fetchStream.try_next().has_value(),
+                          "Fetch stream should be finished and empty");
+
+  std::cout << "Received " << receivedObjects.size()
+            << " Objects of a fetch\n";
+}
+
 int main() {
   test1();
   test2();
+  test3();
+  test4();
+  test5();
+  test6();
+  test7();
+  test8();
   return 0;
 }
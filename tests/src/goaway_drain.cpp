@@ -0,0 +1,238 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <subscription_builder.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    Server is drained to a second server (same DataManager, different port)
+    while objects are being published
+    The client moves its subscription to the new server when it receives
+    GOAWAY and should receive every object at least once
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  bool clientSubscribed;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr std::uint64_t numObjects = 1500;
+static constexpr std::uint64_t drainAtObject = numObjects / 3;
+static constexpr auto publishInterval = std::chrono::milliseconds(1);
+static constexpr std::uint16_t newServerPort = serverPort + 1;
+static constexpr auto gracePeriod = std::chrono::milliseconds(3000);
+// objects in flight on the old session are received before it is closed
+static constexpr auto closeOldSessionDelay = std::chrono::milliseconds(100);
+
+int main() {
+  std::string sharedMemoryName = "goaway_drain_test_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->clientSubscribed = false;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> oldServer = server_setup();
+    std::unique_ptr<MOQTServer> newServer =
+        server_setup({nullptr, 0}, newServerPort, oldServer->dataManager_);
+
+    auto trackHandle =
+        oldServer->dataManager_->add_track_identifier({}, "goaway_track");
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientSubscribed)
+        break;
+    }
+
+    std::thread drainThread;
+    for (std::uint64_t idx = 0; idx < numObjects; ++idx) {
+      if (idx == drainAtObject)
+        drainThread = std::thread([&] {
+          auto start = std::chrono::steady_clock::now();
+          oldServer->drain("moqt://127.0.0.1:" + std::to_string(newServerPort),
+                           gracePeriod);
+          std::cout << "Drained in "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count()
+                    << "ms" << std::endl;
+        });
+
+      trackHandle.lock()
+          ->add_group(GroupId(idx), PublisherPriority(0), {})
+          .lock()
+          ->add_subgroup(1)
+          .add_object(std::to_string(idx));
+
+      std::this_thread::sleep_for(publishInterval);
+    }
+    drainThread.join();
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    int status;
+    wait(&status);
+    exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+  } else
+  // child process
+  {
+    // Open shared memory
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    std::unique_ptr<MOQTClient> oldClient = client_setup();
+
+    SubscriptionBuilder subscriptionBuilder;
+    subscriptionBuilder.set_track_alias(TrackAlias(0));
+    subscriptionBuilder.set_track_namespace({});
+    subscriptionBuilder.set_track_name("goaway_track");
+    subscriptionBuilder.set_data_range(
+        SubscriptionBuilder::Filter::absoluteStart, {GroupId(0), ObjectId(0)});
+    subscriptionBuilder.set_subscriber_priority(0);
+    subscriptionBuilder.set_group_order(0);
+    oldClient->subscribe(subscriptionBuilder.build());
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientSubscribed = true;
+    }
+
+    std::vector<bool> received(numObjects);
+    std::uint64_t numReceived = 0;
+    std::uint64_t numDuplicates = 0;
+    std::uint64_t numReceivedOnNewSession = 0;
+
+    std::unique_ptr<MOQTClient> newClient;
+    std::chrono::steady_clock::time_point firstObjectOnNewSession;
+    bool oldSessionClosed = false;
+
+    auto receive = [&](MOQTClient::EnrichedObjectMessage &&object) {
+      std::uint64_t groupId = object.header_->groupId_.get();
+      utils::ASSERT_LOG_THROW(object.object_.payload_ ==
+                                  std::to_string(groupId),
+                              "Wrong payload for group ", groupId);
+      if (received[groupId]) {
+        ++numDuplicates;
+        return;
+      }
+      received[groupId] = true;
+      ++numReceived;
+    };
+
+    try {
+      auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(30);
+      while (numReceived < numObjects) {
+        utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                                "Timed out, received ", numReceived, " of ",
+                                numObjects);
+
+        bool anyReceived = false;
+        MOQTClient::EnrichedObjectMessage object;
+        while (oldClient->receivedObjects_.try_dequeue(object)) {
+          receive(std::move(object));
+          anyReceived = true;
+        }
+        while (newClient && newClient->receivedObjects_.try_dequeue(object)) {
+          if (numReceivedOnNewSession++ == 0)
+            firstObjectOnNewSession = std::chrono::steady_clock::now();
+          receive(std::move(object));
+          anyReceived = true;
+        }
+
+        if (!newClient &&
+            oldClient->goAwayFlag_.load(std::memory_order_acquire)) {
+          const std::string &uri = oldClient->goAwayMessage_.newSessionURI_;
+          std::uint16_t port = std::stoi(uri.substr(uri.rfind(':') + 1));
+          newClient = client_setup({nullptr, 0}, port);
+          for (auto &subscribeMessage : oldClient->get_resume_subscriptions())
+            newClient->subscribe(std::move(subscribeMessage));
+        }
+
+        if (!oldSessionClosed && numReceivedOnNewSession != 0 &&
+            std::chrono::steady_clock::now() - firstObjectOnNewSession >
+                closeOldSessionDelay) {
+          oldClient->close_connection();
+          oldSessionClosed = true;
+        }
+
+        if (!anyReceived)
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+
+      utils::ASSERT_LOG_THROW(newClient != nullptr, "GOAWAY not received");
+      utils::ASSERT_LOG_THROW(numReceivedOnNewSession != 0,
+                              "No objects received on the new session");
+
+      std::cout << "Received " << numReceived << " objects, " << numDuplicates
+                << " duplicates, " << numReceivedOnNewSession
+                << " on the new session" << std::endl;
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      {
+        std::unique_lock lock(dataChild->mutex);
+        dataChild->clientDone = true;
+      }
+      exit(1);
+    }
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
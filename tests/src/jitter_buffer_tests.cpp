@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <jitter_buffer.hpp>
+#include <memory>
+#include <serialization/messages.hpp>
+#include <utilities.hpp>
+#include <vector>
+
+using namespace rvn;
+using namespace std::chrono_literals;
+
+// same shape as MOQTClient::EnrichedObjectMessage
+struct EnrichedObject {
+  std::shared_ptr<StreamHeaderSubgroupMessage> header_;
+  StreamHeaderSubgroupObject object_;
+};
+
+static EnrichedObject make_object(std::uint64_t groupId,
+                                  std::uint64_t objectId) {
+  return {std::make_shared<StreamHeaderSubgroupMessage>(
+              TrackAlias(0), GroupId(groupId), SubGroupId(0),
+              PublisherPriority(0)),
+          {objectId, std::to_string(groupId) + "." + std::to_string(objectId)}};
+}
+
+using Key = std::pair<std::uint64_t, std::uint64_t>;
+
+static std::vector<Key> pop_all(JitterBuffer<EnrichedObject> &jitterBuffer,
+                                TimePoint now) {
+  std::vector<Key> keys;
+  while (auto object = jitterBuffer.pop(now))
+    keys.push_back({object->header_->groupId_, object->object_.objectId_});
+  return keys;
+}
+
+static void check_keys(const std::vector<Key> &keys,
+                       const std::vector<Key> &expected, const char *what) {
+  utils::ASSERT_LOG_THROW(keys == expected, what, ": popped ", keys.size(),
+                          " objects, expected ", expected.size());
+}
+
+// objects out of order within the playout delay come out in order
+void test1() {
+  JitterBuffer<EnrichedObject> jitterBuffer({.playoutDelay_ = 20ms});
+  TimePoint start = Clock::now();
+
+  jitterBuffer.push(make_object(1, 0), start);
+  jitterBuffer.push(make_object(0, 1), start + 5ms);
+  jitterBuffer.push(make_object(0, 0), start + 10ms);
+  jitterBuffer.push(make_object(1, 1), start + 15ms);
+
+  check_keys(pop_all(jitterBuffer, start + 19ms), {}, "before the delay");
+  utils::ASSERT_LOG_THROW(jitterBuffer.next_due() == start + 30ms,
+                          "Wrong next due");
+  check_keys(pop_all(jitterBuffer, start + 40ms),
+             {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, "after the delay");
+  utils::ASSERT_LOG_THROW(jitterBuffer.num_gaps_skipped() == 0,
+                          "Gaps skipped ", jitterBuffer.num_gaps_skipped());
+
+  // arrives after the group moved on
+  jitterBuffer.push(make_object(0, 2), start + 50ms);
+  utils::ASSERT_LOG_THROW(jitterBuffer.num_late() == 1, "Late ",
+                          jitterBuffer.num_late());
+  std::cout << "Objects reordered within the playout delay\n";
+}
+
+// a missing object is waited for till maxGapWait_, then skipped
+void test2() {
+  JitterBuffer<EnrichedObject> jitterBuffer(
+      {.playoutDelay_ = 0ms, .maxGapWait_ = 50ms});
+  TimePoint start = Clock::now();
+
+  jitterBuffer.push(make_object(0, 0), start);
+  check_keys(pop_all(jitterBuffer, start), {{0, 0}}, "first object");
+
+  // (0, 1) is missing
+  jitterBuffer.push(make_object(0, 2), start + 10ms);
+  jitterBuffer.push(make_object(0, 3), start + 10ms);
+  check_keys(pop_all(jitterBuffer, start + 30ms), {}, "waiting on the gap");
+
+  // the missing object fills the gap in time
+  jitterBuffer.push(make_object(0, 1), start + 40ms);
+  check_keys(pop_all(jitterBuffer, start + 40ms), {{0, 1}, {0, 2}, {0, 3}},
+             "gap filled");
+
+  // (0, 4) never arrives
+  jitterBuffer.push(make_object(0, 5), start + 100ms);
+  check_keys(pop_all(jitterBuffer, start + 149ms), {}, "before max wait");
+  check_keys(pop_all(jitterBuffer, start + 150ms), {{0, 5}}, "gap skipped");
+  utils::ASSERT_LOG_THROW(jitterBuffer.num_gaps_skipped() == 1,
+                          "Gaps skipped ", jitterBuffer.num_gaps_skipped());
+  std::cout << "Gaps waited for and skipped\n";
+}
+
+// objects which can not be delivered within the delivery timeout are dropped
+void test3() {
+  JitterBuffer<EnrichedObject> jitterBuffer(
+      {.playoutDelay_ = 0ms, .maxGapWait_ = 100ms, .deliveryTimeout_ = 30ms});
+  TimePoint start = Clock::now();
+
+  jitterBuffer.push(make_object(0, 0), start);
+  jitterBuffer.push(make_object(0, 1), start);
+  jitterBuffer.push(make_object(0, 3), start + 10ms);
+
+  // the application falls behind, (0, 0) and (0, 1) expire
+  check_keys(pop_all(jitterBuffer, start + 31ms), {}, "expired");
+  utils::ASSERT_LOG_THROW(jitterBuffer.num_expired() == 2, "Expired ",
+                          jitterBuffer.num_expired());
+  // (0, 3) expires while it waits on the gap
+  check_keys(pop_all(jitterBuffer, start + 45ms), {}, "expired on the gap");
+  utils::ASSERT_LOG_THROW(jitterBuffer.num_expired() == 3 &&
+                              jitterBuffer.size() == 0,
+                          "Expired ", jitterBuffer.num_expired());
+  std::cout << "Expired objects dropped\n";
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  return 0;
+}
@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <subscription_builder.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    LatestPerGroupInTrack subscriptions abort the object being sent once a
+    newer one is ready, unless it belongs to a base layer (see LayerType)
+    The track has a base layer group and an enhancement layer group, large
+    objects are published into both as fast as possible so objects pile up
+    behind each other. Every base layer object has to reach the client,
+    enhancement layer objects may be dropped
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  bool clientSubscribed;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr GroupId baseGroupId = GroupId(0);
+static constexpr GroupId enhancementGroupId = GroupId(1);
+// objects published after the first one of each group
+static constexpr std::uint64_t numObjects = 64;
+static constexpr std::size_t objectSize = 16 * 1024;
+static constexpr auto receiveTimeout = std::chrono::seconds(5);
+
+int main() {
+  std::string sharedMemoryName = "layer_drop_policy_test_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->clientSubscribed = false;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> moqtServer = server_setup();
+
+    auto dm = moqtServer->dataManager_;
+    auto trackHandle = dm->add_track_identifier({}, "track");
+
+    // LatestPerGroupInTrack starts from the latest object of each group, so
+    // both groups need one before the client subscribes
+    SubgroupHandle baseSubgroup =
+        trackHandle.lock()
+            ->add_group(baseGroupId, PublisherPriority(0), {}, LayerType::Base)
+            .lock()
+            ->add_open_ended_subgroup();
+    SubgroupHandle enhancementSubgroup =
+        trackHandle.lock()
+            ->add_group(enhancementGroupId, PublisherPriority(0), {},
+                        LayerType::Enhancement)
+            .lock()
+            ->add_open_ended_subgroup();
+    baseSubgroup.add_object(std::string(objectSize, 'b'));
+    enhancementSubgroup.add_object(std::string(objectSize, 'e'));
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientSubscribed)
+        break;
+    }
+
+    for (std::uint64_t idx = 0; idx < numObjects; ++idx) {
+      baseSubgroup.add_object(std::string(objectSize, 'b'));
+      enhancementSubgroup.add_object(std::string(objectSize, 'e'));
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    int status;
+    wait(&status);
+    exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+  } else
+  // child process
+  {
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    std::unique_ptr<MOQTClient> moqtClient = client_setup();
+
+    SubscriptionBuilder subscriptionBuilder;
+    subscriptionBuilder.set_track_alias(TrackAlias(0));
+    subscriptionBuilder.set_track_namespace({});
+    subscriptionBuilder.set_track_name("track");
+    subscriptionBuilder.set_data_range(
+        SubscriptionBuilder::Filter::latestPerGroupInTrack);
+    subscriptionBuilder.set_subscriber_priority(0);
+    subscriptionBuilder.set_group_order(0);
+    moqtClient->subscribe(subscriptionBuilder.build());
+
+    std::set<std::uint64_t> baseObjectIds;
+    std::uint64_t numEnhancementObjects = 0;
+    auto receive_object = [&](const MOQTClient::EnrichedObjectMessage &object) {
+      if (object.header_->groupId_ == baseGroupId)
+        baseObjectIds.insert(object.object_.objectId_);
+      else
+        ++numEnhancementObjects;
+    };
+
+    try {
+      // the first base layer object arriving means the subscription has been
+      // resolved, everything published from now on is sent
+      auto deadline = std::chrono::steady_clock::now() + receiveTimeout;
+      while (baseObjectIds.empty()) {
+        MOQTClient::EnrichedObjectMessage object;
+        if (moqtClient->receivedObjects_.try_dequeue(object)) {
+          receive_object(object);
+          continue;
+        }
+        utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                                "Subscription was not resolved");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      {
+        std::unique_lock lock(dataChild->mutex);
+        dataChild->clientSubscribed = true;
+      }
+
+      deadline = std::chrono::steady_clock::now() + receiveTimeout;
+      while (baseObjectIds.size() < numObjects + 1) {
+        MOQTClient::EnrichedObjectMessage object;
+        if (moqtClient->receivedObjects_.try_dequeue(object)) {
+          receive_object(object);
+          continue;
+        }
+        utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                                "Received ", baseObjectIds.size(), " of ",
+                                numObjects + 1, " base layer objects");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      // the server may still be waiting for the subscription
+      {
+        std::unique_lock lock(dataChild->mutex);
+        dataChild->clientSubscribed = true;
+        dataChild->clientDone = true;
+      }
+      exit(1);
+    }
+
+    std::cout << "Received " << baseObjectIds.size()
+              << " base layer objects and " << numEnhancementObjects
+              << " enhancement layer objects" << std::endl;
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
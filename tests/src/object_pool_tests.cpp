@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <iostream>
+#include <object_pool.hpp>
+#include <set>
+#include <thread>
+#include <utilities.hpp>
+#include <vector>
+
+using namespace rvn;
+
+struct PooledObject {
+  std::uint64_t value_;
+
+  explicit PooledObject(std::uint64_t value) : value_(value) {}
+
+  static void *operator new(std::size_t) {
+    return ObjectPool<PooledObject>::allocate();
+  }
+  static void operator delete(void *object) noexcept {
+    ObjectPool<PooledObject>::deallocate(object);
+  }
+};
+
+static std::vector<PooledObject *> allocate(std::uint64_t numObjects) {
+  std::vector<PooledObject *> objects;
+  for (std::uint64_t i = 0; i < numObjects; ++i)
+    objects.push_back(new PooledObject(i));
+  return objects;
+}
+
+static std::set<PooledObject *>
+addresses(const std::vector<PooledObject *> &objects) {
+  return {objects.begin(), objects.end()};
+}
+
+// blocks freed on the allocating thread are reused by it, most recently freed
+// first
+void test1() {
+  PooledObject *object = new PooledObject(1);
+  delete object;
+  PooledObject *reused = new PooledObject(2);
+  utils::ASSERT_LOG_THROW(reused == object, "Block was not reused");
+  utils::ASSERT_LOG_THROW(reused->value_ == 2, "Value ", reused->value_);
+  delete reused;
+
+  std::vector<PooledObject *> objects = allocate(64);
+  std::set<PooledObject *> freed = addresses(objects);
+  for (PooledObject *pooledObject : objects)
+    delete pooledObject;
+
+  std::vector<PooledObject *> reallocated = allocate(64);
+  utils::ASSERT_LOG_THROW(addresses(reallocated) == freed,
+                          "Blocks were not reused");
+  for (PooledObject *pooledObject : reallocated)
+    delete pooledObject;
+  std::cout << "Blocks reused on the same thread\n";
+}
+
+// blocks freed by other threads go to the remote free stack of the thread
+// which allocated them, the next allocation takes the whole stack
+void test2() {
+  constexpr std::uint64_t numObjects = 10'000;
+  constexpr std::uint64_t numThreads = 4;
+
+  std::vector<PooledObject *> objects = allocate(numObjects);
+  std::set<PooledObject *> freed = addresses(objects);
+
+  {
+    std::vector<std::jthread> threads;
+    for (std::uint64_t t = 0; t < numThreads; ++t)
+      threads.emplace_back([&objects, t] {
+        for (std::uint64_t i = t; i < numObjects; i += numThreads) {
+          utils::ASSERT_LOG_THROW(objects[i]->value_ == i, "Value ",
+                                  objects[i]->value_, " expected ", i);
+          delete objects[i];
+        }
+      });
+  }
+
+  // drains the remote free stack, no new blocks are needed
+  std::vector<PooledObject *> reallocated = allocate(numObjects);
+  utils::ASSERT_LOG_THROW(addresses(reallocated) == freed,
+                          "Remote free stack was not drained");
+
+  // the pool is empty again, this one is a new block
+  PooledObject *object = new PooledObject(0);
+  utils::ASSERT_LOG_THROW(!freed.contains(object), "Block handed out twice");
+  delete object;
+
+  for (PooledObject *pooledObject : reallocated)
+    delete pooledObject;
+  std::cout << "Blocks freed on other threads returned to their owner\n";
+}
+
+// blocks can outlive the thread which allocated them, they are deleted when
+// freed
+void test3() {
+  std::vector<PooledObject *> objects;
+  std::jthread([&objects] { objects = allocate(64); }).join();
+
+  for (std::uint64_t i = 0; i < objects.size(); ++i) {
+    utils::ASSERT_LOG_THROW(objects[i]->value_ == i, "Value ",
+                            objects[i]->value_, " expected ", i);
+    delete objects[i];
+  }
+  std::cout << "Blocks freed after their thread exited\n";
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <object_ring.hpp>
+#include <thread>
+#include <utilities.hpp>
+#include <vector>
+
+using namespace rvn;
+
+using Ring = ObjectRing<std::unique_ptr<std::uint64_t>>;
+
+static std::vector<std::uint64_t> drain(Ring &ring) {
+  std::vector<std::uint64_t> values;
+  while (auto value = ring.try_pop())
+    values.push_back(**value);
+  return values;
+}
+
+// full ring keeps the newest objects with DROP_OLDEST and the oldest ones
+// with DROP_NEWEST
+void test1() {
+  for (OverflowPolicy overflowPolicy :
+       {OverflowPolicy::DROP_OLDEST, OverflowPolicy::DROP_NEWEST}) {
+    // rounded up to 8
+    Ring ring(5, overflowPolicy);
+    utils::ASSERT_LOG_THROW(ring.capacity() == 8, "Capacity ",
+                            ring.capacity());
+
+    for (std::uint64_t i = 0; i < 20; ++i)
+      ring.push(std::make_unique<std::uint64_t>(i));
+    utils::ASSERT_LOG_THROW(ring.num_dropped() == 12, "Dropped ",
+                            ring.num_dropped());
+
+    std::uint64_t first =
+        overflowPolicy == OverflowPolicy::DROP_OLDEST ? 12 : 0;
+    std::vector<std::uint64_t> values = drain(ring);
+    utils::ASSERT_LOG_THROW(values.size() == 8, "Popped ", values.size());
+    for (std::uint64_t i = 0; i < values.size(); ++i)
+      utils::ASSERT_LOG_THROW(values[i] == first + i, "Popped ", values[i],
+                              " expected ", first + i);
+
+    // objects left in the ring are destroyed with it
+    for (std::uint64_t i = 0; i < 4; ++i)
+      ring.push(std::make_unique<std::uint64_t>(i));
+  }
+  std::cout << "Overflow policies dropped the right objects\n";
+}
+
+// consumer on another thread, objects come out in order, with BLOCK none of
+// them are dropped
+void test2() {
+  constexpr std::uint64_t numObjects = 200'000;
+
+  for (OverflowPolicy overflowPolicy :
+       {OverflowPolicy::DROP_OLDEST, OverflowPolicy::DROP_NEWEST,
+        OverflowPolicy::BLOCK}) {
+    Ring ring(64, overflowPolicy);
+    std::atomic<bool> producerDone{};
+    std::jthread producer([&ring, &producerDone] {
+      for (std::uint64_t i = 0; i < numObjects; ++i)
+        ring.push(std::make_unique<std::uint64_t>(i));
+      producerDone.store(true, std::memory_order_release);
+    });
+
+    std::uint64_t numPopped = 0;
+    std::uint64_t last = 0;
+    for (;;) {
+      bool done = producerDone.load(std::memory_order_acquire);
+      while (auto value = ring.try_pop()) {
+        utils::ASSERT_LOG_THROW(numPopped == 0 || **value > last,
+                                "Out of order ", **value, " after ", last);
+        last = **value;
+        ++numPopped;
+      }
+      if (done)
+        break;
+    }
+
+    utils::ASSERT_LOG_THROW(numPopped + ring.num_dropped() == numObjects,
+                            "Popped ", numPopped, " dropped ",
+                            ring.num_dropped());
+    if (overflowPolicy == OverflowPolicy::BLOCK)
+      utils::ASSERT_LOG_THROW(ring.num_dropped() == 0, "Dropped ",
+                              ring.num_dropped(), " with BLOCK");
+  }
+  std::cout << "Objects passed between threads in order\n";
+}
+
+int main() {
+  test1();
+  test2();
+  return 0;
+}
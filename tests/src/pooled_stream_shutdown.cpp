@@ -0,0 +1,196 @@
+/////////////////////////////////////////////////////////
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+/////////////////////////////////////////////////////////
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+/////////////////////////////////////////////////////////
+#include <callbacks.hpp>
+#include <contexts.hpp>
+#include <moqt.hpp>
+#include <subscription_builder.hpp>
+#include <utilities.hpp>
+/////////////////////////////////////////////////////////
+#include "../test_utilities.hpp"
+/////////////////////////////////////////////////////////
+
+/*
+    Data streams are opened ahead of time and kept in a pool (see
+    ConnectionState::open_data_stream). A pooled stream which MsQuic shuts
+    down has its context freed, so it has to leave the pool first
+    The server shuts down a pooled stream, checks that it is taken out of the
+    pool and then publishes more groups than the pool holds, every group goes
+    on a stream of its own taken from the pool
+*/
+
+using namespace rvn;
+
+struct InterprocessSynchronizationData {
+  boost::interprocess::interprocess_mutex mutex;
+  bool serverSetup;
+  bool clientSubscribed;
+  bool clientDone;
+};
+
+namespace bip = boost::interprocess;
+
+static constexpr std::uint64_t numGroups =
+    4 * ConnectionState::dataStreamPoolSize;
+static constexpr auto poolTimeout = std::chrono::seconds(2);
+static constexpr auto receiveTimeout = std::chrono::seconds(5);
+
+static bool in_pool(ConnectionState &connectionState, HQUIC streamHandle) {
+  std::lock_guard lock(connectionState.dataStreamPoolMtx_);
+  for (const auto &[stream, streamContext] : connectionState.dataStreamPool_)
+    if (stream.get() == streamHandle)
+      return true;
+  return false;
+}
+
+int main() {
+  std::string sharedMemoryName = "pooled_stream_shutdown_test_";
+  sharedMemoryName += std::to_string(getpid());
+
+  bip::shared_memory_object shmParent(
+      bip::create_only, sharedMemoryName.c_str(), bip::read_write);
+  shmParent.truncate(sizeof(InterprocessSynchronizationData));
+  bip::mapped_region regionParent(shmParent, bip::read_write);
+  InterprocessSynchronizationData *dataParent =
+      new (regionParent.get_address()) InterprocessSynchronizationData();
+
+  dataParent->serverSetup = false;
+  dataParent->clientSubscribed = false;
+  dataParent->clientDone = false;
+
+  if (fork()) {
+    // parent process, server
+    std::unique_ptr<MOQTServer> moqtServer = server_setup();
+
+    auto dm = moqtServer->dataManager_;
+    auto trackHandle = dm->add_track_identifier({}, "track");
+
+    {
+      std::unique_lock lock(dataParent->mutex);
+      dataParent->serverSetup = true;
+    }
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientSubscribed)
+        break;
+    }
+
+    ConnectionState *connectionState = nullptr;
+    moqtServer->connections_.for_each(
+        [&connectionState](ConnectionState &state) {
+          connectionState = std::addressof(state);
+        });
+    utils::ASSERT_LOG_THROW(connectionState != nullptr,
+                            "Client is not connected");
+
+    // the pool is filled on the timer thread once the client subscribes
+    HQUIC pooledStream = NULL;
+    auto deadline = std::chrono::steady_clock::now() + poolTimeout;
+    while (pooledStream == NULL) {
+      {
+        std::lock_guard lock(connectionState->dataStreamPoolMtx_);
+        if (connectionState->dataStreamPool_.size() ==
+            ConnectionState::dataStreamPoolSize)
+          pooledStream =
+              std::get<0>(connectionState->dataStreamPool_.front()).get();
+      }
+      utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                              "Data stream pool was not filled");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    moqtServer->get_tbl()->StreamShutdown(
+        pooledStream, QUIC_STREAM_SHUTDOWN_FLAG_ABORT, 0);
+
+    deadline = std::chrono::steady_clock::now() + poolTimeout;
+    while (in_pool(*connectionState, pooledStream)) {
+      utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                              "Shut down stream was left in the pool");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (std::uint64_t idx = 0; idx < numGroups; ++idx)
+      trackHandle.lock()
+          ->add_group(GroupId(idx), PublisherPriority(0), {})
+          .lock()
+          ->add_subgroup(1)
+          .add_object(std::to_string(idx));
+
+    for (;;) {
+      std::unique_lock lock(dataParent->mutex);
+      if (dataParent->clientDone)
+        break;
+    }
+
+    std::cout << "Server done" << std::endl;
+
+    wait(NULL);
+    exit(0);
+  } else
+  // child process
+  {
+    bip::shared_memory_object shmChild(bip::open_only, sharedMemoryName.c_str(),
+                                       bip::read_write);
+    bip::mapped_region regionChild(shmChild, bip::read_write);
+    InterprocessSynchronizationData *dataChild =
+        static_cast<InterprocessSynchronizationData *>(
+            regionChild.get_address());
+
+    for (;;) {
+      std::unique_lock lock(dataChild->mutex);
+      if (dataChild->serverSetup)
+        break;
+    }
+
+    std::unique_ptr<MOQTClient> moqtClient = client_setup();
+
+    SubscriptionBuilder subscriptionBuilder;
+    subscriptionBuilder.set_track_alias(TrackAlias(0));
+    subscriptionBuilder.set_track_namespace({});
+    subscriptionBuilder.set_track_name("track");
+    subscriptionBuilder.set_data_range(
+        SubscriptionBuilder::Filter::absoluteStart, {GroupId(0), ObjectId(0)});
+    subscriptionBuilder.set_subscriber_priority(0);
+    subscriptionBuilder.set_group_order(0);
+    moqtClient->subscribe(subscriptionBuilder.build());
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientSubscribed = true;
+    }
+
+    try {
+      auto deadline = std::chrono::steady_clock::now() + receiveTimeout;
+      for (std::uint64_t idx = 0; idx < numGroups; ++idx) {
+        MOQTClient::EnrichedObjectMessage object;
+        while (!moqtClient->receivedObjects_.try_dequeue(object)) {
+          utils::ASSERT_LOG_THROW(std::chrono::steady_clock::now() < deadline,
+                                  "Received ", idx, " of ", numGroups,
+                                  " groups");
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      exit(1);
+    }
+
+    std::cout << "Received " << numGroups << " groups" << std::endl;
+
+    {
+      std::unique_lock lock(dataChild->mutex);
+      dataChild->clientDone = true;
+    }
+    std::cout << "Client done" << std::endl;
+    exit(0);
+  }
+}
@@ -26,7 +26,8 @@ static const char *KeyFile = RAVEN_KEY_FILE_PATH;
 
 static inline std::unique_ptr<rvn::MOQTClient> client_setup(
     std::tuple<QUIC_EXECUTION_CONFIG *, std::uint64_t> executionConfig = {
-        nullptr, 0}) {
+        nullptr, 0},
+    std::uint16_t port = serverPort) {
   std::unique_ptr<rvn::MOQTClient> moqtClient =
       std::make_unique<rvn::MOQTClient>(executionConfig);
 
@@ -46,6 +47,9 @@ static inline std::unique_ptr<rvn::MOQTClient> client_setup(
   Settings.SendBufferingEnabled = FALSE;
   Settings.IsSet.MaxAckDelayMs = TRUE;
   Settings.MaxAckDelayMs = 1;
+  // objects of subscriptions in DeliveryMode::Datagram
+  Settings.IsSet.DatagramReceiveEnabled = TRUE;
+  Settings.DatagramReceiveEnabled = TRUE;
   moqtClient->set_Settings(&Settings, sizeof(Settings));
 
   QUIC_CREDENTIAL_CONFIG credConfig;
@@ -65,15 +69,19 @@ static inline std::unique_ptr<rvn::MOQTClient> client_setup(
       rvn::callbacks::client_control_stream_callback);
   moqtClient->set_dataStreamCb(rvn::callbacks::client_data_stream_callback);
 
-  moqtClient->start_connection(QUIC_ADDRESS_FAMILY_UNSPEC, Target, serverPort);
+  moqtClient->start_connection(QUIC_ADDRESS_FAMILY_UNSPEC, Target, port);
 
   return moqtClient;
 }
 
+// servers can share a DataManager (e.g. a server and the one it is drained to)
 static inline std::unique_ptr<rvn::MOQTServer> server_setup(
     std::tuple<QUIC_EXECUTION_CONFIG *, std::uint64_t> executionConfig = {
-        nullptr, 0}) {
-  auto dm = std::make_shared<rvn::DataManager>();
+        nullptr, 0},
+    std::uint16_t port = serverPort,
+    std::shared_ptr<rvn::DataManager> dm = nullptr) {
+  if (!dm)
+    dm = std::make_shared<rvn::DataManager>();
   std::unique_ptr<rvn::MOQTServer> moqtServer =
       std::make_unique<rvn::MOQTServer>(dm, executionConfig);
 
@@ -119,7 +127,7 @@ static inline std::unique_ptr<rvn::MOQTServer> server_setup(
   QUIC_ADDR Address;
   std::memset(&Address, 0, sizeof(Address));
   QuicAddrSetFamily(&Address, QUIC_ADDRESS_FAMILY_UNSPEC);
-  QuicAddrSetPort(&Address, serverPort);
+  QuicAddrSetPort(&Address, port);
 
   moqtServer->start_listener(&Address);
 